@@ -17,7 +17,7 @@
 /// Length of string: "put <mrl>"
 #define MRL_MAX    (128)
 /// Size of obj meta data buffer
-#define META_MAX   (1024)
+#define META_MAX   (4096)
 /// Length of fav command
 #define FAV_MAX    (128)
 // #define COL_SEP    "|"
@@ -94,21 +94,27 @@ RingBuffer::clear()
 ByteQueue::ByteQueue(int size) :
 _ringBuffer(size),
 _size(size),
-_level(0)
+_level(0),
+_closed(false)
 {
 }
 
 
-void
+int
 ByteQueue::read(char* buffer, int num)
 {
     LOG(avstream, trace, "byte queue read, num bytes: " + Poco::NumberFormatter::format(num));
     int bytesRead = 0;
     while (bytesRead < num) {
         LOG(avstream, trace, "byte queue read -> readSome, trying to read: " + Poco::NumberFormatter::format(num - bytesRead) + " bytes");
-        bytesRead += readSome(buffer + bytesRead, num - bytesRead);
+        int bytes = readSome(buffer + bytesRead, num - bytesRead);
+        if (!bytes && isClosed() && empty()) {
+            break;
+        }
+        bytesRead += bytes;
     }
     LOG(avstream, trace, "byte queue read finished.");
+    return bytesRead;
 }
 
 
@@ -129,7 +135,7 @@ int
 ByteQueue::readSome(char* buffer, int num)
 {
     _lock.lock();
-    if (_level == 0) {
+    if (_level == 0 && !_closed) {
         LOG(avstream, trace, "byte queue readSome() try to read " + Poco::NumberFormatter::format(num) + " bytes, level: " + Poco::NumberFormatter::format(_level));
         // block byte queue for further reading
         _readCondition.wait<Poco::FastMutex>(_lock);
@@ -155,12 +161,17 @@ int
 ByteQueue::writeSome(const char* buffer, int num)
 {
     _lock.lock();
-    if (_level == _size) {
+    if (_level == _size && !_closed) {
         // block byte queue for further writing
         LOG(avstream, trace, "byte queue writeSome() try to write " + Poco::NumberFormatter::format(num) + " bytes, level: " + Poco::NumberFormatter::format(_level));
         _writeCondition.wait<Poco::FastMutex>(_lock);
         LOG(avstream, trace, "byte queue writeSome() wait over, now writing " + Poco::NumberFormatter::format(num) + " bytes, level: " + Poco::NumberFormatter::format(_level));
     }
+    if (_closed) {
+        // nobody reads the rest of the stream
+        _lock.unlock();
+        return num;
+    }
 
     int bytesWritten = (_size - _level < num) ? (_size - _level) : num;
     _ringBuffer.write(buffer, bytesWritten);
@@ -202,6 +213,33 @@ ByteQueue::clear()
 }
 
 
+void
+ByteQueue::close()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    LOG(avstream, trace, "byte queue close");
+    _closed = true;
+    _readCondition.broadcast();
+    _writeCondition.broadcast();
+}
+
+
+void
+ByteQueue::open()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    _closed = false;
+}
+
+
+bool
+ByteQueue::isClosed()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    return _closed;
+}
+
+
 bool
 ByteQueue::full()
 {
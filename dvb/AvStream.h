@@ -88,9 +88,10 @@ public:
     ByteQueue(int size);
 
     /**
-    read() and write() block until num bytes have been read or written
+    read() and write() block until num bytes have been read or written,
+    read() returns less than num bytes only if the queue is closed
     **/
-    void read(char* buffer, int num);
+    int read(char* buffer, int num);
     void write(const char* buffer, int num);
 
     /**
@@ -104,13 +105,22 @@ public:
     int level();
     void clear();
 
+    /**
+    close() ends the stream: readers get the remaining bytes and then 0 instead of blocking,
+    writes are dropped. open() makes the queue usable again.
+    **/
+    void close();
+    void open();
+
     bool full();
     bool empty();
+    bool isClosed();
 
 private:
     RingBuffer              _ringBuffer;
     int                     _size;
     int                     _level;
+    bool                    _closed;
     Poco::FastMutex         _lock;
     Poco::Condition         _writeCondition;
     Poco::Condition         _readCondition;
@@ -0,0 +1,317 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+#include <Poco/NumberFormatter.h>
+
+#include "Log.h"
+#include "ChannelDb.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+const char ChannelDb::Magic[8] = { 'O', 'M', 'M', 'D', 'V', 'B', 'D', 'B' };
+const Poco::UInt32 ChannelDb::Version = 3;
+const Poco::UInt32 ChannelDb::ByteOrderMark = 0x01020304;
+// magic, version, byte order mark, xml modification time, xml size, payload size
+const unsigned int ChannelDb::HeaderSize = 8 + 4 + 4 + 8 + 8 + 4;
+
+
+ChannelDbWriter::ChannelDbWriter(Poco::Int64 xmlModified, Poco::UInt64 xmlSize)
+{
+    write(ChannelDb::Magic, sizeof(ChannelDb::Magic));
+    write(&ChannelDb::Version, sizeof(ChannelDb::Version));
+    write(&ChannelDb::ByteOrderMark, sizeof(ChannelDb::ByteOrderMark));
+    write(&xmlModified, sizeof(xmlModified));
+    write(&xmlSize, sizeof(xmlSize));
+    Poco::UInt32 payloadSize = 0;
+    write(&payloadSize, sizeof(payloadSize));
+}
+
+
+void
+ChannelDbWriter::writeUInt8(Poco::UInt8 val)
+{
+    write(&val, sizeof(val));
+}
+
+
+void
+ChannelDbWriter::writeUInt16(Poco::UInt16 val)
+{
+    write(&val, sizeof(val));
+}
+
+
+void
+ChannelDbWriter::writeUInt32(Poco::UInt32 val)
+{
+    write(&val, sizeof(val));
+}
+
+
+void
+ChannelDbWriter::writeInt32(Poco::Int32 val)
+{
+    write(&val, sizeof(val));
+}
+
+
+void
+ChannelDbWriter::writeString(const std::string& val)
+{
+    Poco::UInt16 size = val.size() > 0xffff ? 0xffff : val.size();
+    writeUInt16(size);
+    write(val.data(), size);
+}
+
+
+unsigned int
+ChannelDbWriter::offset()
+{
+    return _buffer.size();
+}
+
+
+void
+ChannelDbWriter::patchUInt32(unsigned int offset, Poco::UInt32 val)
+{
+    ::memcpy(&_buffer[offset], &val, sizeof(val));
+}
+
+
+bool
+ChannelDbWriter::save(const std::string& path)
+{
+    patchUInt32(ChannelDb::HeaderSize - sizeof(Poco::UInt32), _buffer.size() - ChannelDb::HeaderSize);
+
+    std::string tmpPath = path + ".tmp";
+    int fileDesc = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fileDesc == -1) {
+        LOG(dvb, error, "failed to create channel db " + tmpPath + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    const char* pData = &_buffer[0];
+    unsigned int bytesLeft = _buffer.size();
+    while (bytesLeft > 0) {
+        ssize_t bytesWritten = ::write(fileDesc, pData, bytesLeft);
+        if (bytesWritten == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(dvb, error, "failed to write channel db " + tmpPath + ": " + std::string(strerror(errno)));
+            ::close(fileDesc);
+            ::unlink(tmpPath.c_str());
+            return false;
+        }
+        pData += bytesWritten;
+        bytesLeft -= bytesWritten;
+    }
+    ::close(fileDesc);
+    if (::rename(tmpPath.c_str(), path.c_str()) == -1) {
+        LOG(dvb, error, "failed to rename channel db " + tmpPath + ": " + std::string(strerror(errno)));
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    LOG(dvb, debug, "wrote channel db " + path + " with " + Poco::NumberFormatter::format(_buffer.size()) + " bytes");
+    return true;
+}
+
+
+void
+ChannelDbWriter::write(const void* pData, unsigned int size)
+{
+    _buffer.insert(_buffer.end(), (const char*)pData, (const char*)pData + size);
+}
+
+
+ChannelDbReader::ChannelDbReader() :
+_pData(0),
+_size(0),
+_offset(0),
+_good(false)
+{
+}
+
+
+ChannelDbReader::~ChannelDbReader()
+{
+    close();
+}
+
+
+bool
+ChannelDbReader::open(const std::string& path, Poco::Int64 xmlModified, Poco::UInt64 xmlSize)
+{
+    int fileDesc = ::open(path.c_str(), O_RDONLY);
+    if (fileDesc == -1) {
+        LOG(dvb, debug, "no channel db " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    struct stat fileStat;
+    if (::fstat(fileDesc, &fileStat) == -1 || fileStat.st_size < ChannelDb::HeaderSize) {
+        LOG(dvb, error, "channel db " + path + " too short");
+        ::close(fileDesc);
+        return false;
+    }
+    void* pData = ::mmap(0, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDesc, 0);
+    ::close(fileDesc);
+    if (pData == MAP_FAILED) {
+        LOG(dvb, error, "failed to map channel db " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    _pData = (const char*)pData;
+    _size = fileStat.st_size;
+    _offset = 0;
+    _good = true;
+
+    char magic[sizeof(ChannelDb::Magic)];
+    Poco::UInt32 version = 0;
+    Poco::UInt32 byteOrderMark = 0;
+    Poco::Int64 modified = 0;
+    Poco::UInt64 size = 0;
+    Poco::UInt32 payloadSize = 0;
+    read(magic, sizeof(magic));
+    read(&version, sizeof(version));
+    read(&byteOrderMark, sizeof(byteOrderMark));
+    read(&modified, sizeof(modified));
+    read(&size, sizeof(size));
+    read(&payloadSize, sizeof(payloadSize));
+    if (::memcmp(magic, ChannelDb::Magic, sizeof(magic)) || version != ChannelDb::Version || byteOrderMark != ChannelDb::ByteOrderMark) {
+        LOG(dvb, warning, "channel db " + path + " has wrong format, ignoring");
+        close();
+        return false;
+    }
+    if (modified != xmlModified || size != xmlSize) {
+        LOG(dvb, information, "channel db " + path + " is outdated, ignoring");
+        close();
+        return false;
+    }
+    if (payloadSize != _size - ChannelDb::HeaderSize) {
+        LOG(dvb, warning, "channel db " + path + " is truncated, ignoring");
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void
+ChannelDbReader::close()
+{
+    if (_pData) {
+        ::munmap((void*)_pData, _size);
+        _pData = 0;
+        _size = 0;
+    }
+}
+
+
+bool
+ChannelDbReader::good()
+{
+    return _good;
+}
+
+
+Poco::UInt8
+ChannelDbReader::readUInt8()
+{
+    Poco::UInt8 val = 0;
+    read(&val, sizeof(val));
+    return val;
+}
+
+
+Poco::UInt16
+ChannelDbReader::readUInt16()
+{
+    Poco::UInt16 val = 0;
+    read(&val, sizeof(val));
+    return val;
+}
+
+
+Poco::UInt32
+ChannelDbReader::readUInt32()
+{
+    Poco::UInt32 val = 0;
+    read(&val, sizeof(val));
+    return val;
+}
+
+
+Poco::Int32
+ChannelDbReader::readInt32()
+{
+    Poco::Int32 val = 0;
+    read(&val, sizeof(val));
+    return val;
+}
+
+
+std::string
+ChannelDbReader::readString()
+{
+    Poco::UInt16 size = readUInt16();
+    if (!_good || _offset + size > _size) {
+        _good = false;
+        return "";
+    }
+    std::string val(_pData + _offset, size);
+    _offset += size;
+    return val;
+}
+
+
+unsigned int
+ChannelDbReader::offset()
+{
+    return _offset;
+}
+
+
+void
+ChannelDbReader::skip(unsigned int size)
+{
+    if (!_good || _offset + size > _size) {
+        _good = false;
+        return;
+    }
+    _offset += size;
+}
+
+
+bool
+ChannelDbReader::read(void* pData, unsigned int size)
+{
+    if (!_good || _offset + size > _size) {
+        _good = false;
+        return false;
+    }
+    ::memcpy(pData, _pData + _offset, size);
+    _offset += size;
+    return true;
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
@@ -0,0 +1,97 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef ChannelDb_INCLUDED
+#define ChannelDb_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <Poco/Types.h>
+
+
+namespace Omm {
+namespace Dvb {
+
+
+class ChannelDb
+/// Binary image of the dvb description, written next to the xml description.
+/// All values are stored in host byte order, strings with a 16 bit length prefix.
+/// The header carries modification time and size of the xml description it was
+/// generated from, so a changed xml description invalidates the channel db.
+{
+public:
+    static const char           Magic[8];
+    static const Poco::UInt32   Version;
+    static const Poco::UInt32   ByteOrderMark;
+    static const unsigned int   HeaderSize;
+};
+
+
+class ChannelDbWriter
+{
+public:
+    ChannelDbWriter(Poco::Int64 xmlModified, Poco::UInt64 xmlSize);
+
+    void writeUInt8(Poco::UInt8 val);
+    void writeUInt16(Poco::UInt16 val);
+    void writeUInt32(Poco::UInt32 val);
+    void writeInt32(Poco::Int32 val);
+    void writeString(const std::string& val);
+    unsigned int offset();
+    void patchUInt32(unsigned int offset, Poco::UInt32 val);
+    /// fill in a size that is known only after writing a record
+
+    bool save(const std::string& path);
+    /// write to a temporary file and rename it, so readers never see a partial channel db
+
+private:
+    void write(const void* pData, unsigned int size);
+
+    std::vector<char>   _buffer;
+};
+
+
+class ChannelDbReader
+{
+public:
+    ChannelDbReader();
+    ~ChannelDbReader();
+
+    bool open(const std::string& path, Poco::Int64 xmlModified, Poco::UInt64 xmlSize);
+    /// map channel db into memory, fails if it doesn't match version or xml description
+    void close();
+    bool good();
+    /// false if a read went past the end of the channel db
+
+    Poco::UInt8 readUInt8();
+    Poco::UInt16 readUInt16();
+    Poco::UInt32 readUInt32();
+    Poco::Int32 readInt32();
+    std::string readString();
+    unsigned int offset();
+    void skip(unsigned int size);
+
+private:
+    bool read(void* pData, unsigned int size);
+
+    const char*         _pData;
+    unsigned int        _size;
+    unsigned int        _offset;
+    bool                _good;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
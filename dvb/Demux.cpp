@@ -277,6 +277,45 @@ Demux::readStream(Stream* pStream, Poco::UInt8* buf, int size, int timeout)
 }
 
 
+int
+Demux::openSectionFilter(Poco::UInt16 pid, Poco::UInt8 tableId, Poco::UInt8 tableIdMask, int bufferSize)
+{
+    int fileDesc;
+    if ((fileDesc = open(_deviceName.c_str(), O_RDWR | O_NONBLOCK)) < 0) {
+        LOG(dvb, error, "demuxer failed to open section filter: " + std::string(strerror(errno)));
+        return -1;
+    }
+    if (bufferSize && ioctl(fileDesc, DMX_SET_BUFFER_SIZE, bufferSize) == -1) {
+        LOG(dvb, warning, "DMX_SET_BUFFER_SIZE failed: " + std::string(strerror(errno)));
+    }
+
+    struct dmx_sct_filter_params sectionFilter;
+    memset(&sectionFilter, 0, sizeof(sectionFilter));
+    sectionFilter.pid = pid;
+    sectionFilter.filter.filter[0] = tableId;
+    sectionFilter.filter.mask[0] = tableIdMask;
+    sectionFilter.flags = DMX_CHECK_CRC | DMX_IMMEDIATE_START;
+
+    if (ioctl(fileDesc, DMX_SET_FILTER, &sectionFilter) == -1) {
+        LOG(dvb, error, "DMX_SET_FILTER failed: " + std::string(strerror(errno)));
+        close(fileDesc);
+        return -1;
+    }
+    LOG(dvb, debug, "demuxer opened section filter on pid: " + Poco::NumberFormatter::format(pid));
+    return fileDesc;
+}
+
+
+void
+Demux::closeSectionFilter(int fileDesc)
+{
+    ioctl(fileDesc, DMX_STOP);
+    if (close(fileDesc)) {
+        LOG(dvb, error, "demuxer closing section filter: " + std::string(strerror(errno)));
+    }
+}
+
+
 bool
 Demux::readSection(Section* pSection)
 {
@@ -51,6 +51,10 @@ public:
     bool readSection(Section* pSection);
     bool readTable(Table* pTable);
 
+    int openSectionFilter(Poco::UInt16 pid, Poco::UInt8 tableId, Poco::UInt8 tableIdMask, int bufferSize = 0);
+    /// opens a demux file descriptor of its own with a running section filter, that is not shared with other streams
+    void closeSectionFilter(int fileDesc);
+
 private:
     Adapter*                                _pAdapter;
     std::string                             _deviceName;
@@ -22,54 +22,32 @@ namespace Omm {
 namespace Dvb {
 
 
-//Descriptor::Descriptor(void* data) :
-//_data(data)
-//{
-//
-//}
-
-
-Descriptor*
-Descriptor::createDescriptor(void* data)
-{
-    Descriptor* pRes = 0;
-    LOG(dvb, debug, "descriptor tag: 0x" + Poco::NumberFormatter::formatHex(*(Poco::UInt8*)(data)));
-    switch (*(Poco::UInt8*)(data)) {
-        case 0x40:
-            LOG(dvb, debug, "create network name descriptor");
-            pRes = new NetworkNameDescriptor;
-            break;
-        case 0x41:
-            LOG(dvb, debug, "create service list descriptor");
-            pRes = new ServiceListDescriptor;
-            break;
-        case 0x43:
-            LOG(dvb, debug, "create satellite delivery system descriptor");
-            pRes = new SatelliteDeliverySystemDescriptor;
-            break;
-        case 0x48:
-            LOG(dvb, debug, "create service descriptor");
-            pRes = new ServiceDescriptor;
-            break;
-        case 0x5A:
-            LOG(dvb, debug, "create terrestrial delivery system descriptor");
-            pRes = new TerrestrialDeliverySystemDescriptor;
-            break;
-        case 0x62:
-            LOG(dvb, debug, "create frequency list descriptor");
-            pRes = new FrequencyListDescriptor;
-            break;
-        case 0x6D:
-            LOG(dvb, debug, "create cell frequency link descriptor");
-            pRes = new CellFrequencyLinkDescriptor;
-            break;
-        default:
-            LOG(dvb, warning, "descriptor type unkown");
-    }
-    if (pRes) {
-        pRes->_data = data;
-    }
-    return pRes;
+DescriptorIterator::DescriptorIterator(void* data, unsigned int length) :
+_data((Poco::UInt8*)data),
+_length(length),
+_offset(0)
+{
+}
+
+
+bool
+DescriptorIterator::atEnd()
+{
+    return _offset + 2 > _length || _offset + 2 + _data[_offset + 1] > _length;
+}
+
+
+void
+DescriptorIterator::next()
+{
+    _offset += _data[_offset + 1] + 2;
+}
+
+
+Poco::UInt8
+DescriptorIterator::tag()
+{
+    return _data[_offset];
 }
 
 
@@ -134,6 +112,30 @@ ServiceDescriptor::serviceName()
 }
 
 
+std::string
+ShortEventDescriptor::languageCode()
+{
+    return std::string((char*)content(), 3);
+}
+
+
+std::string
+ShortEventDescriptor::eventName()
+{
+    Poco::UInt8 eventNameLength = *((Poco::UInt8*)content() + 3);
+    return filter(std::string((char*)content() + 4, eventNameLength));
+}
+
+
+std::string
+ShortEventDescriptor::text()
+{
+    Poco::UInt8 eventNameLength = *((Poco::UInt8*)content() + 3);
+    Poco::UInt8 textLength = *((Poco::UInt8*)content() + 4 + eventNameLength);
+    return filter(std::string((char*)content() + 5 + eventNameLength, textLength));
+}
+
+
 Poco::UInt8
 ServiceListDescriptor::serviceCount()
 {
@@ -191,6 +193,23 @@ SatelliteDeliverySystemDescriptor::polarization()
 }
 
 
+std::string
+SatelliteDeliverySystemDescriptor::rollOff()
+{
+    Poco::UInt8 val = getValue<Poco::UInt8>(8 * 8 + 3, 2);
+    switch(val) {
+        case 0x00:
+            return SatTransponder::ROLLOFF_0_35;
+        case 0x01:
+            return SatTransponder::ROLLOFF_0_25;
+        case 0x02:
+            return SatTransponder::ROLLOFF_0_20;
+        default:
+            return SatTransponder::ROLLOFF_AUTO;
+    }
+}
+
+
 std::string
 SatelliteDeliverySystemDescriptor::modulationSystem()
 {
@@ -22,12 +22,12 @@ namespace Dvb {
 class Service;
 
 class Descriptor : public BitField
+/// Descriptors are non-owning views on the descriptor bytes of a section buffer.
+/// They are cheap to construct on the stack while walking a DescriptorIterator.
 {
 public:
-//    Descriptor(void* data);
-    static Descriptor* createDescriptor(void* data);
+    Descriptor(void* data) : BitField(data) {}
 
-    virtual void foo() {}
     Poco::UInt8 getId();
     Poco::UInt8 getDescriptorLength();
     Poco::UInt8 getContentLength();
@@ -40,6 +40,10 @@ protected:
 class NetworkNameDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x40};
+
+    NetworkNameDescriptor(void* data) : Descriptor(data) {}
+
     std::string getNetworkName();
 };
 
@@ -47,15 +51,36 @@ public:
 class ServiceDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x48};
+
+    ServiceDescriptor(void* data) : Descriptor(data) {}
+
     Poco::UInt8 serviceType();
     std::string providerName();
     std::string serviceName();
 };
 
 
+class ShortEventDescriptor : public Descriptor
+{
+public:
+    enum {Tag = 0x4D};
+
+    ShortEventDescriptor(void* data) : Descriptor(data) {}
+
+    std::string languageCode();
+    std::string eventName();
+    std::string text();
+};
+
+
 class ServiceListDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x41};
+
+    ServiceListDescriptor(void* data) : Descriptor(data) {}
+
     Poco::UInt8 serviceCount();
     Poco::UInt16 serviceId(Poco::UInt8 index);
     Poco::UInt8 serviceType(Poco::UInt8 index);
@@ -65,10 +90,15 @@ public:
 class SatelliteDeliverySystemDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x43};
+
+    SatelliteDeliverySystemDescriptor(void* data) : Descriptor(data) {}
+
     unsigned int frequency();
     /// returns frequency in kHz
     std::string orbitalPosition();
     std::string polarization();
+    std::string rollOff();
     std::string modulationSystem();
     std::string modulationType();
     Poco::UInt32 symbolRate();
@@ -79,6 +109,10 @@ public:
 class TerrestrialDeliverySystemDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x5A};
+
+    TerrestrialDeliverySystemDescriptor(void* data) : Descriptor(data) {}
+
     unsigned int centreFrequency();
     std::string bandwidth();
     std::string priority();
@@ -97,6 +131,10 @@ public:
 class FrequencyListDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x62};
+
+    FrequencyListDescriptor(void* data) : Descriptor(data) {}
+
     std::string codingType();
     Poco::UInt8 centreFrequencyCount();
     unsigned int centreFrequency(Poco::UInt8 index);
@@ -106,6 +144,57 @@ public:
 class CellFrequencyLinkDescriptor : public Descriptor
 {
 public:
+    enum {Tag = 0x6D};
+
+    CellFrequencyLinkDescriptor(void* data) : Descriptor(data) {}
+};
+
+
+class Ac3Descriptor : public Descriptor
+{
+public:
+    enum {Tag = 0x6A};
+
+    Ac3Descriptor(void* data) : Descriptor(data) {}
+};
+
+
+class EnhancedAc3Descriptor : public Descriptor
+{
+public:
+    enum {Tag = 0x7A};
+
+    EnhancedAc3Descriptor(void* data) : Descriptor(data) {}
+};
+
+
+class DescriptorIterator
+/// Walks a descriptor loop in place, without allocating or copying.
+/// Typed views are obtained by switching on tag():
+///   for (DescriptorIterator it = pSdt->serviceDescriptors(i); !it.atEnd(); it.next()) {
+///       if (it.tag() == ServiceDescriptor::Tag) {
+///           ServiceDescriptor d = it.view<ServiceDescriptor>();
+///       }
+///   }
+/// Iteration stops at a descriptor that is truncated by the loop length.
+{
+public:
+    DescriptorIterator(void* data, unsigned int length);
+
+    bool atEnd();
+    void next();
+    Poco::UInt8 tag();
+
+    template<typename D>
+    D view()
+    {
+        return D(_data + _offset);
+    }
+
+private:
+    Poco::UInt8*        _data;
+    unsigned int        _length;
+    unsigned int        _offset;
 };
 
 
@@ -13,9 +13,11 @@
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 
 #include <stdint.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/ioctl.h>
 
 #ifdef POCO_VERSION_HEADER_FOUND
@@ -45,6 +47,7 @@
 
 #include <Poco/StringTokenizer.h>
 #include <Poco/Thread.h>
+#include <Poco/LocalDateTime.h>
 #include <map>
 
 #include "Sys.h"
@@ -60,6 +63,7 @@
 #include "Remux.h"
 #include "Dvr.h"
 #include "Device.h"
+#include "ChannelDb.h"
 
 
 namespace Omm {
@@ -103,9 +107,10 @@ void
 Adapter::openAdapter()
 {
     for (std::vector<Frontend*>::iterator it = _frontends.begin(); it != _frontends.end(); ++it) {
-        (*it)->openFrontend();
+        if (!(*it)->isOpen()) {
+            (*it)->openFrontend();
+        }
     }
-
 }
 
 
@@ -118,6 +123,18 @@ Adapter::closeAdapter()
 }
 
 
+bool
+Adapter::isOpen()
+{
+    for (std::vector<Frontend*>::iterator it = _frontends.begin(); it != _frontends.end(); ++it) {
+        if ((*it)->isOpen()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 std::string
 Adapter::getId()
 {
@@ -188,9 +205,131 @@ Adapter::writeXml(Poco::XML::Element* pDvbDevice)
 }
 
 
+void
+Adapter::readDb(ChannelDbReader& db)
+{
+    Poco::UInt32 frontendCount = db.readUInt32();
+    for (Poco::UInt32 numFrontend = 0; numFrontend < frontendCount && db.good(); numFrontend++) {
+        std::string frontendType = db.readString();
+        std::string frontendName = db.readString();
+        if (numFrontend >= _frontends.size()) {
+            LOG(dvb, error, "too many frontends for adapter, rescan recommended");
+            break;
+        }
+        Frontend* pFrontend = _frontends[numFrontend];
+        if (frontendType != pFrontend->getType()) {
+            LOG(dvb, error, "frontend type mismatch, rescan recommended");
+            break;
+        }
+        if (frontendName != pFrontend->getName()) {
+            LOG(dvb, error, "frontend name mismatch, rescan recommended");
+            break;
+        }
+        pFrontend->readDb(db);
+    }
+}
+
+
+void
+Adapter::writeDb(ChannelDbWriter& db)
+{
+    db.writeUInt32(_frontends.size());
+    for (std::vector<Frontend*>::iterator it = _frontends.begin(); it != _frontends.end(); ++it) {
+        (*it)->writeDb(db);
+    }
+}
+
+
+std::string
+ServiceStats::getName()
+{
+    return _name;
+}
+
+
+unsigned int
+ServiceStats::getOutputs()
+{
+    return _outputs;
+}
+
+
+Poco::UInt64
+ServiceStats::getBitrate()
+{
+    return _bitrate;
+}
+
+
+Poco::UInt64
+ServiceStats::getPackets()
+{
+    return _packets;
+}
+
+
+Poco::UInt64
+ServiceStats::getPacketsDropped()
+{
+    return _packetsDropped;
+}
+
+
+unsigned int
+ServiceStats::getQueuedPackets()
+{
+    return _queuedPackets;
+}
+
+
+unsigned int
+ServiceStats::getQueuedBytes()
+{
+    return _queuedBytes;
+}
+
+
+std::string
+FrontendStats::getAdapterId()
+{
+    return _adapterId;
+}
+
+
+std::string
+FrontendStats::getFrontendName()
+{
+    return _frontendName;
+}
+
+
+MonitorStats&
+FrontendStats::getMonitorStats()
+{
+    return _monitorStats;
+}
+
+
+SignalStatus&
+FrontendStats::getSignalStatus()
+{
+    return _signalStatus;
+}
+
+
 Device* Device::_pInstance = 0;
 
-Device::Device()
+Device::Device() :
+_eitHarvester(_epg),
+_lingerTimeout(30000),
+_idleTimeout(60000),
+_preTuneWait(100),
+_timeShiftMinutes(0),
+_pacing(false),
+_standbyInterval(10000),
+_pStandbyThread(0),
+_standbyThreadRunnable(*this, &Device::standbyThread),
+_standbyThreadRunning(false)
 {
 }
 
@@ -252,8 +391,18 @@ void
 Device::open()
 {
     LOG(dvb, debug, "device open ...");
-    for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
-        it->second->openAdapter();
+    // with an idle timeout, adapters are opened on demand by allocateFrontend()
+    if (!_idleTimeout) {
+        for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
+            it->second->openAdapter();
+        }
+    }
+    _eitHarvester.startHarvester();
+    _recorder.startRecorder();
+    if (!_pStandbyThread) {
+        _standbyThreadRunning = true;
+        _pStandbyThread = new Poco::Thread;
+        _pStandbyThread->start(_standbyThreadRunnable);
     }
     LOG(dvb, debug, "device open finished.");
 }
@@ -263,6 +412,24 @@ void
 Device::close()
 {
     LOG(dvb, debug, "device close ...");
+    if (_pStandbyThread) {
+        _standbyLock.lock();
+        _standbyThreadRunning = false;
+        _standbyLock.unlock();
+        if (_pStandbyThread->isRunning() && !_pStandbyThread->tryJoin(_standbyInterval)) {
+            LOG(dvb, error, "failed to join standby thread");
+        }
+        delete _pStandbyThread;
+        _pStandbyThread = 0;
+    }
+    _recorder.stopRecorder();
+    _multicast.stopAllStreams();
+    _deviceLock.lock();
+    releaseLingeringServices(0, false);
+    _idleAdapters.clear();
+    _preTuned.clear();
+    _deviceLock.unlock();
+    _eitHarvester.stopHarvester();
     for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
         it->second->closeAdapter();
     }
@@ -271,22 +438,102 @@ Device::close()
 
 
 void
-Device::scan()
+Device::scan(bool fastRescan)
 {
+    // frontends of one adapter share the demux, so only the first frontend of each type and adapter scans
+    std::map<std::string, std::vector<Frontend*> > scanFrontends;
+    std::map<std::string, std::vector<Frontend*> > otherFrontends;
     for (std::map<std::string, Adapter*>::iterator ait = _adapters.begin(); ait != _adapters.end(); ++ait) {
-        LOG(dvb, debug, "scan adapter " + ait->second->_deviceName);
+        // frontends close themselves when their scan is finished
+        ait->second->openAdapter();
+        std::set<std::string> adapterTypes;
         for (std::vector<Frontend*>::iterator fit = ait->second->_frontends.begin(); fit != ait->second->_frontends.end(); ++fit) {
-            LOG(dvb, debug, "scan frontend " + (*fit)->_deviceName + " of type: " + (*fit)->getType());
-            std::map<std::string, std::set<std::string> >::iterator tsit = _initialTransponders.find((*fit)->getType());
+            if (adapterTypes.insert((*fit)->getType()).second) {
+                scanFrontends[(*fit)->getType()].push_back(*fit);
+            }
+            else {
+                otherFrontends[(*fit)->getType()].push_back(*fit);
+            }
+        }
+    }
+
+    for (std::map<std::string, std::vector<Frontend*> >::iterator tit = scanFrontends.begin(); tit != scanFrontends.end(); ++tit) {
+        std::vector<Frontend*>& frontends = tit->second;
+        TransponderScanQueue scanQueue;
+        if (fastRescan) {
+            std::vector<Frontend*> typeFrontends(frontends);
+            typeFrontends.insert(typeFrontends.end(), otherFrontends[tit->first].begin(), otherFrontends[tit->first].end());
+            for (std::vector<Frontend*>::iterator fit = typeFrontends.begin(); fit != typeFrontends.end(); ++fit) {
+                for (std::vector<Transponder*>::iterator it = (*fit)->_transponders.begin(); it != (*fit)->_transponders.end(); ++it) {
+                    // the copies of the last scan on the other frontends are doubles
+                    if (!scanQueue.addTransponder(*it)) {
+                        delete *it;
+                    }
+                }
+                (*fit)->_transponders.clear();
+            }
+            LOG(dvb, debug, "number of transponders to rescan: " + Poco::NumberFormatter::format(scanQueue.knownTransponders().size()));
+        }
+        if (scanQueue.knownTransponders().empty()) {
+            std::map<std::string, std::set<std::string> >::iterator tsit = _initialTransponders.find(tit->first);
+            if (tsit == _initialTransponders.end()) {
+                continue;
+            }
             LOG(dvb, debug, "number of initial transponder lists: " + Poco::NumberFormatter::format(tsit->second.size()));
-            if (tsit != _initialTransponders.end()) {
-                for (std::set<std::string>::iterator tit = tsit->second.begin(); tit != tsit->second.end(); ++tit) {
-                    std::string initialTransponders = *tit;
-                    LOG(dvb, debug, "scan initial transponders " + (*fit)->getType() + "/" + initialTransponders);
-                    (*fit)->scan(initialTransponders);
+            for (std::set<std::string>::iterator lit = tsit->second.begin(); lit != tsit->second.end(); ++lit) {
+                LOG(dvb, debug, "scan initial transponders " + tit->first + "/" + *lit);
+                std::vector<Transponder*> initialTransponders;
+                frontends.front()->getInitialTransponderData(*lit, initialTransponders);
+                LOG(dvb, debug, "number of initial transponders in " + *lit + ": " + Poco::NumberFormatter::format(initialTransponders.size()));
+                for (std::vector<Transponder*>::iterator it = initialTransponders.begin(); it != initialTransponders.end(); ++it) {
+                    if (!scanQueue.addTransponder(*it)) {
+                        LOG(dvb, debug, "initial transponder double");
+                        delete *it;
+                    }
                 }
             }
         }
+
+        LOG(dvb, debug, "scan " + tit->first + " with " + Poco::NumberFormatter::format(frontends.size()) + " frontends ...");
+        std::vector<Poco::Thread*> scanThreads;
+        for (std::vector<Frontend*>::iterator fit = frontends.begin(); fit != frontends.end(); ++fit) {
+            LOG(dvb, debug, "scan frontend " + (*fit)->_deviceName + " of type: " + (*fit)->getType());
+            (*fit)->_pScanQueue = &scanQueue;
+            Poco::Thread* pThread = new Poco::Thread;
+            pThread->start((*fit)->_scanThreadRunnable);
+            scanThreads.push_back(pThread);
+        }
+        for (std::vector<Poco::Thread*>::iterator it = scanThreads.begin(); it != scanThreads.end(); ++it) {
+            (*it)->join();
+            delete *it;
+        }
+        LOG(dvb, debug, "scan " + tit->first + " finished.");
+
+        // each frontend got a share of the transponders, make all of them tunable on every frontend of this type
+        std::vector<std::vector<Transponder*> > scannedTransponders;
+        std::set<Transponder*> keepTransponders;
+        for (std::vector<Frontend*>::iterator fit = frontends.begin(); fit != frontends.end(); ++fit) {
+            scannedTransponders.push_back((*fit)->_transponders);
+            keepTransponders.insert((*fit)->_transponders.begin(), (*fit)->_transponders.end());
+        }
+        for (int f = 0; f < frontends.size(); f++) {
+            for (int other = 0; other < scannedTransponders.size(); other++) {
+                if (other != f) {
+                    frontends[f]->copyTransponders(scannedTransponders[other]);
+                }
+            }
+        }
+        for (std::vector<Frontend*>::iterator fit = otherFrontends[tit->first].begin(); fit != otherFrontends[tit->first].end(); ++fit) {
+            for (int other = 0; other < scannedTransponders.size(); other++) {
+                (*fit)->copyTransponders(scannedTransponders[other]);
+            }
+        }
+        // transponders that could not be tuned or scanned
+        for (std::vector<Transponder*>::const_iterator it = scanQueue.knownTransponders().begin(); it != scanQueue.knownTransponders().end(); ++it) {
+            if (keepTransponders.find(*it) == keepTransponders.end()) {
+                delete *it;
+            }
+        }
     }
 
     initServiceMap();
@@ -368,12 +615,87 @@ Device::writeXml(std::ostream& ostream)
 }
 
 
+bool
+Device::readChannelDb(const std::string& dbPath, const std::string& xmlPath)
+{
+    Poco::File xmlFile(xmlPath);
+    if (!xmlFile.exists()) {
+        return false;
+    }
+    ChannelDbReader db;
+    if (!db.open(dbPath, xmlFile.getLastModified().epochMicroseconds(), xmlFile.getSize())) {
+        return false;
+    }
+    LOG(dvb, debug, "read channel db ...");
+
+    bool consistent = true;
+    Poco::UInt32 adapterCount = db.readUInt32();
+    for (Poco::UInt32 i = 0; i < adapterCount && db.good(); i++) {
+        std::string adapterId = db.readString();
+        // adapters that are not on the system (and frontends that don't match) are skipped as a whole
+        Poco::UInt32 adapterSize = db.readUInt32();
+        unsigned int adapterEnd = db.offset() + adapterSize;
+        std::map<std::string, Adapter*>::iterator it = _adapters.find(adapterId);
+        if (it != _adapters.end()) {
+            it->second->readDb(db);
+        }
+        else {
+            LOG(dvb, error, "could not find adapter with id: " + adapterId + " on system, skipping (rescan recommended)");
+        }
+        if (db.offset() > adapterEnd) {
+            consistent = false;
+            break;
+        }
+        db.skip(adapterEnd - db.offset());
+    }
+    if (!consistent || !db.good()) {
+        // drop what has been read so far, the caller reads the xml description instead
+        // and generates the channel db again
+        LOG(dvb, error, "channel db " + dbPath + " is corrupt, removing it");
+        ::unlink(dbPath.c_str());
+        for (std::map<std::string, Adapter*>::iterator ait = _adapters.begin(); ait != _adapters.end(); ++ait) {
+            for (Adapter::FrontendIterator fit = ait->second->frontendBegin(); fit != ait->second->frontendEnd(); ++fit) {
+                for (std::vector<Transponder*>::iterator it = (*fit)->_transponders.begin(); it != (*fit)->_transponders.end(); ++it) {
+                    delete *it;
+                }
+                (*fit)->_transponders.clear();
+            }
+        }
+        return false;
+    }
+    initServiceMap();
+
+    LOG(dvb, debug, "read channel db.");
+    return true;
+}
+
+
+void
+Device::writeChannelDb(const std::string& dbPath, const std::string& xmlPath)
+{
+    Poco::File xmlFile(xmlPath);
+    if (!xmlFile.exists()) {
+        return;
+    }
+    ChannelDbWriter db(xmlFile.getLastModified().epochMicroseconds(), xmlFile.getSize());
+    db.writeUInt32(_adapters.size());
+    for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
+        db.writeString(it->first);
+        unsigned int sizeOffset = db.offset();
+        db.writeUInt32(0);
+        it->second->writeDb(db);
+        db.patchUInt32(sizeOffset, db.offset() - sizeOffset - sizeof(Poco::UInt32));
+    }
+    db.save(dbPath);
+}
+
+
 Transponder*
 Device::getFirstTransponder(const std::string& serviceName)
 {
-    ServiceIterator it = _serviceMap.find(serviceName);
-    if (it != _serviceMap.end() && it->second.size()) {
-        return it->second[0];
+    std::unordered_map<std::string, std::vector<Transponder*>*>::iterator it = _serviceIndex.find(serviceName);
+    if (it != _serviceIndex.end() && it->second->size()) {
+        return (*it->second)[0];
     }
     else {
         LOG(dvb, error, "could not find transponder for service: " + serviceName);
@@ -385,24 +707,44 @@ Device::getFirstTransponder(const std::string& serviceName)
 std::vector<Transponder*>&
 Device::getTransponders(const std::string& serviceName)
 {
-    return _serviceMap.find(serviceName)->second;
+    std::unordered_map<std::string, std::vector<Transponder*>*>::iterator it = _serviceIndex.find(serviceName);
+    if (it != _serviceIndex.end()) {
+        return *it->second;
+    }
+    else {
+        return _noTransponders;
+    }
+}
+
+
+Service*
+Device::getService(Poco::UInt16 tsid, Poco::UInt16 sid)
+{
+    std::unordered_map<Poco::UInt32, Service*>::iterator it = _serviceIdIndex.find((Poco::UInt32)tsid << 16 | sid);
+    if (it != _serviceIdIndex.end()) {
+        return it->second;
+    }
+    else {
+        return 0;
+    }
 }
 
 
 std::istream*
-Device::getStream(const std::string& serviceName)
+Device::getStream(const std::string& serviceName, Priority priority, long queueTimeout)
 {
     LOG(dvb, debug, "get stream: " + serviceName);
 
     Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
 
+    recordUsage(serviceName);
     // scrambled services are not supported, yet
-    Transponder* pTransponder = tuneToService(serviceName, true);
+    Transponder* pTransponder = tuneToService(serviceName, priority, queueTimeout, true);
     if (!pTransponder) {
         return 0;
     }
     Service* pService = pTransponder->getService(serviceName);
-    pService = startService(pService);
+    pService = startService(pService, priority);
     std::istream* pStream = pService->getStream();
     _streamMap[pStream] = pService;
     return pStream;
@@ -410,21 +752,28 @@ Device::getStream(const std::string& serviceName)
 
 
 AvStream::ByteQueue*
-Device::getByteQueue(const std::string& serviceName)
+Device::getByteQueue(const std::string& serviceName, Priority priority, long queueTimeout, unsigned int streamSelection)
 {
     LOG(dvb, debug, "get bytequeue: " + serviceName);
 
-    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    Service* pService = 0;
+    AvStream::ByteQueue* pStream = 0;
+    {
+        Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
 
-    // scrambled services are not supported, yet
-    Transponder* pTransponder = tuneToService(serviceName, true);
-    if (!pTransponder) {
-        return 0;
+        recordUsage(serviceName);
+        // scrambled services are not supported, yet
+        Transponder* pTransponder = tuneToService(serviceName, priority, queueTimeout, true);
+        if (!pTransponder) {
+            return 0;
+        }
+        pService = pTransponder->getService(serviceName);
+        pService = startService(pService, priority, 0, streamSelection, true);
+        pStream = pService->getByteQueue();
+        _bytequeueMap[pStream] = pService;
     }
-    Service* pService = pTransponder->getService(serviceName);
-    pService = startService(pService);
-    AvStream::ByteQueue* pStream = pService->getByteQueue();
-    _bytequeueMap[pStream] = pService;
+    // allocating the time-shift ring takes a while, the reader frees the service only after this returns
+    pService->openTimeShift();
     return pStream;
 }
 
@@ -455,18 +804,198 @@ Device::freeByteQueue(AvStream::ByteQueue* pIstream)
 
     Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
 
-    Service* pService = _bytequeueMap[pIstream];
-    if (!pService) {
+    std::map<AvStream::ByteQueue*, Service*>::iterator it = _bytequeueMap.find(pIstream);
+    if (it == _bytequeueMap.end()) {
         return;
     }
+    // the byte queue belongs to the service
+    Service* pService = it->second;
+    _bytequeueMap.erase(it);
     stopService(pService);
-    _bytequeueMap.erase(pIstream);
-    delete pIstream;
 
     LOG(dvb, debug, "free bytequeue finished.");
 }
 
 
+void
+Device::setLingerTimeout(long timeout)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    _lingerTimeout = timeout;
+}
+
+
+void
+Device::setIdleTimeout(long timeout)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    _idleTimeout = timeout;
+}
+
+
+void
+Device::setTimeShift(const std::string& directory, unsigned int minutes)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    _timeShiftDirectory = directory;
+    _timeShiftMinutes = minutes;
+}
+
+
+void
+Device::setPacing(bool pacing)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    _pacing = pacing;
+}
+
+
+Service*
+Device::getByteQueueService(AvStream::ByteQueue* pByteQueue)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    std::map<AvStream::ByteQueue*, Service*>::iterator it = _bytequeueMap.find(pByteQueue);
+    return it != _bytequeueMap.end() ? it->second : 0;
+}
+
+
+Service*
+Device::startSplitService(const std::string& serviceName, StreamTarget* pTarget, Priority priority, long queueTimeout)
+{
+    LOG(dvb, debug, "start split service: " + serviceName);
+
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+
+    if (priority != PriorityRecording) {
+        recordUsage(serviceName);
+    }
+    Transponder* pTransponder = tuneToService(serviceName, priority, queueTimeout, true);
+    if (!pTransponder) {
+        return 0;
+    }
+    return startService(pTransponder->getService(serviceName), priority, pTarget);
+}
+
+
+void
+Device::stopSplitService(Service* pService)
+{
+    LOG(dvb, debug, "stop split service: " + pService->getName());
+
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    stopService(pService);
+}
+
+
+Epg&
+Device::getEpg()
+{
+    return _epg;
+}
+
+
+Recorder&
+Device::getRecorder()
+{
+    return _recorder;
+}
+
+
+Multicast&
+Device::getMulticast()
+{
+    return _multicast;
+}
+
+
+void
+Device::getServiceStats(std::vector<ServiceStats>& stats)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    std::map<std::string, ServiceStats> serviceStats;
+    std::map<Frontend*, MonitorStats> monitorStats;
+    for (std::map<Service*, Priority>::iterator it = _servicePriority.begin(); it != _servicePriority.end(); ++it) {
+        Service* pService = it->first;
+        std::map<std::string, ServiceStats>::iterator stat = serviceStats.find(pService->getName());
+        if (stat == serviceStats.end()) {
+            ServiceStats serviceStat;
+            serviceStat._name = pService->getName();
+            serviceStat._outputs = 0;
+            serviceStat._bitrate = 0;
+            serviceStat._packets = 0;
+            serviceStat._packetsDropped = 0;
+            serviceStat._queuedPackets = 0;
+            serviceStat._queuedBytes = 0;
+            // all clones of the service are tuned to the same multiplex
+            Frontend* pFrontend = pService->getTransponder()->_pFrontend;
+            std::map<Frontend*, MonitorStats>::iterator monitor = monitorStats.find(pFrontend);
+            if (monitor == monitorStats.end()) {
+                monitor = monitorStats.insert(std::make_pair(pFrontend, MonitorStats())).first;
+                if (!pFrontend->getMonitorStats(monitor->second)) {
+                    monitor->second.getPidStats().clear();
+                }
+            }
+            std::vector<PidStats>& pidStats = monitor->second.getPidStats();
+            for (std::vector<PidStats>::iterator pid = pidStats.begin(); pid != pidStats.end(); ++pid) {
+                if (pService->hasPacketIdentifier(pid->getPid())) {
+                    serviceStat._bitrate += pid->getBitrate();
+                    serviceStat._packets += pid->getPackets();
+                }
+            }
+            stat = serviceStats.insert(std::make_pair(serviceStat._name, serviceStat)).first;
+        }
+        stat->second._outputs++;
+        stat->second._packetsDropped += pService->getPacketsDropped();
+        stat->second._queuedPackets += pService->getQueuedPackets();
+        stat->second._queuedBytes += pService->getByteQueue()->level();
+    }
+    stats.clear();
+    for (std::map<std::string, ServiceStats>::iterator it = serviceStats.begin(); it != serviceStats.end(); ++it) {
+        stats.push_back(it->second);
+    }
+}
+
+
+void
+Device::getMonitorStats(std::vector<FrontendStats>& stats)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    stats.clear();
+    for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
+        for (Adapter::FrontendIterator fit = it->second->frontendBegin(); fit != it->second->frontendEnd(); ++fit) {
+            FrontendStats stat;
+            // pre-tuning runs without the device lock
+            if (_preTuning.find(*fit) != _preTuning.end() || !(*fit)->getMonitorStats(stat._monitorStats)) {
+                continue;
+            }
+            stat._adapterId = it->first;
+            stat._frontendName = (*fit)->getName();
+            stats.push_back(stat);
+        }
+    }
+}
+
+
+void
+Device::getSignalStats(std::vector<FrontendStats>& stats)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    stats.clear();
+    for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
+        for (Adapter::FrontendIterator fit = it->second->frontendBegin(); fit != it->second->frontendEnd(); ++fit) {
+            FrontendStats stat;
+            // pre-tuning runs without the device lock
+            if (_preTuning.find(*fit) != _preTuning.end() || !(*fit)->getSignalStatus(stat._signalStatus)) {
+                continue;
+            }
+            stat._adapterId = it->first;
+            stat._frontendName = (*fit)->getName();
+            stats.push_back(stat);
+        }
+    }
+}
+
+
 void
 Device::detectAdapters()
 {
@@ -531,6 +1060,8 @@ void
 Device::initServiceMap()
 {
     LOG(dvb, debug, "init service map ...");
+    // the eit harvester looks up services concurrently
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
     clearServiceMap();
 
     for (std::map<std::string, Adapter*>::iterator ait = _adapters.begin(); ait != _adapters.end(); ++ait) {
@@ -538,12 +1069,17 @@ Device::initServiceMap()
             for (std::vector<Transponder*>::iterator tit = (*fit)->_transponders.begin(); tit != (*fit)->_transponders.end(); ++tit) {
                 for (std::vector<Service*>::iterator sit = (*tit)->_services.begin(); sit != (*tit)->_services.end(); ++sit) {
                     _serviceMap[(*sit)->getName()].push_back(*tit);
+                    _serviceIdIndex.insert(std::make_pair((Poco::UInt32)((*tit)->_transportStreamId & 0xffff) << 16 | ((*sit)->getServiceId() & 0xffff), *sit));
 //                    LOG(dvb, trace, (*sit)->getName() + " service map has " + Poco::NumberFormatter::format(_serviceMap[(*sit)->getName()].size()) + " transponders");
 //                    LOG(dvb, trace, "first transponder has freq: " + Poco::NumberFormatter::format(_serviceMap[(*sit)->getName()][0]->getFrequency()));
                 }
             }
         }
     }
+    // map nodes don't move, so the index can point into the map
+    for (std::map<std::string, std::vector<Transponder*> >::iterator it = _serviceMap.begin(); it != _serviceMap.end(); ++it) {
+        _serviceIndex[it->first] = &it->second;
+    }
     LOG(dvb, debug, "init service map finished.");
 }
 
@@ -552,6 +1088,8 @@ void
 Device::clearServiceMap()
 {
     // TODO: delete whole adapter tree
+    _serviceIndex.clear();
+    _serviceIdIndex.clear();
     _serviceMap.clear();
 }
 
@@ -565,84 +1103,117 @@ Device::clearAdapters()
 
 
 Transponder*
-Device::tuneToService(const std::string& serviceName, bool unscrambledOnly)
+Device::tuneToService(const std::string& serviceName, Priority priority, long queueTimeout, bool unscrambledOnly)
 {
-    std::vector<Transponder*>& transponders = getTransponders(serviceName);
+    Poco::Timestamp start;
+    Transponder* pTransponder;
+    while (!(pTransponder = allocateFrontend(serviceName, priority, unscrambledOnly))) {
+        long wait = queueTimeout - start.elapsed() / 1000;
+        if (wait <= 0 && _preTuning.empty()) {
+            LOG(dvb, error, "failed to tune to transponder of service: " + serviceName);
+            return 0;
+        }
+        LOG(dvb, debug, "all frontends busy, queue request for service: " + serviceName);
+        // frontends that are pre-tuning are free again when the tuning finished
+        _frontendFreeCondition.tryWait<Poco::FastMutex>(_deviceLock, std::max(wait, _preTuneWait));
+    }
+    return pTransponder;
+}
+
 
-    Transponder* pTransponder = 0;
-    bool tuneSuccess = false;
+Transponder*
+Device::allocateFrontend(const std::string& serviceName, Priority priority, bool unscrambledOnly)
+{
+    std::vector<Transponder*>& transponders = getTransponders(serviceName);
     LOG(dvb, debug, "number of available frontends: " + Poco::NumberFormatter::format(transponders.size()));
-    for (int t = 0; t < transponders.size(); t++) {
-        LOG(dvb, debug, "try frontend " + Poco::NumberFormatter::format(t));
-        pTransponder = transponders[t];
-        Service* pService = pTransponder->getService(serviceName);
+
+    std::vector<Transponder*> candidates;
+    std::vector<Transponder*> tunedCandidates;
+    std::vector<Transponder*> closedCandidates;
+    for (std::vector<Transponder*>::iterator it = transponders.begin(); it != transponders.end(); ++it) {
+        Service* pService = (*it)->getService(serviceName);
         if (unscrambledOnly && pService->getScrambled()) {
             LOG(dvb, debug, "service is scrambled on this transponder, skipping");
             continue;
         }
-
-        Frontend* pFrontend = pTransponder->_pFrontend;
-        if (!pFrontend->isTuned()) {
-            LOG(dvb, debug, "frontend not tuned, doing so");
-            if (!pFrontend->tune(pTransponder)) {
-                if (transponders.size() > t + 1) {
-                    LOG(dvb, debug, "failed to tune to transponder, trying next one");
-                    continue;
-                }
-                else {
-                    tuneSuccess = false;
-                    break;
-                }
-            }
-            else {
-                tuneSuccess = true;
-                break;
-            }
+        if (_preemptedServices.find(pService) != _preemptedServices.end()) {
+            LOG(dvb, debug, "service was preempted on this transponder and is not freed by its reader, yet, skipping");
+            continue;
         }
-        if (!pFrontend->isTunedTo(pTransponder)) {
-            if (transponders.size() > t + 1) {
-                // there are more frontends available that can tune to a transponder with this service
-                LOG(dvb, debug, "available frontend already tuned to different transponder, try next frontend");
+        if (_preTuning.find((*it)->_pFrontend) != _preTuning.end()) {
+            LOG(dvb, debug, "frontend is pre-tuning, skipping");
+            continue;
+        }
+        // share a frontend that already receives the transponder
+        if ((*it)->_pFrontend->isTunedTo(*it)) {
+            LOG(dvb, debug, "frontend already tuned to requested transponder, skip tuning");
+            return *it;
+        }
+        if (!(*it)->_pFrontend->_pAdapter->isOpen()) {
+            closedCandidates.push_back(*it);
+        }
+        else if ((*it)->_pFrontend->isTuned()) {
+            tunedCandidates.push_back(*it);
+        }
+        else {
+            candidates.push_back(*it);
+        }
+    }
+    // idle frontends that are pre-tuned to another transponder are kept for their service if possible,
+    // and waking up a closed adapter takes longer than tuning an open one
+    candidates.insert(candidates.end(), tunedCandidates.begin(), tunedCandidates.end());
+    candidates.insert(candidates.end(), closedCandidates.begin(), closedCandidates.end());
+    // idle frontends first, then frontends in standby, then the ones with services of lowest priority
+    for (int busyPriority = -2; busyPriority < priority; busyPriority++) {
+        for (std::vector<Transponder*>::iterator it = candidates.begin(); it != candidates.end(); ++it) {
+            Frontend* pFrontend = (*it)->_pFrontend;
+            if (frontendPriority(pFrontend) != busyPriority) {
                 continue;
             }
-            else {
-                // interrupt the services on current transponder and tune to newly requested one
-                LOG(dvb, debug, "no more frontends available, interrupt services and tune to different transponder");
+            if (busyPriority >= 0) {
+                LOG(dvb, information, "preempt services on frontend " + pFrontend->getName() + " for service: " + serviceName);
                 stopServiceStreamsOnTransponder(pFrontend->_pTunedTransponder);
-                if (!pFrontend->tune(pTransponder)) {
-                    if (transponders.size() > t + 1) {
-                        LOG(dvb, debug, "failed to tune to transponder, trying next one");
-                        continue;
-                    }
-                    else {
-                        tuneSuccess = false;
-                        break;
-                    }
-                }
-                else {
-                    tuneSuccess = true;
-                    break;
-                }
             }
+            releaseLingeringServices(pFrontend, false);
+            if (!pFrontend->_pAdapter->isOpen()) {
+                LOG(dvb, information, "open adapter " + pFrontend->_pAdapter->getId() + " for service: " + serviceName);
+                pFrontend->_pAdapter->openAdapter();
+            }
+            if (pFrontend->tune(*it)) {
+                return *it;
+            }
+            LOG(dvb, debug, "failed to tune to transponder, trying next one");
         }
-        else {
-            LOG(dvb, debug, "frontend already tuned to requested transponder, skip tuning");
-            tuneSuccess = true;
+    }
+    return 0;
+}
+
+
+int
+Device::frontendPriority(Frontend* pFrontend)
+{
+    // -2 means the frontend is idle, -1 it's in standby with lingering service filters
+    int priority = -2;
+    if (!pFrontend->isTuned()) {
+        return priority;
+    }
+    for (std::map<Service*, Poco::Timestamp>::iterator it = _lingeringServices.begin(); it != _lingeringServices.end(); ++it) {
+        if (it->first->getTransponder()->_pFrontend == pFrontend) {
+            priority = -1;
             break;
         }
     }
-    if (!tuneSuccess) {
-        LOG(dvb, error, "failed to tune to transponder");
-        return 0;
-    }
-    else {
-        return pTransponder;
+    std::set<Dvb::Service*>& services = pFrontend->_pTunedTransponder->runningServices();
+    for (std::set<Dvb::Service*>::iterator it = services.begin(); it != services.end(); ++it) {
+        std::map<Service*, Priority>::iterator pit = _servicePriority.find(*it);
+        priority = std::max(priority, pit != _servicePriority.end() ? (int)pit->second : (int)PriorityLive);
     }
+    return priority;
 }
 
 
 Service*
-Device::startService(Service* pService)
+Device::startService(Service* pService, Priority priority, StreamTarget* pTarget, unsigned int streamSelection, bool timeShift)
 {
     LOG(dvb, debug, "reading service stream " + pService->getName() + " ...");
 
@@ -651,10 +1222,25 @@ Device::startService(Service* pService)
     Demux* pDemux = pFrontend->_pDemux;
     Dvr* pDvr = pFrontend->_pDvr;
 
+    std::map<Service*, Poco::Timestamp>::iterator it = _lingeringServices.find(pService);
+    // a clone takes over the time-shift, splitter, pacing and stream selection setting of the service on the transponder.
+    // All outputs of the service share one ring, so only outputs of the complete service are time-shifted.
+    pService->setTimeShift(_timeShiftDirectory, (timeShift && streamSelection == Service::SelectAll) ? _timeShiftMinutes : 0);
+    pService->setStreamTarget(pTarget);
+    pService->setPacing(_pacing);
+    pService->setStreamSelection(streamSelection);
     pService = pDvr->addService(pService);
-    pDemux->selectService(pService, Demux::TargetDvr, false);
-    pDemux->runService(pService, true);
+    if (it != _lingeringServices.end()) {
+        // filters are still running, take them over
+        LOG(dvb, debug, "restart lingering service " + pService->getName());
+        _lingeringServices.erase(it);
+    }
+    else {
+        pDemux->selectService(pService, Demux::TargetDvr, false);
+        pDemux->runService(pService, true);
+    }
     pTransponder->markServiceStarted(pService);
+    _servicePriority[pService] = priority;
 
     return pService;
 }
@@ -665,28 +1251,220 @@ Device::stopService(Service* pService)
 {
     LOG(dvb, debug, "stop reading service stream " + pService->getName() + ".");
 
+    std::set<Service*>::iterator pit = _preemptedServices.find(pService);
+    if (pit != _preemptedServices.end()) {
+        // filters and output were stopped on preemption, only the reader was left
+        _preemptedServices.erase(pit);
+        if (pService->isClone()) {
+            delete pService;
+        }
+        return;
+    }
+
     Transponder* pTransponder = pService->getTransponder();
     Demux* pDemux = pTransponder->_pFrontend->_pDemux;
     Dvr* pDvr = pTransponder->_pFrontend->_pDvr;
+    // clones share the streams of the service on the transponder, which is not deleted on stop
+    Service* pTransponderService = pTransponder->getService(pService->getName());
 
-    pDemux->runService(pService, false);
-    pDemux->unselectService(pService);
-    pDvr->delService(pService);
     pTransponder->markServiceStopped(pService);
+    _servicePriority.erase(pService);
+    pDvr->delService(pService);
+    // each output holds a reference on the filters, only the last one of the service lingers,
+    // so that releasing the lingering filters never hits outputs that still run
+    bool lastOutput = true;
+    std::set<Dvb::Service*>& services = pTransponder->runningServices();
+    for (std::set<Dvb::Service*>::iterator it = services.begin(); it != services.end(); ++it) {
+        if ((*it)->getName() == pService->getName()) {
+            lastOutput = false;
+            break;
+        }
+    }
+    if (lastOutput && _lingerTimeout > 0 && pTransponder->_pFrontend->isTunedTo(pTransponder)) {
+        _lingeringServices[pTransponderService] = Poco::Timestamp() + (Poco::Timestamp::TimeDiff)_lingerTimeout * 1000;
+    }
+    else {
+        pDemux->runService(pTransponderService, false);
+        pDemux->unselectService(pTransponderService);
+        if (lastOutput) {
+            // a restart must not take over stopped filters
+            _lingeringServices.erase(pTransponderService);
+        }
+    }
+    _frontendFreeCondition.broadcast();
 }
 
 
 void
 Device::stopServiceStreamsOnTransponder(Transponder* pTransponder)
 {
+    // the frontend is tuned to another transponder, so the services are stopped for good and their readers
+    // get the end of the stream. Services are deleted when their readers free them.
     Demux* pDemux = pTransponder->_pFrontend->_pDemux;
     Dvr* pDvr = pTransponder->_pFrontend->_pDvr;
-    std::set<Dvb::Service*>& services = pTransponder->runningServices();
+    std::set<Dvb::Service*> services = pTransponder->runningServices();
+    std::set<Dvb::Service*> filteredServices;
     for (std::set<Dvb::Service*>::iterator it = services.begin(); it != services.end(); ++it) {
         LOG(dvb, debug, "stop reading service stream " + (*it)->getName() + ".");
         (*it)->stopStream();
+        pDvr->detachService(*it);
+        pTransponder->markServiceStopped(*it);
+        _servicePriority.erase(*it);
+        _preemptedServices.insert(*it);
+        // clones share the filters of the service on the transponder
+        filteredServices.insert(pTransponder->getService((*it)->getName()));
+    }
+    for (std::set<Dvb::Service*>::iterator it = filteredServices.begin(); it != filteredServices.end(); ++it) {
+        pDemux->runService(*it, false);
+        pDemux->unselectService(*it);
+        _lingeringServices.erase(*it);
+    }
+}
+
+
+void
+Device::releaseLingeringServices(Frontend* pFrontend, bool expiredOnly)
+{
+    Poco::Timestamp now;
+    std::map<Service*, Poco::Timestamp>::iterator it = _lingeringServices.begin();
+    while (it != _lingeringServices.end()) {
+        Transponder* pTransponder = it->first->getTransponder();
+        if ((pFrontend && pTransponder->_pFrontend != pFrontend) || (expiredOnly && it->second > now)) {
+            ++it;
+            continue;
+        }
+        LOG(dvb, debug, "release lingering service " + it->first->getName());
+        pTransponder->_pFrontend->_pDemux->runService(it->first, false);
+        pTransponder->_pFrontend->_pDemux->unselectService(it->first);
+        _lingeringServices.erase(it++);
+    }
+}
+
+
+void
+Device::closeIdleAdapters()
+{
+    if (!_idleTimeout) {
+        return;
+    }
+    Poco::Timestamp now;
+    for (std::map<std::string, Adapter*>::iterator it = _adapters.begin(); it != _adapters.end(); ++it) {
+        Adapter* pAdapter = it->second;
+        bool idle = pAdapter->isOpen();
+        for (std::vector<Frontend*>::iterator fit = pAdapter->_frontends.begin(); idle && fit != pAdapter->_frontends.end(); ++fit) {
+            // pre-tuning and harvesting the EIT of the pre-tuned transponder need the adapter
+            idle = (frontendPriority(*fit) == -2 && _preTuned.find(*fit) == _preTuned.end());
+        }
+        std::map<Adapter*, Poco::Timestamp>::iterator iit = _idleAdapters.find(pAdapter);
+        if (!idle) {
+            if (iit != _idleAdapters.end()) {
+                _idleAdapters.erase(iit);
+            }
+        }
+        else if (iit == _idleAdapters.end()) {
+            _idleAdapters[pAdapter] = now + (Poco::Timestamp::TimeDiff)_idleTimeout * 1000;
+        }
+        else if (iit->second <= now) {
+            LOG(dvb, information, "close idle adapter " + pAdapter->getId());
+            pAdapter->closeAdapter();
+            _idleAdapters.erase(iit);
+        }
+    }
+}
+
+
+void
+Device::recordUsage(const std::string& serviceName)
+{
+    std::vector<unsigned int>& usage = _serviceUsage[serviceName];
+    if (usage.empty()) {
+        usage.resize(24, 0);
+    }
+    usage[Poco::LocalDateTime().hour()]++;
+}
+
+
+void
+Device::preTune()
+{
+    _deviceLock.lock();
+    // services most often requested at this hour of day come first
+    int hour = Poco::LocalDateTime().hour();
+    std::multimap<unsigned int, std::string> ranking;
+    for (std::map<std::string, std::vector<unsigned int> >::iterator it = _serviceUsage.begin(); it != _serviceUsage.end(); ++it) {
+        if (it->second[hour]) {
+            ranking.insert(std::make_pair(it->second[hour], it->first));
+        }
     }
-    services.clear();
+    std::set<Frontend*> reserved;
+    std::vector<Transponder*> preTuneTransponders;
+    for (std::multimap<unsigned int, std::string>::reverse_iterator rit = ranking.rbegin(); rit != ranking.rend(); ++rit) {
+        std::vector<Transponder*>& transponders = getTransponders(rit->second);
+        Transponder* pIdle = 0;
+        bool tuned = false;
+        for (std::vector<Transponder*>::iterator it = transponders.begin(); it != transponders.end(); ++it) {
+            Frontend* pFrontend = (*it)->_pFrontend;
+            if (pFrontend->isTunedTo(*it)) {
+                tuned = true;
+                reserved.insert(pFrontend);
+                break;
+            }
+            // closed adapters are not woken up, but a pre-tuned frontend keeps its adapter from closing
+            if (!pIdle && reserved.find(pFrontend) == reserved.end() && pFrontend->isOpen() && frontendPriority(pFrontend) == -2) {
+                pIdle = *it;
+            }
+        }
+        if (!tuned && pIdle) {
+            LOG(dvb, debug, "pre-tune frontend " + pIdle->_pFrontend->getName() + " for service: " + rit->second);
+            reserved.insert(pIdle->_pFrontend);
+            _preTuning.insert(pIdle->_pFrontend);
+            preTuneTransponders.push_back(pIdle);
+        }
+    }
+    _preTuned = reserved;
+    _deviceLock.unlock();
+    if (preTuneTransponders.empty()) {
+        return;
+    }
+    // tuning waits for the lock, so it runs without the device lock. Frontends in _preTuning
+    // are not allocated meanwhile and readers of the tuning state skip them.
+    for (std::vector<Transponder*>::iterator it = preTuneTransponders.begin(); it != preTuneTransponders.end(); ++it) {
+        (*it)->_pFrontend->tune(*it);
+    }
+    Poco::ScopedLock<Poco::FastMutex> lock(_deviceLock);
+    _preTuning.clear();
+    _frontendFreeCondition.broadcast();
+}
+
+
+bool
+Device::standbyThreadRunning()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_standbyLock);
+    return _standbyThreadRunning;
+}
+
+
+void
+Device::standbyThread()
+{
+    LOG(dvb, debug, "standby thread started.");
+
+    Poco::Timestamp lastCheck;
+    while (standbyThreadRunning()) {
+        Poco::Thread::sleep(500);
+        if (!lastCheck.isElapsed((Poco::Timestamp::TimeDiff)_standbyInterval * 1000)) {
+            continue;
+        }
+        lastCheck.update();
+        _deviceLock.lock();
+        releaseLingeringServices(0, true);
+        closeIdleAdapters();
+        _deviceLock.unlock();
+        preTune();
+    }
+
+    LOG(dvb, debug, "standby thread finished.");
 }
 
 
@@ -18,11 +18,13 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 
 #include <Poco/Timestamp.h>
 #include <Poco/Thread.h>
 #include <Poco/RunnableAdapter.h>
 #include <Poco/Mutex.h>
+#include <Poco/Condition.h>
 #include <Poco/Logger.h>
 #include <Poco/Format.h>
 #include <Poco/StringTokenizer.h>
@@ -30,6 +32,11 @@
 #include "Poco/Notification.h"
 
 #include "AvStream.h"
+#include "Monitor.h"
+#include "Frontend.h"
+#include "Epg.h"
+#include "Recorder.h"
+#include "Multicast.h"
 
 namespace Omm {
 namespace Dvb {
@@ -48,6 +55,8 @@ class Demux;
 class Mux;
 class Dvr;
 class Adapter;
+class ChannelDbReader;
+class ChannelDbWriter;
 
 
 class ScanNotification : public Poco::Notification
@@ -80,13 +89,18 @@ public:
 
     void addFrontend(Frontend* pFrontend);
     void openAdapter();
+    /// opens the frontends that are not open, yet, together with their DVR
     void closeAdapter();
+    bool isOpen();
+    /// true if any of the frontends is open
 
     std::string getId();
     void setId(const std::string& id);
 
     void readXml(Poco::XML::Node* pXmlAdapter);
     void writeXml(Poco::XML::Element* pDvbDevice);
+    void readDb(ChannelDbReader& db);
+    void writeDb(ChannelDbWriter& db);
 
 private:
     int                         _num;
@@ -96,13 +110,61 @@ private:
 };
 
 
+class ServiceStats
+{
+    friend class Device;
+
+public:
+    std::string getName();
+    unsigned int getOutputs();
+    /// byte queues, streams and split targets the service is running for
+    Poco::UInt64 getBitrate();
+    /// bits per second of all streams of the service in the multiplex, 0 if the DVR is not monitored
+    Poco::UInt64 getPackets();
+    /// TS packets of the service read from the DVR
+    Poco::UInt64 getPacketsDropped();
+    unsigned int getQueuedPackets();
+    unsigned int getQueuedBytes();
+    /// level of the byte queues of all outputs
+
+private:
+    std::string         _name;
+    unsigned int        _outputs;
+    Poco::UInt64        _bitrate;
+    Poco::UInt64        _packets;
+    Poco::UInt64        _packetsDropped;
+    unsigned int        _queuedPackets;
+    unsigned int        _queuedBytes;
+};
+
+
+class FrontendStats
+{
+    friend class Device;
+
+public:
+    std::string getAdapterId();
+    std::string getFrontendName();
+    MonitorStats& getMonitorStats();
+    SignalStatus& getSignalStatus();
+
+private:
+    std::string         _adapterId;
+    std::string         _frontendName;
+    MonitorStats        _monitorStats;
+    SignalStatus        _signalStatus;
+};
+
+
 class Device
 {
     friend class Adapter;
     friend class SignalCheckThread;
+    friend class EitHarvester;
 
 public:
     typedef enum { ModeDvr, ModeMultiplex, ModeDvrMultiplex, ModeElementaryStreams } Mode;
+    typedef enum { PriorityBackground, PriorityLive, PriorityRecording } Priority;
 
     static Device* instance();
 
@@ -118,18 +180,58 @@ public:
     void detectAdapters();
     void open();
     void close();
-    void scan();
+    void scan(bool fastRescan = false);
+    /// fastRescan starts from the transponders of the last scan instead of the initial transponder lists
+    /// and only reads the table headers of transponders whose PAT, SDT and NIT versions did not change
     void readXml(std::istream& istream);
     void writeXml(std::ostream& ostream);
+    bool readChannelDb(const std::string& dbPath, const std::string& xmlPath);
+    /// load the binary channel db instead of the xml description, fails if the channel db
+    /// is missing, corrupt or was not generated from the xml description at xmlPath in its current state
+    void writeChannelDb(const std::string& dbPath, const std::string& xmlPath);
 
     Transponder* getFirstTransponder(const std::string& serviceName);
     std::vector<Transponder*>& getTransponders(const std::string& serviceName);
-
-    std::istream* getStream(const std::string& serviceName);
-    AvStream::ByteQueue* getByteQueue(const std::string& serviceName);
+    /// empty if there is no service with this name
+    Service* getService(Poco::UInt16 tsid, Poco::UInt16 sid);
+    /// first service with transport stream id tsid and service id sid on any frontend
+
+    std::istream* getStream(const std::string& serviceName, Priority priority = PriorityLive, long queueTimeout = 0);
+    AvStream::ByteQueue* getByteQueue(const std::string& serviceName, Priority priority = PriorityLive, long queueTimeout = 0,
+            unsigned int streamSelection = 0);
+    /// streamSelection is Service::SelectAll or a combination of the Service::Select flags
+    /// services of lower priority are stopped when no frontend is free, with equal or higher priority
+    /// the request waits queueTimeout milliseconds for a frontend to become free and fails then
     void freeStream(std::istream* pIstream);
     void freeByteQueue(AvStream::ByteQueue* pIstream);
     void stopService(Service* pService);
+    void setLingerTimeout(long timeout);
+    /// demux filters of a stopped service are kept running for timeout milliseconds, so that
+    /// restarting it skips filter setup, 0 stops them right away
+    void setIdleTimeout(long timeout);
+    /// adapters are opened when one of their frontends is needed and closed after timeout milliseconds
+    /// without services, 0 opens all adapters in open() and keeps them open. Set it before open().
+    /// Frontends that are pre-tuned to a service often requested at this hour of day keep their adapter open.
+    void setTimeShift(const std::string& directory, unsigned int minutes);
+    /// byte queues of services started from now on are replaced by a ring file in directory with the last minutes
+    /// of the service, shared by all readers of the service that select all of its streams
+    void setPacing(bool pacing);
+    /// services started from now on write into their byte queue at the rate given by the PCR
+    Service* getByteQueueService(AvStream::ByteQueue* pByteQueue);
+    /// service (or clone of it) that writes into pByteQueue
+    Service* startSplitService(const std::string& serviceName, StreamTarget* pTarget, Priority priority, long queueTimeout = 0);
+    /// start serviceName split from the multiplex into pTarget instead of a byte queue
+    void stopSplitService(Service* pService);
+
+    Epg& getEpg();
+    Recorder& getRecorder();
+    Multicast& getMulticast();
+    void getServiceStats(std::vector<ServiceStats>& stats);
+    /// one entry per running service, its clones are counted as further outputs
+    void getMonitorStats(std::vector<FrontendStats>& stats);
+    /// one entry per frontend with an open DVR, without signal status
+    void getSignalStats(std::vector<FrontendStats>& stats);
+    /// one entry per open frontend, without monitor stats
 
 private:
     Device();
@@ -139,19 +241,55 @@ private:
     void initServiceMap();
     void clearServiceMap();
     void clearAdapters();
-    Transponder* tuneToService(const std::string& serviceName, bool unscrambledOnly = true);
-    Service* startService(Service* pService);
+    Transponder* tuneToService(const std::string& serviceName, Priority priority, long queueTimeout, bool unscrambledOnly = true);
+    Transponder* allocateFrontend(const std::string& serviceName, Priority priority, bool unscrambledOnly);
+    int frontendPriority(Frontend* pFrontend);
+    Service* startService(Service* pService, Priority priority, StreamTarget* pTarget = 0, unsigned int streamSelection = 0,
+            bool timeShift = false);
     void stopServiceStreamsOnTransponder(Transponder* pTransponder);
+    void releaseLingeringServices(Frontend* pFrontend, bool expiredOnly);
+    void closeIdleAdapters();
+    void recordUsage(const std::string& serviceName);
+    void preTune();
+    void standbyThread();
+    bool standbyThreadRunning();
 
     static Device*                                      _pInstance;
 
     std::map<std::string, Adapter*>                     _adapters;
-    std::map<std::string, std::vector<Transponder*> >   _serviceMap;
+    std::map<std::string, std::vector<Transponder*> >   _serviceMap;  // ordered by name for listings
+    std::unordered_map<std::string, std::vector<Transponder*>*>  _serviceIndex;  // hashed lookup into _serviceMap
+    std::unordered_map<Poco::UInt32, Service*>          _serviceIdIndex;  // tsid << 16 | sid
+    std::vector<Transponder*>                           _noTransponders;
     std::map<std::istream*, Service*>                   _streamMap;
     std::map<AvStream::ByteQueue*, Service*>            _bytequeueMap;
+    std::map<Service*, Priority>                        _servicePriority;
+    std::set<Service*>                                  _preemptedServices;  // stopped, but not freed by their reader, yet
     std::map<std::string, std::set<std::string> >       _initialTransponders;
+    Epg                                                 _epg;
+    EitHarvester                                        _eitHarvester;
+    Recorder                                            _recorder;
+    Multicast                                           _multicast;
 
     Poco::FastMutex                                     _deviceLock;
+    Poco::Condition                                     _frontendFreeCondition;
+
+    long                                                _lingerTimeout;
+    long                                                _idleTimeout;
+    std::map<Adapter*, Poco::Timestamp>                 _idleAdapters;  // power-down time of open adapters without services
+    std::set<Frontend*>                                 _preTuning;  // frontends tuned by preTune() without the device lock
+    std::set<Frontend*>                                 _preTuned;  // frontends kept tuned for the most requested services, their adapters stay open
+    const long                                          _preTuneWait;
+    std::map<Service*, Poco::Timestamp>                 _lingeringServices;  // expiry time of the filters
+    std::map<std::string, std::vector<unsigned int> >   _serviceUsage;  // number of requests per hour of day
+    std::string                                         _timeShiftDirectory;
+    unsigned int                                        _timeShiftMinutes;
+    bool                                                _pacing;
+    const int                                           _standbyInterval;
+    Poco::Thread*                                       _pStandbyThread;
+    Poco::RunnableAdapter<Device>                       _standbyThreadRunnable;
+    bool                                                _standbyThreadRunning;
+    Poco::FastMutex                                     _standbyLock;
 };
 
 }  // namespace Omm
@@ -271,8 +271,7 @@ public:
     virtual int readFromDevice(char_type* buffer, std::streamsize length)
     {
         if (!_stop) {
-            _byteQueue.read(buffer, length);
-            return length;
+            return _byteQueue.read(buffer, length);
         }
         else {
             return 0;
@@ -56,6 +56,7 @@ Dvr::closeDvr()
         _pRemux->waitForStopRemux();
         _pRemux->flush();
         delete _pRemux;
+        _pRemux = 0;
         if (close(_fileDescDvr)) {
             LOG(dvb, error, "failed to close dvb rec device \"" + _deviceName + "\": " + strerror(errno));
         }
@@ -84,5 +85,34 @@ Dvr::delService(Service* pService)
     }
 }
 
+
+void
+Dvr::detachService(Service* pService)
+{
+    if (_pRemux) {
+        _pRemux->detachService(pService);
+    }
+}
+
+
+bool
+Dvr::getMonitorStats(MonitorStats& stats)
+{
+    if (!_pRemux) {
+        return false;
+    }
+    _pRemux->getMonitorStats(stats);
+    return true;
+}
+
+
+void
+Dvr::resetMonitor()
+{
+    if (_pRemux) {
+        _pRemux->resetMonitor();
+    }
+}
+
 }  // namespace Omm
 }  // namespace Dvb
@@ -22,6 +22,7 @@ namespace Dvb {
 class Adapter;
 class Remux;
 class Service;
+class MonitorStats;
 
 class Dvr
 {
@@ -42,8 +43,13 @@ public:
 
     Service* addService(Service* pService);
     void delService(Service* pService);
+    void detachService(Service* pService);
 
     std::istream* getStream();
+    bool getMonitorStats(MonitorStats& stats);
+    /// false if the DVR is not open
+    void resetMonitor();
+    /// start the stats of the DVR from scratch, after tuning to another transponder
 
 private:
     void readThread();
@@ -13,7 +13,9 @@
 #include <vector>
 #include <Poco/Types.h>
 #include <string.h>
+#include <algorithm>
 
+#include "TransportStream.h"
 #include "ElementaryStream.h"
 
 
@@ -82,5 +84,95 @@ ElementaryStreamPacket::isVideo()
 }
 
 
+const unsigned int ElementaryStreamExtractor::_headerSize = 9;
+
+ElementaryStreamExtractor::ElementaryStreamExtractor() :
+_pid(TransportStreamPacket::NullPacketIdentifier),
+_continuityCounter(0),
+_synced(false),
+_headerLevel(0),
+_headerSkip(0)
+{
+}
+
+
+void
+ElementaryStreamExtractor::reset(Poco::UInt16 pid)
+{
+    _pid = pid;
+    _synced = false;
+    _headerLevel = 0;
+    _headerSkip = 0;
+}
+
+
+Poco::UInt16
+ElementaryStreamExtractor::getPid()
+{
+    return _pid;
+}
+
+
+unsigned int
+ElementaryStreamExtractor::extract(const Poco::UInt8* pTsPacket, const Poco::UInt8*& pData)
+{
+    Poco::UInt16 pid = ((pTsPacket[1] & 0x1f) << 8) | pTsPacket[2];
+    bool payload = pTsPacket[3] & 0x10;
+    if (pid != _pid || !payload || (pTsPacket[1] & 0x80) || (pTsPacket[3] & 0xc0)) {
+        // no payload, transport error or scrambled
+        return 0;
+    }
+    Poco::UInt8 continuityCounter = pTsPacket[3] & 0x0f;
+    bool unitStart = pTsPacket[1] & 0x40;
+    if (_synced && continuityCounter == _continuityCounter) {
+        // duplicate packet
+        return 0;
+    }
+    if (_synced && continuityCounter != ((_continuityCounter + 1) & 0x0f) && !unitStart) {
+        _synced = false;
+    }
+    _continuityCounter = continuityCounter;
+    if (unitStart) {
+        _synced = true;
+        _headerLevel = 0;
+        _headerSkip = 0;
+    }
+    if (!_synced) {
+        return 0;
+    }
+
+    unsigned int offset = TransportStreamPacket::HeaderSize;
+    if (pTsPacket[3] & 0x20) {
+        offset += 1 + pTsPacket[4];
+    }
+    const unsigned int end = TransportStreamPacket::Size;
+    if (offset >= end) {
+        return 0;
+    }
+    // PES header: start code prefix, stream id, packet length, flags and header data length, then header data
+    while (offset < end && _headerLevel < _headerSize) {
+        _header[_headerLevel++] = pTsPacket[offset++];
+        if (_headerLevel == _headerSize) {
+            // only audio, video and private stream 1 have the optional PES header
+            Poco::UInt8 streamId = _header[3];
+            if (_header[0] != 0x00 || _header[1] != 0x00 || _header[2] != 0x01
+                    || !(streamId == 0xbd || (streamId >= 0xc0 && streamId <= 0xef))) {
+                _synced = false;
+                return 0;
+            }
+            _headerSkip = _header[8];
+        }
+    }
+    unsigned int skip = std::min(_headerSkip, end - offset);
+    offset += skip;
+    _headerSkip -= skip;
+    if (offset >= end) {
+        return 0;
+    }
+    pData = pTsPacket + offset;
+    return end - offset;
+}
+
+
 }  // namespace Omm
 }  // namespace Dvb
@@ -39,6 +39,30 @@ private:
 };
 
 
+class ElementaryStreamExtractor
+/// Reassembles the PES packets of one PID from its TS packets and hands out their payload without
+/// the PES headers. MPEG audio, AAC ADTS and AC-3 carry their own framing, so the payload can be
+/// played as is. After a lost packet the payload is skipped up to the start of the next PES packet.
+{
+public:
+    ElementaryStreamExtractor();
+
+    void reset(Poco::UInt16 pid);
+    Poco::UInt16 getPid();
+    unsigned int extract(const Poco::UInt8* pTsPacket, const Poco::UInt8*& pData);
+    /// size of the elementary stream data in the TS packet at pTsPacket, pData points to it
+
+private:
+    static const unsigned int   _headerSize;
+    Poco::UInt16                _pid;
+    Poco::UInt8                 _continuityCounter;
+    bool                        _synced;
+    Poco::UInt8                 _header[9];
+    unsigned int                _headerLevel;
+    unsigned int                _headerSkip;
+};
+
+
 }  // namespace Omm
 }  // namespace Dvb
 
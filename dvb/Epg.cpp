@@ -0,0 +1,323 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <sys/poll.h>
+
+#include <Poco/NumberFormatter.h>
+#include <Poco/Timestamp.h>
+
+#include "Log.h"
+#include "Descriptor.h"
+#include "Section.h"
+#include "Stream.h"
+#include "Service.h"
+#include "Transponder.h"
+#include "Demux.h"
+#include "Frontend.h"
+#include "Device.h"
+#include "Epg.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+EpgEvent::EpgEvent() :
+_eventId(0),
+_startTime(0),
+_duration(0)
+{
+}
+
+
+Poco::UInt16
+EpgEvent::getEventId()
+{
+    return _eventId;
+}
+
+
+std::time_t
+EpgEvent::getStartTime()
+{
+    return _startTime;
+}
+
+
+unsigned int
+EpgEvent::getDuration()
+{
+    return _duration;
+}
+
+
+std::string
+EpgEvent::getName()
+{
+    return _name;
+}
+
+
+std::string
+EpgEvent::getText()
+{
+    return _text;
+}
+
+
+const unsigned int Epg::ScheduleHorizon(8 * 24 * 3600);
+
+void
+Epg::addEvent(Poco::UInt16 tsid, Poco::UInt16 sid, const EpgEvent& event)
+{
+    std::time_t now = std::time(0);
+    std::time_t end = event._startTime + event._duration;
+    if (end <= now || event._startTime > now + ScheduleHorizon) {
+        return;
+    }
+
+    Poco::ScopedLock<Poco::FastMutex> lock(_epgLock);
+    EventMap& events = _events[(Poco::UInt32)tsid << 16 | sid];
+    // a changed schedule replaces all events it overlaps
+    EventMap::iterator first = events.lower_bound(event._startTime);
+    if (first != events.begin()) {
+        EventMap::iterator prev = first;
+        --prev;
+        if (prev->first + prev->second._duration > event._startTime) {
+            first = prev;
+        }
+    }
+    events.erase(first, events.lower_bound(end));
+    events[event._startTime] = event;
+}
+
+
+void
+Epg::getEvents(Poco::UInt16 tsid, Poco::UInt16 sid, std::time_t from, unsigned int maxCount, std::vector<EpgEvent>& events)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_epgLock);
+    std::map<Poco::UInt32, EventMap>::iterator sit = _events.find((Poco::UInt32)tsid << 16 | sid);
+    if (sit == _events.end()) {
+        return;
+    }
+    EventMap::iterator it = sit->second.upper_bound(from);
+    if (it != sit->second.begin()) {
+        EventMap::iterator prev = it;
+        --prev;
+        if (prev->first + prev->second._duration > from) {
+            it = prev;
+        }
+    }
+    for (; it != sit->second.end() && events.size() < maxCount; ++it) {
+        events.push_back(it->second);
+    }
+}
+
+
+void
+Epg::expire(std::time_t now)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_epgLock);
+    std::map<Poco::UInt32, EventMap>::iterator sit = _events.begin();
+    while (sit != _events.end()) {
+        EventMap::iterator it = sit->second.begin();
+        while (it != sit->second.end() && it->first + it->second._duration <= now) {
+            sit->second.erase(it++);
+        }
+        if (sit->second.empty()) {
+            _events.erase(sit++);
+        }
+        else {
+            ++sit;
+        }
+    }
+}
+
+
+unsigned int
+Epg::eventCount()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_epgLock);
+    unsigned int res = 0;
+    for (std::map<Poco::UInt32, EventMap>::iterator it = _events.begin(); it != _events.end(); ++it) {
+        res += it->second.size();
+    }
+    return res;
+}
+
+
+EitHarvester::EitHarvester(Epg& epg) :
+_epg(epg),
+_pollTimeout(1000),
+_pHarvestThread(0),
+_harvestThreadRunnable(*this, &EitHarvester::harvestThread),
+_harvestThreadRunning(false)
+{
+}
+
+
+EitHarvester::~EitHarvester()
+{
+    stopHarvester();
+}
+
+
+void
+EitHarvester::startHarvester()
+{
+    LOG(dvb, debug, "eit harvester thread start ...");
+
+    if (!_pHarvestThread) {
+        _harvestThreadRunning = true;
+        _pHarvestThread = new Poco::Thread;
+        _pHarvestThread->start(_harvestThreadRunnable);
+    }
+}
+
+
+void
+EitHarvester::stopHarvester()
+{
+    if (_pHarvestThread) {
+        LOG(dvb, debug, "eit harvester thread stop ...");
+        _harvesterLock.lock();
+        _harvestThreadRunning = false;
+        _harvesterLock.unlock();
+        if (_pHarvestThread->isRunning() && !_pHarvestThread->tryJoin(2 * _pollTimeout)) {
+            LOG(dvb, error, "failed to join eit harvester thread");
+        }
+        delete _pHarvestThread;
+        _pHarvestThread = 0;
+    }
+}
+
+
+bool
+EitHarvester::harvestThreadRunning()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_harvesterLock);
+    return _harvestThreadRunning;
+}
+
+
+void
+EitHarvester::updateSectionFilters()
+{
+    Device* pDevice = Device::instance();
+    // tuning state of the frontends changes under the device lock
+    Poco::ScopedLock<Poco::FastMutex> lock(pDevice->_deviceLock);
+    for (Device::AdapterIterator ait = pDevice->adapterBegin(); ait != pDevice->adapterEnd(); ++ait) {
+        for (Adapter::FrontendIterator fit = ait->second->frontendBegin(); fit != ait->second->frontendEnd(); ++fit) {
+            if (pDevice->_preTuning.find(*fit) != pDevice->_preTuning.end()) {
+                // tuning runs without the device lock, check again next time
+                continue;
+            }
+            std::map<Frontend*, int>::iterator it = _sectionFilters.find(*fit);
+            if ((*fit)->isTuned() && it == _sectionFilters.end()) {
+                // all EIT table ids 0x4E - 0x6F are carried on this pid, other tables are dropped in readEvents()
+                int fileDesc = (*fit)->_pDemux->openSectionFilter(0x12, 0x40, 0xc0, 128 * 1024);
+                if (fileDesc >= 0) {
+                    LOG(dvb, debug, "eit harvester start harvesting on frontend " + (*fit)->getName());
+                    _sectionFilters[*fit] = fileDesc;
+                }
+            }
+            else if (!(*fit)->isTuned() && it != _sectionFilters.end()) {
+                (*fit)->_pDemux->closeSectionFilter(it->second);
+                _sectionFilters.erase(it);
+            }
+        }
+    }
+}
+
+
+void
+EitHarvester::readEvents(EitSection& eit)
+{
+    if (eit.tableId() < EitSection::EitActualPresentFollowingTableId || eit.tableId() > EitSection::EitOtherScheduleLastTableId) {
+        return;
+    }
+    // other-network EIT carries events of many services that are not in the channel list
+    Device* pDevice = Device::instance();
+    pDevice->_deviceLock.lock();
+    bool known = pDevice->getService(eit.transportStreamId(), eit.serviceId());
+    pDevice->_deviceLock.unlock();
+    if (!known) {
+        return;
+    }
+    eit.parse();
+    for (unsigned int e = 0; e < eit.eventCount(); e++) {
+        EpgEvent event;
+        event._eventId = eit.eventId(e);
+        event._startTime = eit.startTime(e);
+        event._duration = eit.duration(e);
+        for (DescriptorIterator it = eit.eventDescriptors(e); !it.atEnd(); it.next()) {
+            if (it.tag() == ShortEventDescriptor::Tag) {
+                ShortEventDescriptor d = it.view<ShortEventDescriptor>();
+                event._name = d.eventName();
+                event._text = d.text();
+            }
+        }
+        _epg.addEvent(eit.transportStreamId(), eit.serviceId(), event);
+    }
+}
+
+
+void
+EitHarvester::harvestThread()
+{
+    LOG(dvb, debug, "eit harvester thread started.");
+
+    EitSection eit(EitSection::EitActualPresentFollowingTableId);
+    std::vector<struct pollfd> fileDescPoll;
+    Poco::Timestamp lastExpire;
+    while (harvestThreadRunning()) {
+        updateSectionFilters();
+        if (_sectionFilters.empty()) {
+            Poco::Thread::sleep(_pollTimeout);
+            continue;
+        }
+        fileDescPoll.clear();
+        for (std::map<Frontend*, int>::iterator it = _sectionFilters.begin(); it != _sectionFilters.end(); ++it) {
+            struct pollfd p;
+            p.fd = it->second;
+            p.events = POLLIN;
+            p.revents = 0;
+            fileDescPoll.push_back(p);
+        }
+        int pollRes = poll(&fileDescPoll[0], fileDescPoll.size(), _pollTimeout);
+        if (pollRes == -1) {
+            LOG(dvb, error, "eit harvester poll failed: " + std::string(strerror(errno)));
+            Poco::Thread::sleep(_pollTimeout);
+            continue;
+        }
+        for (std::vector<struct pollfd>::iterator it = fileDescPoll.begin(); pollRes > 0 && it != fileDescPoll.end(); ++it) {
+            if ((it->revents & POLLIN) && eit.read(it->fd)) {
+                readEvents(eit);
+            }
+        }
+        if (lastExpire.isElapsed(60 * 1000000)) {
+            _epg.expire(std::time(0));
+            lastExpire.update();
+            LOG(dvb, debug, "eit harvester cached events: " + Poco::NumberFormatter::format(_epg.eventCount()));
+        }
+    }
+    for (std::map<Frontend*, int>::iterator it = _sectionFilters.begin(); it != _sectionFilters.end(); ++it) {
+        it->first->_pDemux->closeSectionFilter(it->second);
+    }
+    _sectionFilters.clear();
+
+    LOG(dvb, debug, "eit harvester thread finished.");
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
@@ -0,0 +1,108 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef Epg_INCLUDED
+#define Epg_INCLUDED
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <Poco/Types.h>
+#include <Poco/Thread.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Mutex.h>
+
+
+namespace Omm {
+namespace Dvb {
+
+class Frontend;
+class EitSection;
+
+
+class EpgEvent
+{
+    friend class Epg;
+    friend class EitHarvester;
+
+public:
+    EpgEvent();
+
+    Poco::UInt16 getEventId();
+    std::time_t getStartTime();
+    unsigned int getDuration();
+    std::string getName();
+    std::string getText();
+
+private:
+    Poco::UInt16        _eventId;
+    std::time_t         _startTime;
+    unsigned int        _duration;
+    std::string         _name;
+    std::string         _text;
+};
+
+
+class Epg
+/// In-memory cache of event information, indexed by transport stream id,
+/// service id and start time. Queries only take the cache lock and never tune.
+{
+public:
+    static const unsigned int ScheduleHorizon;
+
+    void addEvent(Poco::UInt16 tsid, Poco::UInt16 sid, const EpgEvent& event);
+    void getEvents(Poco::UInt16 tsid, Poco::UInt16 sid, std::time_t from, unsigned int maxCount, std::vector<EpgEvent>& events);
+    /// events that did not end before from, ordered by start time, so the first event is the present one
+    void expire(std::time_t now);
+    unsigned int eventCount();
+
+private:
+    typedef std::map<std::time_t, EpgEvent> EventMap;
+
+    std::map<Poco::UInt32, EventMap>    _events;
+    Poco::FastMutex                     _epgLock;
+};
+
+
+class EitHarvester
+/// Collects EIT present/following and schedule sections of all tuned frontends
+/// in the background, by means of a separate section filter on each demux.
+{
+public:
+    EitHarvester(Epg& epg);
+    ~EitHarvester();
+
+    void startHarvester();
+    void stopHarvester();
+
+private:
+    void harvestThread();
+    bool harvestThreadRunning();
+    void updateSectionFilters();
+    void readEvents(EitSection& eit);
+
+    Epg&                                _epg;
+    std::map<Frontend*, int>            _sectionFilters;
+    const int                           _pollTimeout;
+    Poco::Thread*                       _pHarvestThread;
+    Poco::RunnableAdapter<EitHarvester> _harvestThreadRunnable;
+    bool                                _harvestThreadRunning;
+    Poco::FastMutex                     _harvesterLock;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
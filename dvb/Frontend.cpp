@@ -11,10 +11,12 @@
  ***************************************************************************/
 
 #include <sstream>
+#include <algorithm>
 
 #include <linux/dvb/frontend.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/poll.h>
 
 #include <Poco/NumberParser.h>
 #include <Poco/DOM/AbstractContainerNode.h>
@@ -32,9 +34,6 @@
 #include <Poco/DOM/Text.h>
 #include <Poco/DOM/AutoPtr.h>
 #include <Poco/DOM/Document.h>
-#include <Poco/Zip/ZipArchive.h>
-#include <Poco/Zip/ZipStream.h>
-#include <Poco/StringTokenizer.h>
 
 #include "Log.h"
 #include "Descriptor.h"
@@ -51,6 +50,7 @@
 #include "Service.h"
 #include "Section.h"
 #include "Remux.h"
+#include "ChannelDb.h"
 
 
 namespace Omm {
@@ -95,6 +95,110 @@ SignalCheckThread::stop()
 }
 
 
+TransponderScanQueue::TransponderScanQueue() :
+_scanningCount(0)
+{
+}
+
+
+bool
+TransponderScanQueue::addTransponder(Transponder* pTransponder)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_queueLock);
+    for (std::vector<Transponder*>::iterator it = _knownTransponders.begin(); it != _knownTransponders.end(); ++it) {
+        if ((*it)->equal(pTransponder)) {
+            LOG(dvb, trace, "known transponder (freq: " + Poco::NumberFormatter::format(pTransponder->getFrequency()) + ", tsid: " + Poco::NumberFormatter::format(pTransponder->getTransportStreamId()) + ")");
+            return false;
+        }
+    }
+    LOG(dvb, trace, "new transponder (freq: " + Poco::NumberFormatter::format(pTransponder->getFrequency()) + ", tsid: " + Poco::NumberFormatter::format(pTransponder->getTransportStreamId()) + ")");
+    _knownTransponders.push_back(pTransponder);
+    _pendingTransponders.push_back(pTransponder);
+    _queueCondition.broadcast();
+    return true;
+}
+
+
+Transponder*
+TransponderScanQueue::takeTransponder()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_queueLock);
+    // a frontend that is still scanning may append more transponders from its NIT
+    while (_pendingTransponders.empty() && _scanningCount > 0) {
+        _queueCondition.wait<Poco::FastMutex>(_queueLock);
+    }
+    if (_pendingTransponders.empty()) {
+        return 0;
+    }
+    Transponder* pTransponder = _pendingTransponders.front();
+    _pendingTransponders.pop_front();
+    _scanningCount++;
+    return pTransponder;
+}
+
+
+void
+TransponderScanQueue::transponderDone()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_queueLock);
+    _scanningCount--;
+    _queueCondition.broadcast();
+}
+
+
+const std::vector<Transponder*>&
+TransponderScanQueue::knownTransponders()
+{
+    return _knownTransponders;
+}
+
+
+
+SignalStatus::SignalStatus() :
+_lock(false),
+_signal(-1),
+_snr(-1),
+_ber(-1),
+_uncorrectedBlocks(-1)
+{
+}
+
+
+bool
+SignalStatus::getLock()
+{
+    return _lock;
+}
+
+
+int
+SignalStatus::getSignal()
+{
+    return _signal;
+}
+
+
+int
+SignalStatus::getSnr()
+{
+    return _snr;
+}
+
+
+Poco::Int64
+SignalStatus::getBer()
+{
+    return _ber;
+}
+
+
+Poco::Int64
+SignalStatus::getUncorrectedBlocks()
+{
+    return _uncorrectedBlocks;
+}
+
+
 const std::string Frontend::Unknown("unknown");
 const std::string Frontend::DVBS("dvb-s");
 const std::string Frontend::DVBT("dvb-t");
@@ -106,7 +210,10 @@ _fileDescFrontend(-1),
 _pAdapter(pAdapter),
 _num(num),
 _frontendTimeout(2000000),
-_pTunedTransponder(0)
+_carrierTimeout(800000),
+_pTunedTransponder(0),
+_pScanQueue(0),
+_scanThreadRunnable(*this, &Frontend::scanThread)
 {
     _deviceName = _pAdapter->_deviceName + "/frontend" + Poco::NumberFormatter::format(_num);
     _pDemux = new Demux(pAdapter, 0);
@@ -234,6 +341,9 @@ Frontend::openFrontend()
 void
 Frontend::closeFrontend()
 {
+    if (_fileDescFrontend < 0) {
+        return;
+    }
     LOG(dvb, debug, "close frontend");
 
     if (_transponders.size()) {
@@ -246,31 +356,65 @@ Frontend::closeFrontend()
     if (close(_fileDescFrontend)) {
         LOG(dvb, error, "failed to close frontend: " + std::string(strerror(errno)));
     }
+    _fileDescFrontend = -1;
+    // tuning is lost, the frontend is powered down by the driver
+    _pTunedTransponder = 0;
+}
+
+
+bool
+Frontend::isOpen()
+{
+    return _fileDescFrontend >= 0;
 }
 
 
 void
-Frontend::scan(const std::string& initialTransponderData)
-{
-    // TODO: clear transponder lists?
-    getInitialTransponderData(initialTransponderData);
-    LOG(dvb, debug, "number of initial transponders in " + initialTransponderData + ": " + Poco::NumberFormatter::format(_initialTransponders.size()));
-    for (std::vector<Transponder*>::iterator it = _initialTransponders.begin(); it != _initialTransponders.end(); ++it) {
-        LOG(dvb, trace, "initial transponder (freq: " + Poco::NumberFormatter::format((*it)->_frequency) + ", tsid: " + Poco::NumberFormatter::format((*it)->_transportStreamId) + ")");
-        if (tune(*it)) {
-            scanTransponder(*it);
-            if (addKnownTransponder(*it)) {
-                addTransponder(*it);
-            }
-            else {
-                LOG(dvb, error, "initial transponder double");
-            }
+Frontend::scan(TransponderScanQueue& scanQueue)
+{
+    _pScanQueue = &scanQueue;
+    Transponder* pTransponder;
+    while ((pTransponder = _pScanQueue->takeTransponder())) {
+        LOG(dvb, trace, "frontend " + _deviceName + " scan transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ", tsid: " + Poco::NumberFormatter::format(pTransponder->_transportStreamId) + ")");
+        // transponders are created by the frontend that read the initial data or the NIT
+        pTransponder->_pFrontend = this;
+        bool known = pTransponder->hasTableVersions();
+        if (tune(pTransponder) && (known ? rescanTransponder(pTransponder) : scanTransponder(pTransponder))) {
+            addTransponder(pTransponder);
         }
+        else if (known) {
+            // a transponder of the last scan that can't be received right now (weather, busy LNB)
+            // keeps its services, instead of dropping them from the channel list
+            LOG(dvb, warning, "frontend " + _deviceName + " failed to rescan transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + "), keeping it");
+            addTransponder(pTransponder);
+        }
+        // transponder stays in the known list of the queue, it's deleted after the scan
+        _pScanQueue->transponderDone();
     }
+    _pScanQueue = 0;
     closeFrontend();
 }
 
 
+void
+Frontend::copyTransponders(const std::vector<Transponder*>& transponders)
+{
+    Poco::AutoPtr<Poco::XML::Document> pDoc = new Poco::XML::Document;
+    Poco::AutoPtr<Poco::XML::Element> pXmlFrontend = pDoc->createElement("frontend");
+    pDoc->appendChild(pXmlFrontend);
+    for (std::vector<Transponder*>::const_iterator it = transponders.begin(); it != transponders.end(); ++it) {
+        (*it)->writeXml(pXmlFrontend);
+    }
+    for (Poco::XML::Node* pXmlTransponder = pXmlFrontend->firstChild(); pXmlTransponder; pXmlTransponder = pXmlTransponder->nextSibling()) {
+        unsigned int freq = Poco::NumberParser::parse(static_cast<Poco::XML::Element*>(pXmlTransponder)->getAttribute("frequency"));
+        unsigned int tid = Poco::NumberParser::parse(static_cast<Poco::XML::Element*>(pXmlTransponder)->getAttribute("tsid"));
+        Transponder* pTransponder = createTransponder(freq, tid);
+        pTransponder->readXml(pXmlTransponder);
+        addTransponder(pTransponder);
+    }
+}
+
+
 void
 Frontend::readXml(Poco::XML::Node* pXmlFrontend)
 {
@@ -336,6 +480,37 @@ Frontend::writeXml(Poco::XML::Element* pAdapter)
 }
 
 
+void
+Frontend::readDb(ChannelDbReader& db)
+{
+    Poco::UInt32 transponderCount = db.readUInt32();
+    for (Poco::UInt32 i = 0; i < transponderCount && db.good(); i++) {
+        unsigned int freq = db.readUInt32();
+        unsigned int tid = db.readInt32();
+        Transponder* pTransponder = createTransponder(freq, tid);
+        if (!pTransponder) {
+            LOG(dvb, error, "dvb frontend type unknown, cannot create transponders");
+            return;
+        }
+        pTransponder->readDb(db);
+        addTransponder(pTransponder);
+    }
+}
+
+
+void
+Frontend::writeDb(ChannelDbWriter& db)
+{
+    // type and name are checked by the adapter before the frontend reads the rest
+    db.writeString(getType());
+    db.writeString(getName());
+    db.writeUInt32(_transponders.size());
+    for (std::vector<Transponder*>::iterator it = _transponders.begin(); it != _transponders.end(); ++it) {
+        (*it)->writeDb(db);
+    }
+}
+
+
 const std::string
 Frontend::getType()
 {
@@ -390,14 +565,62 @@ Frontend::isTunedTo(Transponder* pTransponder)
 }
 
 
+void
+Frontend::setTunedTransponder(Transponder* pTransponder)
+{
+    if (pTransponder != _pTunedTransponder && _pDvr) {
+        _pDvr->resetMonitor();
+    }
+    _pTunedTransponder = pTransponder;
+}
+
+
+bool
+Frontend::getMonitorStats(MonitorStats& stats)
+{
+    return _pDvr && _pDvr->getMonitorStats(stats);
+}
+
+
+bool
+Frontend::getSignalStatus(SignalStatus& status)
+{
+    if (_fileDescFrontend < 0) {
+        return false;
+    }
+    fe_status_t feStatus;
+    uint16_t signal, snr;
+    uint32_t ber, uncorrectedBlocks;
+
+    if (ioctl(_fileDescFrontend, FE_READ_STATUS, &feStatus) == -1) {
+        LOG(dvb, error, "FE_READ_STATUS failed");
+        return false;
+    }
+    status = SignalStatus();
+    status._lock = feStatus & FE_HAS_LOCK;
+    // some frontends don't support all these ioctls, the values stay at -1
+    if (ioctl(_fileDescFrontend, FE_READ_SIGNAL_STRENGTH, &signal) != -1) {
+        status._signal = signal;
+    }
+    if (ioctl(_fileDescFrontend, FE_READ_SNR, &snr) != -1) {
+        status._snr = snr;
+    }
+    if (ioctl(_fileDescFrontend, FE_READ_BER, &ber) != -1) {
+        status._ber = ber;
+    }
+    if (ioctl(_fileDescFrontend, FE_READ_UNCORRECTED_BLOCKS, &uncorrectedBlocks) != -1) {
+        status._uncorrectedBlocks = uncorrectedBlocks;
+    }
+    return true;
+}
+
+
 void
 Frontend::listInitialTransponderData()
 {
-    LOG(dvb, debug, "compressed transponder data size: " + Poco::NumberFormatter::format(TransponderData::instance()->getResource("transponder.zip").size()));
-    std::istringstream ss(TransponderData::instance()->getResource("transponder.zip"));
-    Poco::Zip::ZipArchive arch(ss);
-    for (Poco::Zip::ZipArchive::FileInfos::const_iterator it = arch.fileInfoBegin(); it != arch.fileInfoEnd(); ++it) {
-        LOG(dvb, debug, it->second.getFileName());
+    LOG(dvb, debug, "number of initial transponder lists: " + Poco::NumberFormatter::format(TransponderData::listCount));
+    for (unsigned int i = 0; i < TransponderData::listCount; i++) {
+        LOG(dvb, debug, TransponderData::lists[i].name);
     }
 }
 
@@ -405,53 +628,43 @@ Frontend::listInitialTransponderData()
 void
 Frontend::getInitialTransponderKeys(std::vector<std::string>& keys)
 {
-    std::istringstream ss(TransponderData::instance()->getResource("transponder.zip"), std::ios::binary);
-    Poco::Zip::ZipArchive arch(ss);
-
-    for (Poco::Zip::ZipArchive::FileHeaders::const_iterator it = arch.headerBegin(); it != arch.headerEnd(); ++it) {
-        Poco::StringTokenizer frontendKey(it->first, "/");
-        if (frontendKey[0] == getType() && frontendKey.count() > 1) {
-            keys.push_back(frontendKey[1]);
+    std::string prefix = getType() + "/";
+    for (unsigned int i = 0; i < TransponderData::listCount; i++) {
+        std::string name(TransponderData::lists[i].name);
+        if (name.compare(0, prefix.size(), prefix) == 0 && name.size() > prefix.size()) {
+            keys.push_back(name.substr(prefix.size()));
         }
     }
 }
 
 
+static bool
+initialTransponderListLess(const InitialTransponderList& list, const std::string& name)
+{
+    return name.compare(list.name) > 0;
+}
+
+
 void
-Frontend::getInitialTransponderData(const std::string& key)
+Frontend::getInitialTransponderData(const std::string& key, std::vector<Transponder*>& transponders)
 {
-    std::istringstream ss(TransponderData::instance()->getResource("transponder.zip"), std::ios::binary);
-    Poco::Zip::ZipArchive arch(ss);
-    Poco::Zip::ZipArchive::FileHeaders::const_iterator it = arch.findHeader(getType() + "/" + key);
-    if (it == arch.headerEnd()) {
-        LOG(dvb, error, "transponder data not found for: " + getType() + "/" + key);
+    std::string name = getType() + "/" + key;
+    const InitialTransponderList* pListEnd = TransponderData::lists + TransponderData::listCount;
+    const InitialTransponderList* pList = std::lower_bound(TransponderData::lists, pListEnd, name, initialTransponderListLess);
+    if (pList == pListEnd || name != pList->name) {
+        LOG(dvb, error, "transponder data not found for: " + name);
         return;
     }
-    Poco::Zip::ZipInputStream zipin(ss, it->second);
-    std::string line;
-    while (getline(zipin, line)) {
-        std::string::size_type pos = line.find('#');
-        line = line.substr(0, pos);
-        if (line.length() == 0) {
-            continue;
-        }
-        LOG(dvb, debug, line);
-
-        Poco::StringTokenizer params(line, " ");
-        unsigned int freq = 0;
-        try {
-            freq = Poco::NumberParser::parse(params[1]);
-        }
-        catch (Poco::Exception& e) {
-            LOG(dvb, error, "transponder data without frequency: " + line);
-            continue;
-        }
-        Transponder* pTransponder = createTransponder(freq, Transponder::InvalidTransportStreamId);
+    for (unsigned int i = 0; i < pList->transponderCount; i++) {
+        const InitialTransponder& data = pList->transponders[i];
+        std::vector<std::string> params(data.params, data.params + data.paramCount);
+        Transponder* pTransponder = createTransponder(data.frequency, Transponder::InvalidTransportStreamId);
         if (pTransponder->initTransponder(params)) {
-            _initialTransponders.push_back(pTransponder);
+            transponders.push_back(pTransponder);
         }
         else {
-            LOG(dvb, error, "transponder initialization failed: " + line);
+            LOG(dvb, error, "transponder initialization failed: " + name + ", frequency: " + Poco::NumberFormatter::format(data.frequency));
+            delete pTransponder;
         }
     }
 }
@@ -460,71 +673,91 @@ Frontend::getInitialTransponderData(const std::string& key)
 void
 Frontend::checkFrontend()
 {
-    fe_status_t status;
-    uint16_t snr, signal;
-    uint32_t ber, uncorrected_blocks;
-//     int timeout = 0;
-
-    if (ioctl(_fileDescFrontend, FE_READ_STATUS, &status) == -1) {
-        LOG(dvb, error, "FE_READ_STATUS failed");
-    }
-    /* some frontends might not support all these ioctls, thus we
-    * avoid printing errors */
-    if (ioctl(_fileDescFrontend, FE_READ_SIGNAL_STRENGTH, &signal) == -1) {
-        signal = -2;
-    }
-    if (ioctl(_fileDescFrontend, FE_READ_SNR, &snr) == -1) {
-        snr = -2;
-    }
-    if (ioctl(_fileDescFrontend, FE_READ_BER, &ber) == -1) {
-        ber = -2;
-    }
-    if (ioctl(_fileDescFrontend, FE_READ_UNCORRECTED_BLOCKS, &uncorrected_blocks) == -1) {
-        uncorrected_blocks = -2;
+    SignalStatus status;
+    if (getSignalStatus(status) && status.getLock()) {
+        LOG(dvb, debug, "FE_HAS_LOCK");
     }
+}
 
-    /*
-    if (human_readable) {
-        printf ("status %02x | signal %3u%% | snr %3u%% | ber %d | unc %d | ",
-                status, (signal * 100) / 0xffff, (snr * 100) / 0xffff, ber, uncorrected_blocks);
-    } else {
-        printf ("status %02x | signal %04x | snr %04x | ber %08x | unc %08x | ",
-                status, signal, snr, ber, uncorrected_blocks);
-    }
-    */
 
-    if (status & FE_HAS_LOCK) {
-        LOG(dvb, debug, "FE_HAS_LOCK");
-    }
+void
+Frontend::scanThread()
+{
+    LOG(dvb, debug, "scan thread of frontend " + _deviceName + " started.");
+    scan(*_pScanQueue);
+    LOG(dvb, debug, "scan thread of frontend " + _deviceName + " finished.");
 }
 
 
 bool
-Frontend::addKnownTransponder(Transponder* pTransponder)
+Frontend::setProperties(std::vector<struct dtv_property>& properties)
 {
-    LOG(dvb, trace, "addKnownTransponder");
-    for (std::vector<Transponder*>::iterator it = _scannedTransponders.begin(); it != _scannedTransponders.end(); ++it) {
-        if ((*it)->equal(pTransponder)) {
-            LOG(dvb, trace, "known transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ", tsid: " + Poco::NumberFormatter::format(pTransponder->_transportStreamId) + ")");
-            return false;
-        }
+    std::vector<struct dtv_property> commands;
+    addProperty(commands, DTV_CLEAR, 0);
+    commands.insert(commands.end(), properties.begin(), properties.end());
+    addProperty(commands, DTV_TUNE, 0);
+
+    struct dtv_properties cmdseq;
+    cmdseq.num = commands.size();
+    cmdseq.props = &commands[0];
+    if (ioctl(_fileDescFrontend, FE_SET_PROPERTY, &cmdseq) == -1) {
+        LOG(dvb, error, "FE_SET_PROPERTY failed: " + std::string(strerror(errno)));
+        return false;
     }
-    LOG(dvb, trace, "new transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ", tsid: " + Poco::NumberFormatter::format(pTransponder->_transportStreamId) + ")");
-    _scannedTransponders.push_back(pTransponder);
     return true;
 }
 
 
+void
+Frontend::addProperty(std::vector<struct dtv_property>& properties, Poco::UInt32 cmd, Poco::UInt32 data)
+{
+    struct dtv_property property;
+    std::memset(&property, 0, sizeof(property));
+    property.cmd = cmd;
+    property.u.data = data;
+    properties.push_back(property);
+}
+
+
 bool
-Frontend::waitForLock(Poco::Timestamp::TimeDiff timeout)
+Frontend::waitForLock(Transponder* pTransponder)
 {
-    LOG(dvb, debug, "frontend wait for lock ...");
-    Poco::Timestamp now;
-    while (!timeout || (!hasLock() && now.elapsed() < timeout)) {
-        Poco::Thread::sleep(10);
+    // tuning (FE_SET_FRONTEND or DTV_TUNE) empties the event queue, so all events read here belong to the current tuning
+    Poco::Timestamp::TimeDiff timeout = lockTimeout(pTransponder);
+    LOG(dvb, debug, "frontend wait for lock (timeout " + Poco::NumberFormatter::format(timeout / 1000) + " ms) ...");
+    Poco::Timestamp start;
+    fe_status_t status = (fe_status_t)0;
+    bool carrierChecked = false;
+    while (!(status & (FE_HAS_LOCK | FE_TIMEDOUT)) && start.elapsed() < timeout) {
+        if (!carrierChecked && start.elapsed() >= _carrierTimeout) {
+            // nothing is received on this frequency, waiting for lock until timeout is wasted time
+            carrierChecked = true;
+            fe_status_t readStatus;
+            if (!ioctl(_fileDescFrontend, FE_READ_STATUS, &readStatus) && !(readStatus & (FE_HAS_SIGNAL | FE_HAS_CARRIER))) {
+                LOG(dvb, debug, "frontend has no carrier.");
+                break;
+            }
+        }
+        Poco::Timestamp::TimeDiff wait = (carrierChecked ? timeout : std::min(timeout, _carrierTimeout)) - start.elapsed();
+        struct pollfd fileDescPoll;
+        fileDescPoll.fd = _fileDescFrontend;
+        fileDescPoll.events = POLLPRI;
+        fileDescPoll.revents = 0;
+        int pollRes = poll(&fileDescPoll, 1, wait > 0 ? wait / 1000 + 1 : 0);
+        if (pollRes == -1 && errno != EINTR) {
+            LOG(dvb, error, "frontend poll failed: " + std::string(strerror(errno)));
+            break;
+        }
+        if (pollRes > 0 && (fileDescPoll.revents & POLLPRI)) {
+            struct dvb_frontend_event event;
+            while (!ioctl(_fileDescFrontend, FE_GET_EVENT, &event)) {
+                status = event.status;
+            }
+        }
     }
-    if (hasLock()) {
-        LOG(dvb, debug, "frontend has lock.");
+    if (status & FE_HAS_LOCK) {
+        pTransponder->lockedAfter(start.elapsed());
+        LOG(dvb, debug, "frontend has lock after " + Poco::NumberFormatter::format(start.elapsed() / 1000) + " ms.");
         return true;
     }
     else {
@@ -534,6 +767,17 @@ Frontend::waitForLock(Poco::Timestamp::TimeDiff timeout)
 }
 
 
+Poco::Timestamp::TimeDiff
+Frontend::lockTimeout(Transponder* pTransponder)
+{
+    // a transponder that locked before gets some multiple of its average lock time, but not less than the carrier timeout
+    if (pTransponder->_lockTime) {
+        return std::max(_carrierTimeout, std::min(_frontendTimeout, (Poco::Timestamp::TimeDiff)pTransponder->_lockTime * 4000));
+    }
+    return _frontendTimeout;
+}
+
+
 bool
 Frontend::hasLock()
 {
@@ -565,6 +809,36 @@ Frontend::scanTransponder(Transponder* pTransponder)
 }
 
 
+bool
+Frontend::rescanTransponder(Transponder* pTransponder)
+{
+    LOG(dvb, trace, "************** Transponder (rescan) **************");
+    PatSection pat;
+    if (!_pDemux->readSection(&pat)) {
+        return false;
+    }
+    SdtSection sdt;
+    bool sdtChanged = _pDemux->readSection(&sdt) && sdt.versionNumber() != pTransponder->_sdtVersion;
+    NitSection nit(NitSection::NitActualTableId);
+    bool nitChanged = _pDemux->readSection(&nit) && nit.versionNumber() != pTransponder->_nitVersion;
+    if (pat.versionNumber() != pTransponder->_patVersion || sdtChanged) {
+        LOG(dvb, debug, "transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ") services changed, full scan");
+        pTransponder->clearServices();
+        // if the full scan fails, the next rescan starts with a full scan again
+        pTransponder->_patVersion = Transponder::InvalidVersion;
+        return scanTransponder(pTransponder);
+    }
+    if (nitChanged) {
+        LOG(dvb, debug, "transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ") network changed, scan NIT");
+        scanNit(pTransponder, true);
+    }
+    else {
+        LOG(dvb, debug, "transponder (freq: " + Poco::NumberFormatter::format(pTransponder->_frequency) + ") unchanged");
+    }
+    return true;
+}
+
+
 bool
 Frontend::scanPatPmt(Transponder* pTransponder)
 {
@@ -582,6 +856,7 @@ Frontend::scanPatPmt(Transponder* pTransponder)
                 LOG(dvb, error, "transport stream id mismatch: " + Poco::NumberFormatter::format(pTransponder->_transportStreamId) + " != " + Poco::NumberFormatter::format(pPat->transportStreamId()));
                 return false;
             }
+            pTransponder->_patVersion = pPat->versionNumber();
             LOG(dvb, trace, "service count: " + Poco::NumberFormatter::format(pPat->serviceCount()));
             for (int serviceIndex = 0; serviceIndex < pPat->serviceCount(); serviceIndex++) {
                 LOG(dvb, trace, "--------------     PMT     --------------");
@@ -596,9 +871,20 @@ Frontend::scanPatPmt(Transponder* pTransponder)
                         for (int sPmt = 0; sPmt < pmtTab.sectionCount(); sPmt++) {
                             PmtSection* pPmt = static_cast<PmtSection*>(pmtTab.getSection(sPmt));
                             for (int streamIndex = 0; streamIndex < pPmt->streamCount(); streamIndex++) {
+                                Poco::UInt16 streamType = pPmt->streamType(streamIndex);
+                                if (streamType == Stream::Mpeg2PesPrivateData) {
+                                    for (DescriptorIterator it = pPmt->esInfoDescriptors(streamIndex); !it.atEnd(); it.next()) {
+                                        if (it.tag() == Ac3Descriptor::Tag) {
+                                            streamType = Stream::AudioDvbAc3;
+                                        }
+                                        else if (it.tag() == EnhancedAc3Descriptor::Tag) {
+                                            streamType = Stream::AudioDvbEac3;
+                                        }
+                                    }
+                                }
                                 LOG(dvb, trace, "stream pid: " + Poco::NumberFormatter::format(pPmt->streamPid(streamIndex)) +
-                                            ", type: " + Stream::streamTypeToString(pPmt->streamType(streamIndex)));
-                                pService->addStream(new Stream(Stream::streamTypeToString(pPmt->streamType(streamIndex)), pPmt->streamPid(streamIndex)));
+                                            ", type: " + Stream::streamTypeToString(streamType));
+                                pService->addStream(new Stream(streamType, pPmt->streamPid(streamIndex)));
                             }
                             pService->addStream(new Stream(Stream::ProgramMapTable, pPmt->packetId()));
                             pService->_pcrPid = pPmt->pcrPid();
@@ -623,22 +909,23 @@ Frontend::scanSdt(Transponder* pTransponder)
     SdtSection sdtSection;
     Table sdtTab(sdtSection);
     if (_pDemux->readTable(&sdtTab)) {
+        pTransponder->_sdtVersion = sdtTab.getFirstSection()->versionNumber();
         for (int s = 0; s < sdtTab.sectionCount(); s++) {
             SdtSection* pS = static_cast<SdtSection*>(sdtTab.getSection(s));
             for (int serviceIndex = 0; serviceIndex < pS->serviceCount(); serviceIndex++) {
                 LOG(dvb, trace, "service id: " + Poco::NumberFormatter::format(pS->serviceId(serviceIndex)) +
-                            ", running status: " + pS->runningStatus(serviceIndex) +
+                            ", running status: " + Service::statusToString(pS->runningStatus(serviceIndex)) +
                             ", scrambled: " + Poco::NumberFormatter::format(pS->scrambled(serviceIndex)));
                 Service* pService = pTransponder->getService(pS->serviceId(serviceIndex));
                 if (pService) {
                     pService->_status = pS->runningStatus(serviceIndex);
                     pService->_scrambled = pS->scrambled(serviceIndex);
-                    for (unsigned int d = 0; d < pS->serviceDescriptorCount(serviceIndex); d++) {
-                        Descriptor* pDescriptor = pS->serviceDescriptor(serviceIndex, d);
-                        if (ServiceDescriptor* pD = dynamic_cast<ServiceDescriptor*>(pDescriptor)) {
-                            pService->_type = Service::typeToString(pD->serviceType());
-                            pService->_providerName = pD->providerName();
-                            pService->_name = pD->serviceName();
+                    for (DescriptorIterator it = pS->serviceDescriptors(serviceIndex); !it.atEnd(); it.next()) {
+                        if (it.tag() == ServiceDescriptor::Tag) {
+                            ServiceDescriptor d = it.view<ServiceDescriptor>();
+                            pService->_type = d.serviceType();
+                            pService->_providerName = d.providerName();
+                            pTransponder->setServiceName(pService, d.serviceName());
                             LOG(dvb, trace, "service name: " + pService->_name);
                         }
                     }
@@ -659,6 +946,9 @@ Frontend::scanNit(Transponder* pTransponder, bool actual)
     Table nitTab(nitSection);
     if (_pDemux->readTable(&nitTab)) {
         NitSection* pNit = static_cast<NitSection*>(nitTab.getFirstSection());
+        if (actual) {
+            pTransponder->_nitVersion = pNit->versionNumber();
+        }
         LOG(dvb, trace, "network id: " + Poco::NumberFormatter::format(pNit->networkId()) + ", name: " + pNit->networkName());
 //        LOG(dvb, trace, "network descriptor count: " + Poco::NumberFormatter::format(nit.networkDescriptorCount()));
         for (int s = 0; s < nitTab.sectionCount(); s++) {
@@ -667,50 +957,47 @@ Frontend::scanNit(Transponder* pTransponder, bool actual)
                 LOG(dvb, trace, "original network id: " + Poco::NumberFormatter::format(pS->originalNetworkId(t)) +
                             ", transport stream id: " + Poco::NumberFormatter::format(pS->transportStreamId(t)));
 
-                for (unsigned int d = 0; d < pS->transportStreamDescriptorCount(t); d++) {
-                    Descriptor* pDescriptor = pS->transportStreamDescriptor(t, d);
-                    if (ServiceListDescriptor* pD = dynamic_cast<ServiceListDescriptor*>(pDescriptor)) {
-    //                    LOG(dvb, trace, "service count: " + Poco::NumberFormatter::format(pD->serviceCount()));
-                        for (int i = 0; i < pD->serviceCount(); i++) {
-    //                        LOG(dvb, trace, "service id: " + Poco::NumberFormatter::format(pD->serviceId(i)));
+                for (DescriptorIterator it = pS->transportStreamDescriptors(t); !it.atEnd(); it.next()) {
+                    switch (it.tag()) {
+                        case SatelliteDeliverySystemDescriptor::Tag: {
+                            SatelliteDeliverySystemDescriptor d = it.view<SatelliteDeliverySystemDescriptor>();
+                            LOG(dvb, trace, "orbital position: " + d.orbitalPosition() +
+                                        ", frequency[kHz]: " + Poco::NumberFormatter::format(d.frequency()) +
+                                        ", polarization: " + d.polarization() +
+                                        ", symbol rate: " + Poco::NumberFormatter::format(d.symbolRate()) +
+                                        ", modulation: " + d.modulationSystem() + "/" + d.modulationType());
+                            SatTransponder* pT = new SatTransponder(this, d.frequency(), pS->transportStreamId(t));
+                            pT->init(d.orbitalPosition(), SatFrontend::InvalidSatNum, d.symbolRate(), d.polarization());
+                            pT->initModulation(d.modulationSystem(), d.modulationType(), d.fecInner(), d.rollOff());
+                            additionalTransponders.push_back(pT);
+                            break;
                         }
+                        case TerrestrialDeliverySystemDescriptor::Tag: {
+                            TerrestrialDeliverySystemDescriptor d = it.view<TerrestrialDeliverySystemDescriptor>();
+                            LOG(dvb, trace, "centre frequency[Hz]: " + Poco::NumberFormatter::format(d.centreFrequency()));
+                            TerrestrialTransponder* pT = new TerrestrialTransponder(this, d.centreFrequency(), pS->transportStreamId(t));
+                            pT->init(TerrestrialTransponder::bandwidthFromString(d.bandwidth()),
+                                    TerrestrialTransponder::coderateFromString(d.codeRateHpStream()),
+                                    TerrestrialTransponder::coderateFromString(d.codeRateLpStream()),
+                                    TerrestrialTransponder::modulationFromString(d.constellation()),
+                                    TerrestrialTransponder::transmitModeFromString(d.transmissionMode()),
+                                    TerrestrialTransponder::guard_intervalFromString(d.guardInterval()),
+                                    TerrestrialTransponder::hierarchyFromString(d.hierarchyInformation())
+                            );
+                            additionalTransponders.push_back(pT);
+                            break;
+                        }
+                        // service list and frequency list descriptors are not evaluated yet
+                        default:
+                            break;
                     }
-                    else if (SatelliteDeliverySystemDescriptor* pD = dynamic_cast<SatelliteDeliverySystemDescriptor*>(pDescriptor)) {
-                        LOG(dvb, trace, "orbital position: " + pD->orbitalPosition() +
-                                    ", frequency[kHz]: " + Poco::NumberFormatter::format(pD->frequency()) +
-                                    ", polarization: " + pD->polarization() +
-                                    ", symbol rate: " + Poco::NumberFormatter::format(pD->symbolRate()));
-                        SatTransponder* pT = new SatTransponder(this, pD->frequency(), pS->transportStreamId(t));
-                        pT->init(pD->orbitalPosition(), SatFrontend::InvalidSatNum, pD->symbolRate(), pD->polarization());
-                        additionalTransponders.push_back(pT);
-                    }
-                    else if (TerrestrialDeliverySystemDescriptor* pD = dynamic_cast<TerrestrialDeliverySystemDescriptor*>(pDescriptor)) {
-                        LOG(dvb, trace, "centre frequency[Hz]: " + Poco::NumberFormatter::format(pD->centreFrequency()));
-                        TerrestrialTransponder* pT = new TerrestrialTransponder(this, pD->centreFrequency(), pS->transportStreamId(t));
-                        pT->init(TerrestrialTransponder::bandwidthFromString(pD->bandwidth()),
-                                TerrestrialTransponder::coderateFromString(pD->codeRateHpStream()),
-                                TerrestrialTransponder::coderateFromString(pD->codeRateLpStream()),
-                                TerrestrialTransponder::modulationFromString(pD->constellation()),
-                                TerrestrialTransponder::transmitModeFromString(pD->transmissionMode()),
-                                TerrestrialTransponder::guard_intervalFromString(pD->guardInterval()),
-                                TerrestrialTransponder::hierarchyFromString(pD->hierarchyInformation())
-                        );
-                        additionalTransponders.push_back(pT);
-                    }
-//                    else if (FrequencyListDescriptor* pD = dynamic_cast<FrequencyListDescriptor*>(pDescriptor)) {
-//                        for (int i = 0; i < pD->centreFrequencyCount(); i++) {
-//                            LOG(dvb, trace, "centre frequency[Hz]: " + Poco::NumberFormatter::format(pD->centreFrequency(i)));
-//                        }
-//                    }
                 }
             }
         }
     }
     for (std::vector<Transponder*>::iterator it = additionalTransponders.begin(); it != additionalTransponders.end(); ++it) {
-        if (addKnownTransponder(*it) && tune(*it) && scanTransponder(*it)) {
-            addTransponder(*it);
-        }
-        else {
+        // the next free frontend tunes to it, no recursion into its NIT from here
+        if (!_pScanQueue || !_pScanQueue->addTransponder(*it)) {
             delete *it;
         }
     }
@@ -752,7 +1039,9 @@ const int SatFrontend::InvalidSatNum(-1);
 const int SatFrontend::maxSatNum(4);
 
 SatFrontend::SatFrontend(Adapter* pAdapter, int num) :
-Frontend(pAdapter, num)
+Frontend(pAdapter, num),
+_diseqcSatNum(InvalidSatNum),
+_diseqcHiBand(false)
 {
     _type = DVBS;
     // FIXME: when do we need to multiply freqs with 1000?
@@ -770,6 +1059,15 @@ Frontend(pAdapter, num)
 }
 
 
+void
+SatFrontend::openFrontend()
+{
+    Frontend::openFrontend();
+    // LNB power and switch state are unknown after the frontend was closed
+    _diseqcSatNum = InvalidSatNum;
+}
+
+
 bool
 SatFrontend::tune(Transponder* pTransponder)
 {
@@ -782,6 +1080,10 @@ SatFrontend::tune(Transponder* pTransponder)
             + " (" + pTrans->_satPosition + "/" + Poco::NumberFormatter::format(pTrans->_satNum) + ")"
             + " ...");
 
+    if (pTrans->_satNum == InvalidSatNum && getSatNum(pTrans->_satPosition) != InvalidSatNum) {
+        // orbital position was learned from another transponder or read from the dvb xml, no need to probe
+        pTrans->_satNum = getSatNum(pTrans->_satPosition);
+    }
     int firstSat = 0;
     int lastSat = maxSatNum - 1;
     if (pTrans->_satNum != InvalidSatNum) {
@@ -805,19 +1107,38 @@ SatFrontend::tune(Transponder* pTransponder)
         bool hiBand = _pLnb->isHiBand(pTrans->_frequency, ifreq);
         diseqc(i, pTrans->_polarization, hiBand);
 
-        struct dvb_frontend_parameters tuneto;
-        tuneto.frequency = ifreq;
-        tuneto.inversion = INVERSION_AUTO;
-        tuneto.u.qpsk.symbol_rate = pTrans->_symbolRate;
-        tuneto.u.qpsk.fec_inner = FEC_AUTO;
-
-        if (ioctl(_fileDescFrontend, FE_SET_FRONTEND, &tuneto) == -1) {
-            LOG(dvb, debug, "sat frontend tuning failed.");
-            continue;
+        fe_delivery_system_t system = SatTransponder::deliverySystemFromString(pTrans->_modulationSystem);
+        std::vector<struct dtv_property> properties;
+        addProperty(properties, DTV_DELIVERY_SYSTEM, system);
+        addProperty(properties, DTV_FREQUENCY, ifreq);
+        addProperty(properties, DTV_MODULATION, SatTransponder::modulationFromString(pTrans->_modulationType));
+        addProperty(properties, DTV_SYMBOL_RATE, pTrans->_symbolRate);
+        addProperty(properties, DTV_INNER_FEC, SatTransponder::fecFromString(pTrans->_fecInner));
+        addProperty(properties, DTV_INVERSION, INVERSION_AUTO);
+        if (system == SYS_DVBS2) {
+            addProperty(properties, DTV_ROLLOFF, SatTransponder::rollOffFromString(pTrans->_rollOff));
+            addProperty(properties, DTV_PILOT, SatTransponder::pilotFromString(pTrans->_pilot));
+        }
+        if (!setProperties(properties)) {
+            if (system == SYS_DVBS2) {
+                LOG(dvb, debug, "sat frontend tuning to DVB-S2 transponder failed.");
+                continue;
+            }
+            // drivers without DVBv5 support
+            struct dvb_frontend_parameters tuneto;
+            tuneto.frequency = ifreq;
+            tuneto.inversion = INVERSION_AUTO;
+            tuneto.u.qpsk.symbol_rate = pTrans->_symbolRate;
+            tuneto.u.qpsk.fec_inner = FEC_AUTO;
+
+            if (ioctl(_fileDescFrontend, FE_SET_FRONTEND, &tuneto) == -1) {
+                LOG(dvb, debug, "sat frontend tuning failed.");
+                continue;
+            }
         }
-        success = waitForLock(_frontendTimeout);
+        success = waitForLock(pTrans);
         if (success) {
-            _pTunedTransponder = pTrans;
+            setTunedTransponder(pTrans);
             pTrans->_satNum = i;
             if (pTrans->_satPosition != "") {
                 setSatNum(pTrans->_satPosition, pTrans->_satNum);
@@ -854,7 +1175,8 @@ SatFrontend::readXml(Poco::XML::Node* pXmlFrontend)
                 while (pXmlSatParam) {
                     Poco::XML::Node* pXmlSatParamVal = pXmlSatParam->firstChild();
                     if (!pXmlSatParamVal) {
-                        LOG(dvb, error, "sat frontend satellite parameter without value: " + pXmlParam->nodeName());
+                        LOG(dvb, error, "sat frontend satellite parameter without value: " + pXmlSatParam->nodeName());
+                        pXmlSatParam = pXmlSatParam->nextSibling();
                         continue;
                     }
                     if (pXmlSatParam->nodeName() == "orbitalPosition") {
@@ -865,7 +1187,9 @@ SatFrontend::readXml(Poco::XML::Node* pXmlFrontend)
                     }
                     pXmlSatParam = pXmlSatParam->nextSibling();
                 }
-                setSatNum(satPos, satNum);
+                if (satPos != "" && satNum != InvalidSatNum) {
+                    setSatNum(satPos, satNum);
+                }
             }
             else {
                 LOG(dvb, error, "sat frontend unknown parameter: " + pXmlParam->nodeName());
@@ -903,6 +1227,33 @@ SatFrontend::writeXml(Poco::XML::Element* pAdapter)
 }
 
 
+void
+SatFrontend::readDb(ChannelDbReader& db)
+{
+    Frontend::readDb(db);
+
+    Poco::UInt32 satCount = db.readUInt32();
+    for (Poco::UInt32 i = 0; i < satCount && db.good(); i++) {
+        std::string satPos = db.readString();
+        int satNum = db.readInt32();
+        setSatNum(satPos, satNum);
+    }
+}
+
+
+void
+SatFrontend::writeDb(ChannelDbWriter& db)
+{
+    Frontend::writeDb(db);
+
+    db.writeUInt32(_satNumMap.size());
+    for (std::map<std::string, int>::iterator it = _satNumMap.begin(); it != _satNumMap.end(); ++it) {
+        db.writeString(it->first);
+        db.writeInt32(it->second);
+    }
+}
+
+
 int
 SatFrontend::getSatNum(const std::string& orbitalPosition)
 {
@@ -950,6 +1301,28 @@ SatFrontend::isSatNumKnown(int satNum)
 void
 SatFrontend::diseqc(unsigned int satNum, const std::string& polarization, bool hiBand)
 {
+    fe_sec_voltage_t voltage = (polarization == SatTransponder::POL_VERT) ? SEC_VOLTAGE_13 : SEC_VOLTAGE_18;
+    fe_sec_tone_mode_t tone = hiBand ? SEC_TONE_ON : SEC_TONE_OFF;
+
+    if (_diseqcSatNum == (int)satNum) {
+        // same switch port, only voltage and tone select polarization and band of the LNB
+        LOG(dvb, debug, "diseqc sat: " + Poco::NumberFormatter::format(satNum) + " unchanged");
+        if (_diseqcPolarization != polarization) {
+            if (ioctl(_fileDescFrontend, FE_SET_VOLTAGE, voltage) == -1) {
+                LOG(dvb, error, "FE_SET_VOLTAGE failed");
+            }
+            usleep(15 * 1000);
+            _diseqcPolarization = polarization;
+        }
+        if (_diseqcHiBand != hiBand) {
+            if (ioctl(_fileDescFrontend, FE_SET_TONE, tone) == -1) {
+                LOG(dvb, error, "FE_SET_TONE failed");
+            }
+            _diseqcHiBand = hiBand;
+        }
+        return;
+    }
+
     LOG(dvb, debug, "diseqc command on sat: " + Poco::NumberFormatter::format(satNum) + " ...");
 
     struct diseqc_cmd {
@@ -963,8 +1336,6 @@ SatFrontend::diseqc(unsigned int satNum, const std::string& polarization, bool h
     cmd.cmd.msg[3] =
         0xf0 | (((satNum * 4) & 0x0f) | (hiBand ? 1 : 0) | ((polarization == SatTransponder::POL_VERT) ? 0 : 2));
 
-    fe_sec_voltage_t voltage = (polarization == SatTransponder::POL_VERT) ? SEC_VOLTAGE_13 : SEC_VOLTAGE_18;
-    fe_sec_tone_mode_t tone = hiBand ? SEC_TONE_ON : SEC_TONE_OFF;
     fe_sec_mini_cmd_t burst = satNum % 2 ? SEC_MINI_B : SEC_MINI_A;
 
     if (ioctl(_fileDescFrontend, FE_SET_TONE, SEC_TONE_OFF) == -1) {
@@ -986,6 +1357,9 @@ SatFrontend::diseqc(unsigned int satNum, const std::string& polarization, bool h
     if (ioctl(_fileDescFrontend, FE_SET_TONE, tone) == -1) {
         LOG(dvb, error, "FE_SET_TONE failed");
     }
+    _diseqcSatNum = satNum;
+    _diseqcPolarization = polarization;
+    _diseqcHiBand = hiBand;
 
     LOG(dvb, debug, "diseqc command finished.");
 }
@@ -1020,25 +1394,47 @@ TerrestrialFrontend::tune(Transponder* pTransponder)
             Poco::NumberFormatter::format(pTrans->_guard_interval) + ", " +
             Poco::NumberFormatter::format(pTrans->_hierarchy_information));
 
-    struct dvb_frontend_parameters tuneto;
+    bool t2 = (pTrans->_deliverySystem == TerrestrialTransponder::SYSTEM_DVBT2);
+    std::vector<struct dtv_property> properties;
+    addProperty(properties, DTV_DELIVERY_SYSTEM, t2 ? SYS_DVBT2 : SYS_DVBT);
+    addProperty(properties, DTV_FREQUENCY, pTrans->_frequency);
+    addProperty(properties, DTV_BANDWIDTH_HZ, TerrestrialTransponder::bandwidthToHz(pTrans->_bandwidth));
+    addProperty(properties, DTV_CODE_RATE_HP, pTrans->_code_rate_HP);
+    addProperty(properties, DTV_CODE_RATE_LP, pTrans->_code_rate_LP);
+    addProperty(properties, DTV_MODULATION, pTrans->_constellation);
+    addProperty(properties, DTV_TRANSMISSION_MODE, pTrans->_transmission_mode);
+    addProperty(properties, DTV_GUARD_INTERVAL, pTrans->_guard_interval);
+    addProperty(properties, DTV_HIERARCHY, pTrans->_hierarchy_information);
+    addProperty(properties, DTV_INVERSION, INVERSION_AUTO);
+    if (t2 && pTrans->_plpId != TerrestrialTransponder::NoPlpId) {
+        addProperty(properties, DTV_STREAM_ID, pTrans->_plpId);
+    }
+    if (!setProperties(properties)) {
+        if (t2) {
+            LOG(dvb, debug, "terrestrial frontend tuning to DVB-T2 transponder failed.");
+            return false;
+        }
+        // drivers without DVBv5 support
+        struct dvb_frontend_parameters tuneto;
 
-    tuneto.frequency = pTrans->_frequency;
-    tuneto.inversion = INVERSION_AUTO;
-    tuneto.u.ofdm.bandwidth = pTrans->_bandwidth;
-    tuneto.u.ofdm.code_rate_HP = pTrans->_code_rate_HP;
-    tuneto.u.ofdm.code_rate_LP = pTrans->_code_rate_LP;
-    tuneto.u.ofdm.constellation = pTrans->_constellation;
-    tuneto.u.ofdm.transmission_mode = pTrans->_transmission_mode;
-    tuneto.u.ofdm.guard_interval = pTrans->_guard_interval;
-    tuneto.u.ofdm.hierarchy_information = pTrans->_hierarchy_information;
+        tuneto.frequency = pTrans->_frequency;
+        tuneto.inversion = INVERSION_AUTO;
+        tuneto.u.ofdm.bandwidth = pTrans->_bandwidth;
+        tuneto.u.ofdm.code_rate_HP = pTrans->_code_rate_HP;
+        tuneto.u.ofdm.code_rate_LP = pTrans->_code_rate_LP;
+        tuneto.u.ofdm.constellation = pTrans->_constellation;
+        tuneto.u.ofdm.transmission_mode = pTrans->_transmission_mode;
+        tuneto.u.ofdm.guard_interval = pTrans->_guard_interval;
+        tuneto.u.ofdm.hierarchy_information = pTrans->_hierarchy_information;
 
-    if (ioctl(_fileDescFrontend, FE_SET_FRONTEND, &tuneto) == -1) {
-        LOG(dvb, debug, "terrestrial frontend tuning failed.");
-        return false;
+        if (ioctl(_fileDescFrontend, FE_SET_FRONTEND, &tuneto) == -1) {
+            LOG(dvb, debug, "terrestrial frontend tuning failed.");
+            return false;
+        }
     }
-    bool success = waitForLock(_frontendTimeout);
+    bool success = waitForLock(pTrans);
     if (success) {
-        _pTunedTransponder = pTrans;
+        setTunedTransponder(pTrans);
     }
     return success;
 }
@@ -1063,9 +1459,9 @@ CableFrontend::tune(Transponder* pTransponder)
         LOG(dvb, debug, "cable frontend tuning failed.");
         return false;
     }
-    bool success = waitForLock(_frontendTimeout);
+    bool success = waitForLock(pTrans);
     if (success) {
-        _pTunedTransponder = pTrans;
+        setTunedTransponder(pTrans);
     }
     return success;
 }
@@ -1090,9 +1486,9 @@ AtscFrontend::tune(Transponder* pTransponder)
         LOG(dvb, debug, "atsc frontend tuning failed.");
         return false;
     }
-    bool success = waitForLock(_frontendTimeout);
+    bool success = waitForLock(pTrans);
     if (success) {
-        _pTunedTransponder = pTrans;
+        setTunedTransponder(pTrans);
     }
     return success;
 }
@@ -13,9 +13,15 @@
 #ifndef Frontend_INCLUDED
 #define Frontend_INCLUDED
 
+#include <deque>
+#include <vector>
+
 #include <linux/dvb/frontend.h>
 
 #include <Poco/Thread.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
 #include <Poco/TextConverter.h>
 #include <Poco/TextEncoding.h>
 #include <Poco/UTF8Encoding.h>
@@ -26,13 +32,68 @@ namespace Dvb {
 class Adapter;
 class Demux;
 class Dvr;
+class MonitorStats;
 class SignalCheckThread;
+class Transponder;
+class ChannelDbReader;
+class ChannelDbWriter;
+
+
+class TransponderScanQueue
+/// Work list shared by all frontends that scan in parallel. Each transponder
+/// is handed out to only one frontend, transponders found in the NIT of a scanned
+/// transponder are appended to the list, unless they are already known.
+{
+public:
+    TransponderScanQueue();
+
+    bool addTransponder(Transponder* pTransponder);
+    /// returns false if an equal transponder was already added
+    Transponder* takeTransponder();
+    /// waits while the list is empty and other frontends are still scanning, returns 0 when the scan is finished
+    void transponderDone();
+    const std::vector<Transponder*>& knownTransponders();
+
+private:
+    std::vector<Transponder*>   _knownTransponders;
+    std::deque<Transponder*>    _pendingTransponders;
+    int                         _scanningCount;
+    Poco::FastMutex             _queueLock;
+    Poco::Condition             _queueCondition;
+};
+
+
+class SignalStatus
+{
+    friend class Frontend;
+
+public:
+    SignalStatus();
+
+    bool getLock();
+    int getSignal();
+    /// signal strength in the driver's scale of 0 to 0xffff, -1 if the frontend can't measure it
+    int getSnr();
+    /// same as getSignal()
+    Poco::Int64 getBer();
+    /// bit error rate in the driver's unit, -1 if the frontend can't measure it
+    Poco::Int64 getUncorrectedBlocks();
+
+private:
+    bool                _lock;
+    int                 _signal;
+    int                 _snr;
+    Poco::Int64         _ber;
+    Poco::Int64         _uncorrectedBlocks;
+};
+
 
 class Frontend
 {
     friend class Device;
     friend class Adapter;
     friend class SignalCheckThread;
+    friend class EitHarvester;
 
 public:
     static const std::string Unknown;
@@ -47,29 +108,44 @@ public:
     static Frontend* detectFrontend(Adapter* pAdapter, int num);
 
     void addTransponder(Transponder* pTransponder);
-    void openFrontend();
+    virtual void openFrontend();
     void closeFrontend();
+    bool isOpen();
 
-    void scan(const std::string& initialTransponderData);
+    void scan(TransponderScanQueue& scanQueue);
+    void copyTransponders(const std::vector<Transponder*>& transponders);
     virtual void readXml(Poco::XML::Node* pXmlFrontend);
     virtual void writeXml(Poco::XML::Element* pAdapter);
+    virtual void readDb(ChannelDbReader& db);
+    virtual void writeDb(ChannelDbWriter& db);
 
     const std::string getType();
     const std::string getName();
     bool typeSupported();
     bool isTuned();
     bool isTunedTo(Transponder* pTransponder);
+    bool getMonitorStats(MonitorStats& stats);
+    /// error counters and bitrates of the TS read from the DVR, false if it is not open
+    bool getSignalStatus(SignalStatus& status);
+    /// read from the frontend on each call, false if it is not open
     virtual bool tune(Transponder* pTransponder) {}
-    virtual Transponder* createTransponder(unsigned int freq, unsigned int tsid) {}
+    virtual Transponder* createTransponder(unsigned int freq, unsigned int tsid) { return 0; }
 
     static void listInitialTransponderData();
     void getInitialTransponderKeys(std::vector<std::string>& keys);
-    void getInitialTransponderData(const std::string& key);
+    void getInitialTransponderData(const std::string& key, std::vector<Transponder*>& transponders);
 
 protected:
-    bool waitForLock(Poco::Timestamp::TimeDiff timeout = 0);  // timeout in microseconds, 0 means forever
+    bool setProperties(std::vector<struct dtv_property>& properties);
+    /// sets all tuning parameters and starts tuning with one FE_SET_PROPERTY call
+    static void addProperty(std::vector<struct dtv_property>& properties, Poco::UInt32 cmd, Poco::UInt32 data);
+    bool waitForLock(Transponder* pTransponder);
+    void setTunedTransponder(Transponder* pTransponder);
+    /// the DVR monitor starts from scratch, if pTransponder is another multiplex than the last one
+    Poco::Timestamp::TimeDiff lockTimeout(Transponder* pTransponder);
     bool hasLock();
     bool scanTransponder(Transponder* pTransponder);
+    bool rescanTransponder(Transponder* pTransponder);
     bool scanPatPmt(Transponder* pTransponder);
     void scanSdt(Transponder* pTransponder);
     void scanNit(Transponder* pTransponder, bool actual = false);
@@ -78,20 +154,21 @@ protected:
     struct dvb_frontend_info            _feInfo;
     std::string                         _type;
     Poco::Timestamp::TimeDiff           _frontendTimeout;
+    Poco::Timestamp::TimeDiff           _carrierTimeout;
     Poco::AutoPtr<Poco::XML::Element>   _pXmlFrontend;
     Transponder*                        _pTunedTransponder;
 
 private:
     void checkFrontend();
-    bool addKnownTransponder(Transponder* pTransponder);
+    void scanThread();
 
     Adapter*                            _pAdapter;
     std::string                         _deviceName;
     std::string                         _name;
     int                                 _num;
-    std::vector<Transponder*>           _initialTransponders;
-    std::vector<Transponder*>           _scannedTransponders;
     std::vector<Transponder*>           _transponders;
+    TransponderScanQueue*               _pScanQueue;
+    Poco::RunnableAdapter<Frontend>     _scanThreadRunnable;
     Demux*                              _pDemux;
     Dvr*                                _pDvr;
 
@@ -131,10 +208,13 @@ public:
 
     SatFrontend(Adapter* pAdapter, int num);
 
+    virtual void openFrontend();
     virtual bool tune(Transponder* pTransponder);
     virtual Transponder* createTransponder(unsigned int freq, unsigned int tsid);
     virtual void readXml(Poco::XML::Node* pXmlFrontend);
     virtual void writeXml(Poco::XML::Element* pAdapter);
+    virtual void readDb(ChannelDbReader& db);
+    virtual void writeDb(ChannelDbWriter& db);
 
     int getSatNum(const std::string& orbitalPosition);
     void setSatNum(const std::string& orbitalPosition, int satNum);
@@ -147,6 +227,10 @@ private:
     std::map<std::string, Lnb*>     _lnbs;  // possible LNB types
     Lnb*                            _pLnb;
     std::map<std::string, int>      _satNumMap;
+    // switch state after the last diseqc command, to skip commands that don't change anything
+    int                             _diseqcSatNum;
+    std::string                     _diseqcPolarization;
+    bool                            _diseqcHiBand;
 };
 
 
@@ -0,0 +1,250 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+
+#include "TransportStream.h"
+#include "Monitor.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+Poco::UInt16
+PidStats::getPid()
+{
+    return _pid;
+}
+
+
+Poco::UInt64
+PidStats::getPackets()
+{
+    return _packets;
+}
+
+
+Poco::UInt64
+PidStats::getBitrate()
+{
+    return _bitrate;
+}
+
+
+Poco::UInt64
+PidStats::getContinuityErrors()
+{
+    return _continuityErrors;
+}
+
+
+Poco::UInt64
+PidStats::getTransportErrors()
+{
+    return _transportErrors;
+}
+
+
+bool
+PidStats::getScrambled()
+{
+    return _scrambled;
+}
+
+
+Poco::UInt64
+PidStats::getPcrDiscontinuities()
+{
+    return _pcrDiscontinuities;
+}
+
+
+Poco::Timestamp::TimeDiff
+PidStats::getPcrJitter()
+{
+    return _pcrJitter;
+}
+
+
+Poco::UInt64
+MonitorStats::getOverflows()
+{
+    return _overflows;
+}
+
+
+Poco::UInt64
+MonitorStats::getReadErrors()
+{
+    return _readErrors;
+}
+
+
+Poco::UInt64
+MonitorStats::getSyncErrors()
+{
+    return _syncErrors;
+}
+
+
+std::vector<PidStats>&
+MonitorStats::getPidStats()
+{
+    return _pidStats;
+}
+
+
+const Poco::Timestamp::TimeDiff StreamMonitor::PcrDiscontinuityInterval(100000);
+const Poco::Timestamp::TimeDiff StreamMonitor::RateInterval(1000000);
+
+StreamMonitor::StreamMonitor()
+{
+    reset();
+}
+
+
+void
+StreamMonitor::checkPacket(const Poco::UInt8* pData)
+{
+    Poco::UInt16 pid = ((pData[1] & 0x1f) << 8) | pData[2];
+    Poco::UInt16& slot = _pidSlots[pid];
+    if (!slot) {
+        _counters.push_back(PidCounter());
+        PidCounter& counter = _counters.back();
+        counter.stats = PidStats();
+        counter.stats._pid = pid;
+        counter.ratePackets = 0;
+        counter.rateJitter = 0;
+        counter.hasContinuityCounter = false;
+        counter.hasPcr = false;
+        slot = _counters.size();
+    }
+    PidCounter& counter = _counters[slot - 1];
+    counter.stats._packets++;
+    Poco::Timestamp now;
+    if (now - _rateTime >= RateInterval) {
+        updateRates(now);
+    }
+    if (pData[1] & 0x80) {
+        // the rest of the packet can't be trusted
+        counter.stats._transportErrors++;
+        return;
+    }
+    if (pid == TransportStreamPacket::NullPacketIdentifier) {
+        return;
+    }
+    counter.stats._scrambled = pData[3] & 0xc0;
+    bool adaptation = pData[3] & 0x20;
+    bool discontinuity = adaptation && pData[4] && (pData[5] & 0x80);
+    if (pData[3] & 0x10) {
+        // only packets with payload increment the counter, one duplicate packet is allowed
+        Poco::UInt8 continuityCounter = pData[3] & 0x0f;
+        if (counter.hasContinuityCounter && !discontinuity && continuityCounter != counter.continuityCounter
+                && continuityCounter != ((counter.continuityCounter + 1) & 0x0f)) {
+            counter.stats._continuityErrors++;
+        }
+        counter.continuityCounter = continuityCounter;
+        counter.hasContinuityCounter = true;
+    }
+    Poco::UInt64 pcr;
+    if (adaptation && TransportStreamPacket::getPcr(pData, pcr)) {
+        checkPcr(counter, pcr, discontinuity, now);
+    }
+}
+
+
+void
+StreamMonitor::checkPcr(PidCounter& counter, Poco::UInt64 pcr, bool discontinuity, const Poco::Timestamp& now)
+{
+    if (counter.hasPcr && !discontinuity) {
+        Poco::Timestamp::TimeDiff interval = PcrClock::interval(counter.pcr, pcr);
+        if (interval > PcrDiscontinuityInterval) {
+            counter.stats._pcrDiscontinuities++;
+        }
+        else {
+            Poco::Timestamp::TimeDiff jitter = (now - counter.pcrArrival) - interval;
+            if (jitter < 0) {
+                jitter = -jitter;
+            }
+            if (jitter > counter.rateJitter) {
+                counter.rateJitter = jitter;
+            }
+        }
+    }
+    counter.pcr = pcr;
+    counter.pcrArrival = now;
+    counter.hasPcr = true;
+}
+
+
+void
+StreamMonitor::updateRates(const Poco::Timestamp& now)
+{
+    Poco::Timestamp::TimeDiff elapsed = now - _rateTime;
+    _rateTime = now;
+    for (std::vector<PidCounter>::iterator it = _counters.begin(); it != _counters.end(); ++it) {
+        it->stats._bitrate = (double)(it->stats._packets - it->ratePackets) * TransportStreamPacket::Size * 8 * 1000000 / elapsed;
+        it->ratePackets = it->stats._packets;
+        it->stats._pcrJitter = it->rateJitter;
+        it->rateJitter = 0;
+    }
+}
+
+
+void
+StreamMonitor::countReadError(int error)
+{
+    if (error == EOVERFLOW) {
+        _overflows++;
+    }
+    else {
+        _readErrors++;
+    }
+}
+
+
+void
+StreamMonitor::countSyncError()
+{
+    _syncErrors++;
+}
+
+
+void
+StreamMonitor::getStats(MonitorStats& stats)
+{
+    stats._overflows = _overflows;
+    stats._readErrors = _readErrors;
+    stats._syncErrors = _syncErrors;
+    stats._pidStats.clear();
+    for (std::vector<PidCounter>::iterator it = _counters.begin(); it != _counters.end(); ++it) {
+        stats._pidStats.push_back(it->stats);
+    }
+}
+
+
+void
+StreamMonitor::reset()
+{
+    ::memset(_pidSlots, 0, sizeof(_pidSlots));
+    _counters.clear();
+    _rateTime.update();
+    _overflows = 0;
+    _readErrors = 0;
+    _syncErrors = 0;
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
@@ -0,0 +1,124 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef Monitor_INCLUDED
+#define Monitor_INCLUDED
+
+#include <vector>
+
+#include <Poco/Types.h>
+#include <Poco/Timestamp.h>
+
+
+namespace Omm {
+namespace Dvb {
+
+
+class PidStats
+{
+    friend class StreamMonitor;
+
+public:
+    Poco::UInt16 getPid();
+    Poco::UInt64 getPackets();
+    Poco::UInt64 getBitrate();
+    /// bits per second in the last rate interval
+    Poco::UInt64 getContinuityErrors();
+    Poco::UInt64 getTransportErrors();
+    bool getScrambled();
+    Poco::UInt64 getPcrDiscontinuities();
+    Poco::Timestamp::TimeDiff getPcrJitter();
+    /// largest difference in usec between PCR and arrival time intervals in the last rate interval
+
+private:
+    Poco::UInt16                _pid;
+    Poco::UInt64                _packets;
+    Poco::UInt64                _bitrate;
+    Poco::UInt64                _continuityErrors;
+    Poco::UInt64                _transportErrors;
+    bool                        _scrambled;
+    Poco::UInt64                _pcrDiscontinuities;
+    Poco::Timestamp::TimeDiff   _pcrJitter;
+};
+
+
+class MonitorStats
+{
+    friend class StreamMonitor;
+
+public:
+    Poco::UInt64 getOverflows();
+    /// DVR buffer overflows in the kernel, the reader was too slow
+    Poco::UInt64 getReadErrors();
+    Poco::UInt64 getSyncErrors();
+    std::vector<PidStats>& getPidStats();
+
+private:
+    Poco::UInt64                _overflows;
+    Poco::UInt64                _readErrors;
+    Poco::UInt64                _syncErrors;
+    std::vector<PidStats>       _pidStats;
+};
+
+
+class StreamMonitor
+/// Checks continuity counter, transport error indicator and PCR of each TS packet of a multiplex
+/// and counts errors per PID. Continuity errors together with transport errors come from the reception,
+/// continuity errors on all PIDs at once from overflows of the DVR buffer. Not thread safe, the
+/// remux lock covers it.
+{
+public:
+    static const Poco::Timestamp::TimeDiff PcrDiscontinuityInterval;
+    /// longer intervals between two PCRs, or PCR going backwards, without discontinuity indicator
+    static const Poco::Timestamp::TimeDiff RateInterval;
+    /// bitrate and PCR jitter are measured over this interval, clocked by the packets in the multiplex,
+    /// so that any number of readers of the stats get the same values
+
+    StreamMonitor();
+
+    void checkPacket(const Poco::UInt8* pData);
+    void countReadError(int error);
+    void countSyncError();
+    void getStats(MonitorStats& stats);
+    void reset();
+    /// clears all counters, the multiplex changed
+
+private:
+    struct PidCounter
+    {
+        PidStats                    stats;
+        Poco::UInt64                ratePackets;
+        Poco::Timestamp::TimeDiff   rateJitter;
+        Poco::UInt8                 continuityCounter;
+        bool                        hasContinuityCounter;
+        Poco::UInt64                pcr;
+        Poco::Timestamp             pcrArrival;
+        bool                        hasPcr;
+    };
+
+    void checkPcr(PidCounter& counter, Poco::UInt64 pcr, bool discontinuity, const Poco::Timestamp& now);
+    void updateRates(const Poco::Timestamp& now);
+
+    // index + 1 of the counter of each PID in _counters, 0 if the PID was not seen, yet
+    Poco::UInt16                    _pidSlots[0x2000];
+    std::vector<PidCounter>         _counters;
+    Poco::Timestamp                 _rateTime;
+    Poco::UInt64                    _overflows;
+    Poco::UInt64                    _readErrors;
+    Poco::UInt64                    _syncErrors;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
@@ -0,0 +1,481 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <Poco/NumberFormatter.h>
+
+#include "Log.h"
+#include "TransportStream.h"
+#include "Service.h"
+#include "Transponder.h"
+#include "Device.h"
+#include "Multicast.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+const unsigned int RtpSender::PacketsPerDatagram(7);
+const unsigned int RtpSender::BatchSize(32);
+const Poco::Timestamp::TimeDiff RtpSender::BatchWindow(2000);
+const unsigned int RtpSender::MaxQueueSize(2 * 1024 * 1024);
+
+RtpSender::RtpSender(const std::string& address, Poco::UInt16 port, unsigned int ttl, Poco::UInt16 pcrPid) :
+_address(address),
+_port(port),
+_ttl(ttl),
+_pcrPid(pcrPid),
+_socket(-1),
+_lastPcr(0),
+_hasPcr(false),
+_dropping(false),
+_queuedBytes(0),
+_bytesDropped(0),
+_datagramsSent(0),
+_sequenceNumber(0),
+_ssrc(0),
+_pSendThread(0),
+_sendThreadRunnable(*this, &RtpSender::sendThread),
+_sendThreadRunning(false)
+{
+}
+
+
+RtpSender::~RtpSender()
+{
+    close();
+}
+
+
+bool
+RtpSender::open()
+{
+    struct sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+    if (!::inet_aton(_address.c_str(), &addr.sin_addr)) {
+        LOG(dvb, error, "rtp sender invalid address: " + _address);
+        return false;
+    }
+    _socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket == -1) {
+        LOG(dvb, error, "rtp sender failed to create socket: " + std::string(strerror(errno)));
+        return false;
+    }
+    int ttl = _ttl;
+    // loop back, so that receivers on this host get the stream, too
+    int loop = 1;
+    if (::setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == -1
+            || ::setsockopt(_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) == -1
+            || ::connect(_socket, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        LOG(dvb, error, "rtp sender failed to set up socket for " + _address + ": " + std::string(strerror(errno)));
+        ::close(_socket);
+        _socket = -1;
+        return false;
+    }
+    _ssrc = (Poco::UInt32)Poco::Timestamp().epochMicroseconds() ^ (Poco::UInt32)(unsigned long)this;
+    if (!_pSendThread) {
+        _sendThreadRunning = true;
+        _pSendThread = new Poco::Thread;
+        _pSendThread->start(_sendThreadRunnable);
+    }
+    LOG(dvb, information, "rtp sender to " + _address + ":" + Poco::NumberFormatter::format(_port));
+    return true;
+}
+
+
+void
+RtpSender::close()
+{
+    if (_pSendThread) {
+        _senderLock.lock();
+        _sendThreadRunning = false;
+        _segmentCondition.broadcast();
+        _senderLock.unlock();
+        if (_pSendThread->isRunning() && !_pSendThread->tryJoin(PcrClock::MaxInterval / 1000)) {
+            LOG(dvb, error, "failed to join rtp send thread");
+        }
+        delete _pSendThread;
+        _pSendThread = 0;
+    }
+    if (_socket != -1) {
+        ::close(_socket);
+        _socket = -1;
+    }
+}
+
+
+void
+RtpSender::write(const char* pData, unsigned int size)
+{
+    for (; size >= (unsigned int)TransportStreamPacket::Size; pData += TransportStreamPacket::Size, size -= TransportStreamPacket::Size) {
+        const Poco::UInt8* pPacket = (const Poco::UInt8*)pData;
+        Poco::UInt16 pid = ((pPacket[1] & 0x1f) << 8) | pPacket[2];
+        Poco::UInt64 pcr;
+        if (pid == _pcrPid && TransportStreamPacket::getPcr(pPacket, pcr)) {
+            queueSegment(_hasPcr, _lastPcr, pcr);
+            _lastPcr = pcr;
+            _hasPcr = true;
+        }
+        else if (_pending.size() >= MaxQueueSize / 4) {
+            // no PCR for too long, send without pacing until the next PCR
+            queueSegment(false, 0, 0);
+            _hasPcr = false;
+        }
+        _pending.insert(_pending.end(), pData, pData + TransportStreamPacket::Size);
+    }
+}
+
+
+void
+RtpSender::queueSegment(bool paced, Poco::UInt64 pcrBegin, Poco::UInt64 pcrEnd)
+{
+    if (_pending.empty()) {
+        return;
+    }
+    Poco::ScopedLock<Poco::FastMutex> lock(_senderLock);
+    if (_queuedBytes + _pending.size() > MaxQueueSize) {
+        if (!_dropping) {
+            LOG(dvb, warning, "rtp sender to " + _address + " can't keep up, dropping data");
+            _dropping = true;
+        }
+        _bytesDropped += _pending.size();
+        _pending.clear();
+        return;
+    }
+    _dropping = false;
+    _segments.push_back(Segment());
+    Segment& segment = _segments.back();
+    segment.data.swap(_pending);
+    segment.pcrBegin = pcrBegin;
+    segment.pcrEnd = pcrEnd;
+    segment.paced = paced;
+    _queuedBytes += segment.data.size();
+    _segmentCondition.signal();
+}
+
+
+void
+RtpSender::sendThread()
+{
+    LOG(dvb, debug, "rtp send thread started.");
+
+    Segment segment;
+    for (;;) {
+        _senderLock.lock();
+        while (_segments.empty() && _sendThreadRunning) {
+            _segmentCondition.wait<Poco::FastMutex>(_senderLock);
+        }
+        if (!_sendThreadRunning) {
+            _senderLock.unlock();
+            break;
+        }
+        Segment& front = _segments.front();
+        segment.data.swap(front.data);
+        segment.pcrBegin = front.pcrBegin;
+        segment.pcrEnd = front.pcrEnd;
+        segment.paced = front.paced;
+        _queuedBytes -= segment.data.size();
+        _segments.pop_front();
+        _senderLock.unlock();
+
+        sendSegment(segment);
+        segment.data.clear();
+    }
+
+    LOG(dvb, debug, "rtp send thread finished, datagrams sent: " + Poco::NumberFormatter::format(getDatagramsSent()));
+}
+
+
+bool
+RtpSender::sendThreadRunning()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_senderLock);
+    return _sendThreadRunning;
+}
+
+
+void
+RtpSender::sendSegment(Segment& segment)
+{
+    const unsigned int datagramSize = PacketsPerDatagram * TransportStreamPacket::Size;
+    // packets that didn't fill a datagram in the last segment go first
+    unsigned int carried = _sendBuffer.size() / TransportStreamPacket::Size;
+    unsigned int packetCount = segment.data.size() / TransportStreamPacket::Size;
+    _sendBuffer.insert(_sendBuffer.end(), segment.data.begin(), segment.data.end());
+    unsigned int datagramCount = _sendBuffer.size() / datagramSize;
+
+    Poco::Timestamp start;
+    Poco::Timestamp::TimeDiff duration = 0;
+    if (segment.paced) {
+        duration = PcrClock::interval(segment.pcrBegin, segment.pcrEnd);
+        if (duration > PcrClock::MaxInterval) {
+            LOG(dvb, debug, "rtp sender to " + _address + " PCR discontinuity");
+            duration = 0;
+            _pcrClock.reset();
+        }
+        else {
+            start = _pcrClock.departure(segment.pcrBegin);
+        }
+    }
+
+    // a datagram is due when its last packet is due, packets are spread evenly over the PCR interval
+    std::vector<Poco::Timestamp> departures(datagramCount);
+    for (unsigned int d = 0; d < datagramCount; d++) {
+        unsigned int lastPacket = (d + 1) * PacketsPerDatagram;
+        Poco::Timestamp::TimeDiff offset = 0;
+        if (packetCount && lastPacket > carried) {
+            offset = duration * (lastPacket - carried) / packetCount;
+        }
+        departures[d] = start + offset;
+    }
+
+    unsigned int first = 0;
+    while (first < datagramCount && sendThreadRunning()) {
+        Poco::Timestamp::TimeDiff wait = departures[first] - Poco::Timestamp();
+        if (wait >= 1000) {
+            // sleep in short steps, so that close() doesn't wait for a whole segment
+            Poco::Thread::sleep(std::min(wait / 1000, (Poco::Timestamp::TimeDiff)100));
+            continue;
+        }
+        Poco::Timestamp batchEnd = Poco::Timestamp() + BatchWindow;
+        unsigned int count = 0;
+        while (first + count < datagramCount && count < BatchSize && departures[first + count] <= batchEnd) {
+            count++;
+        }
+        if (!sendDatagrams(first, count, departures)) {
+            break;
+        }
+        first += count;
+    }
+    _sendBuffer.erase(_sendBuffer.begin(), _sendBuffer.begin() + datagramCount * datagramSize);
+}
+
+
+bool
+RtpSender::sendDatagrams(unsigned int first, unsigned int count, const std::vector<Poco::Timestamp>& departures)
+{
+    const unsigned int datagramSize = PacketsPerDatagram * TransportStreamPacket::Size;
+    const unsigned int headerSize = 12;
+    Poco::UInt8 headers[BatchSize][headerSize];
+    struct iovec iov[BatchSize][2];
+    struct mmsghdr msgs[BatchSize];
+    ::memset(msgs, 0, sizeof(msgs));
+    for (unsigned int i = 0; i < count; i++) {
+        Poco::UInt8* pHeader = headers[i];
+        // version 2, no padding, extension or csrc, payload type 33 is MP2T with a 90 kHz clock
+        Poco::UInt32 timestamp = departures[first + i].epochMicroseconds() * 9 / 100;
+        pHeader[0] = 0x80;
+        pHeader[1] = 33;
+        pHeader[2] = _sequenceNumber >> 8;
+        pHeader[3] = _sequenceNumber & 0xff;
+        pHeader[4] = timestamp >> 24;
+        pHeader[5] = (timestamp >> 16) & 0xff;
+        pHeader[6] = (timestamp >> 8) & 0xff;
+        pHeader[7] = timestamp & 0xff;
+        pHeader[8] = _ssrc >> 24;
+        pHeader[9] = (_ssrc >> 16) & 0xff;
+        pHeader[10] = (_ssrc >> 8) & 0xff;
+        pHeader[11] = _ssrc & 0xff;
+        _sequenceNumber++;
+        iov[i][0].iov_base = pHeader;
+        iov[i][0].iov_len = headerSize;
+        iov[i][1].iov_base = &_sendBuffer[(first + i) * datagramSize];
+        iov[i][1].iov_len = datagramSize;
+        msgs[i].msg_hdr.msg_iov = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+    unsigned int sent = 0;
+    while (sent < count) {
+        int res = ::sendmmsg(_socket, msgs + sent, count - sent, 0);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG(dvb, error, "rtp sender to " + _address + " failed to send: " + std::string(strerror(errno)));
+            return false;
+        }
+        sent += res;
+    }
+    Poco::ScopedLock<Poco::FastMutex> lock(_senderLock);
+    _datagramsSent += count;
+    return true;
+}
+
+
+Poco::UInt64
+RtpSender::getDatagramsSent()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_senderLock);
+    return _datagramsSent;
+}
+
+
+Poco::UInt64
+RtpSender::getBytesDropped()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_senderLock);
+    return _bytesDropped;
+}
+
+
+unsigned int
+MulticastStream::getId()
+{
+    return _id;
+}
+
+
+std::string
+MulticastStream::getServiceName()
+{
+    return _serviceName;
+}
+
+
+std::string
+MulticastStream::getAddress()
+{
+    return _address;
+}
+
+
+Poco::UInt16
+MulticastStream::getPort()
+{
+    return _port;
+}
+
+
+Poco::UInt64
+MulticastStream::getDatagramsSent()
+{
+    return _datagramsSent;
+}
+
+
+Poco::UInt64
+MulticastStream::getBytesDropped()
+{
+    return _bytesDropped;
+}
+
+
+Multicast::Multicast() :
+_nextId(1)
+{
+}
+
+
+Multicast::~Multicast()
+{
+    stopAllStreams();
+}
+
+
+unsigned int
+Multicast::startStream(const std::string& serviceName, const std::string& address, Poco::UInt16 port, unsigned int ttl)
+{
+    Transponder* pTransponder = Device::instance()->getFirstTransponder(serviceName);
+    Service* pService = pTransponder ? pTransponder->getService(serviceName) : 0;
+    if (!pService) {
+        return 0;
+    }
+    RtpSender* pSender = new RtpSender(address, port, ttl, pService->getPcrPid());
+    if (!pSender->open()) {
+        delete pSender;
+        return 0;
+    }
+    pService = Device::instance()->startSplitService(serviceName, pSender, Device::PriorityLive);
+    if (!pService) {
+        LOG(dvb, error, "failed to start service " + serviceName + " for multicast");
+        delete pSender;
+        return 0;
+    }
+    Poco::ScopedLock<Poco::FastMutex> lock(_multicastLock);
+    Sender& sender = _senders[_nextId];
+    sender.pSender = pSender;
+    sender.pService = pService;
+    sender.serviceName = serviceName;
+    sender.address = address;
+    sender.port = port;
+    return _nextId++;
+}
+
+
+bool
+Multicast::stopStream(unsigned int id)
+{
+    _multicastLock.lock();
+    std::map<unsigned int, Sender>::iterator it = _senders.find(id);
+    if (it == _senders.end()) {
+        _multicastLock.unlock();
+        return false;
+    }
+    Sender sender = it->second;
+    _senders.erase(it);
+    _multicastLock.unlock();
+    stopSender(sender);
+    return true;
+}
+
+
+void
+Multicast::stopAllStreams()
+{
+    _multicastLock.lock();
+    std::map<unsigned int, Sender> senders;
+    senders.swap(_senders);
+    _multicastLock.unlock();
+    for (std::map<unsigned int, Sender>::iterator it = senders.begin(); it != senders.end(); ++it) {
+        stopSender(it->second);
+    }
+}
+
+
+void
+Multicast::getStreams(std::vector<MulticastStream>& streams)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_multicastLock);
+    for (std::map<unsigned int, Sender>::iterator it = _senders.begin(); it != _senders.end(); ++it) {
+        MulticastStream stream;
+        stream._id = it->first;
+        stream._serviceName = it->second.serviceName;
+        stream._address = it->second.address;
+        stream._port = it->second.port;
+        stream._datagramsSent = it->second.pSender->getDatagramsSent();
+        stream._bytesDropped = it->second.pSender->getBytesDropped();
+        streams.push_back(stream);
+    }
+}
+
+
+void
+Multicast::stopSender(Sender& sender)
+{
+    // the splitter doesn't write into the sender anymore, once the service is stopped
+    Device::instance()->stopSplitService(sender.pService);
+    delete sender.pSender;
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
@@ -0,0 +1,164 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef Multicast_INCLUDED
+#define Multicast_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <Poco/Types.h>
+#include <Poco/Thread.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
+#include <Poco/Timestamp.h>
+
+#include "Splitter.h"
+#include "TransportStream.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+class Service;
+
+
+class RtpSender : public StreamTarget
+/// Sends a split service as RTP/MP2T (RFC 2250) with 7 TS packets per datagram to a multicast group.
+/// write() cuts the stream into segments from one PCR to the next, the send thread spreads the
+/// datagrams of each segment over its PCR interval and sends them in batches with sendmmsg().
+{
+public:
+    static const unsigned int PacketsPerDatagram;
+    static const unsigned int BatchSize;
+    /// maximum number of datagrams per sendmmsg() call
+    static const Poco::Timestamp::TimeDiff BatchWindow;
+    /// datagrams due within this time are sent with one call
+    static const unsigned int MaxQueueSize;
+
+    RtpSender(const std::string& address, Poco::UInt16 port, unsigned int ttl, Poco::UInt16 pcrPid);
+    ~RtpSender();
+
+    bool open();
+    void close();
+    virtual void write(const char* pData, unsigned int size);
+
+    Poco::UInt64 getDatagramsSent();
+    Poco::UInt64 getBytesDropped();
+
+private:
+    struct Segment
+    {
+        std::vector<char>   data;
+        Poco::UInt64        pcrBegin;
+        Poco::UInt64        pcrEnd;
+        bool                paced;
+    };
+
+    void queueSegment(bool paced, Poco::UInt64 pcrBegin, Poco::UInt64 pcrEnd);
+    void sendThread();
+    bool sendThreadRunning();
+    void sendSegment(Segment& segment);
+    bool sendDatagrams(unsigned int first, unsigned int count, const std::vector<Poco::Timestamp>& departures);
+
+    std::string                         _address;
+    Poco::UInt16                        _port;
+    unsigned int                        _ttl;
+    Poco::UInt16                        _pcrPid;
+    int                                 _socket;
+
+    // written by the remux thread only
+    std::vector<char>                   _pending;
+    Poco::UInt64                        _lastPcr;
+    bool                                _hasPcr;
+    bool                                _dropping;
+
+    std::deque<Segment>                 _segments;
+    unsigned int                        _queuedBytes;
+    Poco::UInt64                        _bytesDropped;
+    Poco::UInt64                        _datagramsSent;
+    Poco::FastMutex                     _senderLock;
+    Poco::Condition                     _segmentCondition;
+
+    // used by the send thread only
+    std::vector<char>                   _sendBuffer;
+    PcrClock                            _pcrClock;
+    Poco::UInt16                        _sequenceNumber;
+    Poco::UInt32                        _ssrc;
+
+    Poco::Thread*                       _pSendThread;
+    Poco::RunnableAdapter<RtpSender>    _sendThreadRunnable;
+    bool                                _sendThreadRunning;
+};
+
+
+class MulticastStream
+{
+    friend class Multicast;
+
+public:
+    unsigned int getId();
+    std::string getServiceName();
+    std::string getAddress();
+    Poco::UInt16 getPort();
+    Poco::UInt64 getDatagramsSent();
+    Poco::UInt64 getBytesDropped();
+
+private:
+    unsigned int        _id;
+    std::string         _serviceName;
+    std::string         _address;
+    Poco::UInt16        _port;
+    Poco::UInt64        _datagramsSent;
+    Poco::UInt64        _bytesDropped;
+};
+
+
+class Multicast
+/// Services that are sent to a multicast group. They are started with live priority
+/// and split from the multiplex like recordings.
+{
+public:
+    Multicast();
+    ~Multicast();
+
+    unsigned int startStream(const std::string& serviceName, const std::string& address, Poco::UInt16 port, unsigned int ttl);
+    /// returns the id of the stream, 0 if the service could not be started
+    bool stopStream(unsigned int id);
+    void stopAllStreams();
+    void getStreams(std::vector<MulticastStream>& streams);
+
+private:
+    struct Sender
+    {
+        RtpSender*      pSender;
+        Service*        pService;
+        std::string     serviceName;
+        std::string     address;
+        Poco::UInt16    port;
+    };
+
+    void stopSender(Sender& sender);
+
+    std::map<unsigned int, Sender>      _senders;
+    unsigned int                        _nextId;
+    Poco::FastMutex                     _multicastLock;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
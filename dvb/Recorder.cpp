@@ -0,0 +1,613 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <Poco/NumberFormatter.h>
+
+#include "Log.h"
+#include "TransportStream.h"
+#include "Service.h"
+#include "Device.h"
+#include "Recorder.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+Recording::Recording() :
+_id(0),
+_startTime(0),
+_duration(0),
+_state(StateScheduled),
+_bytesWritten(0),
+_bytesDropped(0)
+{
+}
+
+
+unsigned int
+Recording::getId()
+{
+    return _id;
+}
+
+
+std::string
+Recording::getServiceName()
+{
+    return _serviceName;
+}
+
+
+std::string
+Recording::getPath()
+{
+    return _path;
+}
+
+
+std::time_t
+Recording::getStartTime()
+{
+    return _startTime;
+}
+
+
+unsigned int
+Recording::getDuration()
+{
+    return _duration;
+}
+
+
+Recording::State
+Recording::getState()
+{
+    return _state;
+}
+
+
+Poco::UInt64
+Recording::getBytesWritten()
+{
+    return _bytesWritten;
+}
+
+
+Poco::UInt64
+Recording::getBytesDropped()
+{
+    return _bytesDropped;
+}
+
+
+std::string
+Recording::stateToString(State state)
+{
+    switch (state) {
+        case StateScheduled:
+            return "scheduled";
+        case StateRecording:
+            return "recording";
+        case StateFinished:
+            return "finished";
+        case StateFailed:
+            return "failed";
+    }
+    return "";
+}
+
+
+RecordingFile::RecordingFile(Recorder& recorder, const Recording& recording) :
+_recorder(recorder),
+_recording(recording),
+_pService(0),
+_pBuffer(0),
+_bufferLevel(0),
+_dropping(false),
+_fileDesc(-1),
+_directIo(false),
+_fileOffset(0),
+_allocated(0),
+_writeError(false)
+{
+}
+
+
+RecordingFile::~RecordingFile()
+{
+    close();
+    free(_pBuffer);
+}
+
+
+void
+RecordingFile::write(const char* pData, unsigned int size)
+{
+    // the splitter writes whole TS packets and the buffer size is a multiple of the packet size,
+    // so a packet never spans two buffers and dropped data leaves the file packet aligned
+    while (size) {
+        if (!_pBuffer) {
+            Poco::ScopedLock<Poco::FastMutex> lock(_recorder._recorderLock);
+            _pBuffer = _recorder.getBuffer();
+            _bufferLevel = 0;
+            if (!_pBuffer) {
+                if (!_dropping) {
+                    LOG(dvb, warning, "recorder memory budget exhausted, dropping data of recording " + _recording._path);
+                    _dropping = true;
+                }
+                _recording._bytesDropped += size;
+                return;
+            }
+            _dropping = false;
+        }
+        unsigned int bytes = std::min(size, Recorder::BufferSize - _bufferLevel);
+        ::memcpy(_pBuffer + _bufferLevel, pData, bytes);
+        _bufferLevel += bytes;
+        pData += bytes;
+        size -= bytes;
+        if (_bufferLevel == Recorder::BufferSize) {
+            Poco::ScopedLock<Poco::FastMutex> lock(_recorder._recorderLock);
+            _recorder.queueBuffer(this, _pBuffer, _bufferLevel, false);
+            _pBuffer = _recorder.getBuffer();
+            _bufferLevel = 0;
+        }
+    }
+}
+
+
+bool
+RecordingFile::open()
+{
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    _directIo = true;
+    _fileDesc = ::open(_recording._path.c_str(), flags | O_DIRECT, 0644);
+    if (_fileDesc == -1 && errno == EINVAL) {
+        // file system without direct I/O, e.g. tmpfs, fall back to the page cache
+        LOG(dvb, information, "no direct I/O for recording " + _recording._path);
+        _directIo = false;
+        _fileDesc = ::open(_recording._path.c_str(), flags, 0644);
+    }
+    if (_fileDesc == -1) {
+        LOG(dvb, error, "failed to create recording " + _recording._path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    _fileOffset = 0;
+    _allocated = 0;
+    _writeError = false;
+    return true;
+}
+
+
+void
+RecordingFile::finish()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorder._recorderLock);
+    _recorder.queueBuffer(this, _pBuffer, _bufferLevel, true);
+    _pBuffer = 0;
+    _bufferLevel = 0;
+}
+
+
+bool
+RecordingFile::writeBuffer(char* pBuffer, unsigned int size, bool last)
+{
+    bool res = (_fileDesc != -1);
+    if (res && size) {
+        unsigned int writeSize = size;
+        if (_directIo) {
+            // only the last buffer can be partly filled, the padding is truncated on close
+            writeSize = (size + Recorder::Alignment - 1) / Recorder::Alignment * Recorder::Alignment;
+            ::memset(pBuffer + size, 0, writeSize - size);
+        }
+        preallocate(_fileOffset + writeSize);
+        unsigned int bytesWritten = 0;
+        while (bytesWritten < writeSize) {
+            ssize_t bytes = ::pwrite(_fileDesc, pBuffer + bytesWritten, writeSize - bytesWritten, _fileOffset + bytesWritten);
+            if (bytes == -1 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                LOG(dvb, error, "failed to write recording " + _recording._path + ": " + std::string(bytes ? strerror(errno) : "no space left"));
+                res = false;
+                break;
+            }
+            bytesWritten += bytes;
+        }
+        if (res) {
+            _fileOffset += size;
+        }
+    }
+    if (last || !res) {
+        close();
+    }
+    return res;
+}
+
+
+void
+RecordingFile::preallocate(Poco::UInt64 end)
+{
+    if (end <= _allocated) {
+        return;
+    }
+    // allocate in large steps to keep the file contiguous, without changing the file size,
+    // so that the recording can already be played back while it is written
+    Poco::UInt64 size = std::max(Recorder::PreallocateSize, end - _allocated);
+    if (::fallocate(_fileDesc, FALLOC_FL_KEEP_SIZE, _allocated, size) == -1) {
+        LOG(dvb, debug, "no preallocation for recording " + _recording._path + ": " + std::string(strerror(errno)));
+        // don't try again, e.g. older NFS versions don't support it at all
+        _allocated = (Poco::UInt64)-1;
+        return;
+    }
+    _allocated += size;
+}
+
+
+void
+RecordingFile::close()
+{
+    if (_fileDesc == -1) {
+        return;
+    }
+    // cuts off the padding of the last direct write and releases unused preallocated blocks
+    if (::ftruncate(_fileDesc, _fileOffset) == -1) {
+        LOG(dvb, error, "failed to truncate recording " + _recording._path + ": " + std::string(strerror(errno)));
+    }
+    ::close(_fileDesc);
+    _fileDesc = -1;
+}
+
+
+const unsigned int Recorder::BufferSize(4 * 188 * 1024);
+const unsigned int Recorder::Alignment(4096);
+const Poco::UInt64 Recorder::PreallocateSize(64 * Recorder::BufferSize);
+const Poco::UInt64 Recorder::DefaultMemoryBudget(64 * 1024 * 1024);
+
+Recorder::Recorder() :
+_nextId(1),
+_bufferCount(0),
+_memoryBudget(DefaultMemoryBudget),
+_scheduleInterval(1000),
+_pScheduleThread(0),
+_scheduleThreadRunnable(*this, &Recorder::scheduleThread),
+_scheduleThreadRunning(false),
+_pWriteThread(0),
+_writeThreadRunnable(*this, &Recorder::writeThread),
+_writeThreadRunning(false)
+{
+}
+
+
+Recorder::~Recorder()
+{
+    stopRecorder();
+    for (std::map<unsigned int, RecordingFile*>::iterator it = _recordings.begin(); it != _recordings.end(); ++it) {
+        delete it->second;
+    }
+    for (std::vector<char*>::iterator it = _freeBuffers.begin(); it != _freeBuffers.end(); ++it) {
+        free(*it);
+    }
+}
+
+
+void
+Recorder::startRecorder()
+{
+    LOG(dvb, debug, "recorder threads start ...");
+
+    if (!_pWriteThread) {
+        _writeThreadRunning = true;
+        _pWriteThread = new Poco::Thread;
+        _pWriteThread->start(_writeThreadRunnable);
+    }
+    if (!_pScheduleThread) {
+        _scheduleThreadRunning = true;
+        _pScheduleThread = new Poco::Thread;
+        _pScheduleThread->start(_scheduleThreadRunnable);
+    }
+}
+
+
+void
+Recorder::stopRecorder()
+{
+    if (_pScheduleThread) {
+        LOG(dvb, debug, "recorder schedule thread stop ...");
+        _recorderLock.lock();
+        _scheduleThreadRunning = false;
+        _scheduleCondition.broadcast();
+        _recorderLock.unlock();
+        if (_pScheduleThread->isRunning() && !_pScheduleThread->tryJoin(2 * _scheduleInterval)) {
+            LOG(dvb, error, "failed to join recorder schedule thread");
+        }
+        delete _pScheduleThread;
+        _pScheduleThread = 0;
+    }
+    std::vector<RecordingFile*> runningFiles;
+    _recorderLock.lock();
+    for (std::map<unsigned int, RecordingFile*>::iterator it = _recordings.begin(); it != _recordings.end(); ++it) {
+        if (it->second->_pService) {
+            runningFiles.push_back(it->second);
+        }
+    }
+    _recorderLock.unlock();
+    for (std::vector<RecordingFile*>::iterator it = runningFiles.begin(); it != runningFiles.end(); ++it) {
+        stopRecording(*it);
+    }
+    if (_pWriteThread) {
+        LOG(dvb, debug, "recorder write thread stop ...");
+        _recorderLock.lock();
+        _writeThreadRunning = false;
+        _writeCondition.broadcast();
+        _recorderLock.unlock();
+        // the write queue is drained before the thread finishes, so wait as long as the disk needs
+        _pWriteThread->join();
+        delete _pWriteThread;
+        _pWriteThread = 0;
+    }
+}
+
+
+void
+Recorder::setMemoryBudget(Poco::UInt64 bytes)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    _memoryBudget = bytes;
+}
+
+
+unsigned int
+Recorder::addRecording(const std::string& serviceName, const std::string& path, std::time_t startTime, unsigned int duration)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    Recording recording;
+    recording._id = _nextId++;
+    recording._serviceName = serviceName;
+    recording._path = path;
+    recording._startTime = startTime ? startTime : std::time(0);
+    recording._duration = duration;
+    _recordings[recording._id] = new RecordingFile(*this, recording);
+    _scheduleCondition.broadcast();
+    LOG(dvb, information, "recording " + Poco::NumberFormatter::format(recording._id) + " of " + serviceName + " scheduled into " + path);
+    return recording._id;
+}
+
+
+std::string
+Recorder::recordingPath(const std::string& directory, const std::string& serviceName, std::time_t startTime)
+{
+    std::string fileName = Poco::NumberFormatter::format((Poco::Int64)startTime) + "-" + serviceName + ".ts";
+    // the recording must stay in directory
+    std::replace(fileName.begin(), fileName.end(), '/', '_');
+    return directory + "/" + fileName;
+}
+
+
+bool
+Recorder::delRecording(unsigned int id)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    std::map<unsigned int, RecordingFile*>::iterator it = _recordings.find(id);
+    if (it == _recordings.end()) {
+        return false;
+    }
+    Recording& recording = it->second->_recording;
+    if (recording._state == Recording::StateRecording) {
+        // the writer still needs the file, so shorten the recording and let the schedule thread stop it
+        std::time_t now = std::time(0);
+        if (recording._startTime + (std::time_t)recording._duration > now) {
+            recording._duration = now > recording._startTime ? now - recording._startTime : 0;
+        }
+        _scheduleCondition.broadcast();
+        return true;
+    }
+    delete it->second;
+    _recordings.erase(it);
+    return true;
+}
+
+
+void
+Recorder::getRecordings(std::vector<Recording>& recordings)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    for (std::map<unsigned int, RecordingFile*>::iterator it = _recordings.begin(); it != _recordings.end(); ++it) {
+        recordings.push_back(it->second->_recording);
+    }
+}
+
+
+void
+Recorder::scheduleThread()
+{
+    LOG(dvb, debug, "recorder schedule thread started.");
+
+    while (scheduleThreadRunning()) {
+        std::vector<RecordingFile*> startFiles;
+        std::vector<RecordingFile*> stopFiles;
+        _recorderLock.lock();
+        std::time_t now = std::time(0);
+        for (std::map<unsigned int, RecordingFile*>::iterator it = _recordings.begin(); it != _recordings.end(); ++it) {
+            Recording& recording = it->second->_recording;
+            std::time_t end = recording._startTime + recording._duration;
+            if (recording._state == Recording::StateScheduled && recording._startTime <= now) {
+                if (end <= now) {
+                    LOG(dvb, error, "recording " + recording._path + " missed its schedule");
+                    recording._state = Recording::StateFailed;
+                    continue;
+                }
+                // from now on the recording is not deleted until the writer is done with it
+                recording._state = Recording::StateRecording;
+                startFiles.push_back(it->second);
+            }
+            else if (it->second->_pService && end <= now) {
+                stopFiles.push_back(it->second);
+            }
+        }
+        _recorderLock.unlock();
+
+        for (std::vector<RecordingFile*>::iterator it = stopFiles.begin(); it != stopFiles.end(); ++it) {
+            stopRecording(*it);
+        }
+        // stop first, so that a recording following on another transponder finds the frontend free
+        for (std::vector<RecordingFile*>::iterator it = startFiles.begin(); it != startFiles.end(); ++it) {
+            startRecording(*it);
+        }
+
+        _recorderLock.lock();
+        if (_scheduleThreadRunning) {
+            _scheduleCondition.tryWait<Poco::FastMutex>(_recorderLock, _scheduleInterval);
+        }
+        _recorderLock.unlock();
+    }
+
+    LOG(dvb, debug, "recorder schedule thread finished.");
+}
+
+
+bool
+Recorder::scheduleThreadRunning()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    return _scheduleThreadRunning;
+}
+
+
+void
+Recorder::writeThread()
+{
+    LOG(dvb, debug, "recorder write thread started.");
+
+    for (;;) {
+        _recorderLock.lock();
+        while (_writeQueue.empty() && _writeThreadRunning) {
+            _writeCondition.wait<Poco::FastMutex>(_recorderLock);
+        }
+        if (_writeQueue.empty()) {
+            _recorderLock.unlock();
+            break;
+        }
+        WriteJob job = _writeQueue.front();
+        _writeQueue.pop_front();
+        _recorderLock.unlock();
+
+        // only this thread touches the file of a recording, so the disk is accessed without the lock
+        bool res = job.pFile->writeBuffer(job.pBuffer, job.size, job.last);
+
+        Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+        if (job.pBuffer) {
+            _freeBuffers.push_back(job.pBuffer);
+        }
+        Recording& recording = job.pFile->_recording;
+        if (res) {
+            recording._bytesWritten += job.size;
+        }
+        else {
+            job.pFile->_writeError = true;
+        }
+        if (job.last) {
+            recording._state = job.pFile->_writeError ? Recording::StateFailed : Recording::StateFinished;
+            LOG(dvb, information, "recording " + recording._path + " " + Recording::stateToString(recording._state) + ", "
+                    + Poco::NumberFormatter::format(recording._bytesWritten) + " bytes written, "
+                    + Poco::NumberFormatter::format(recording._bytesDropped) + " bytes dropped");
+        }
+    }
+
+    LOG(dvb, debug, "recorder write thread finished.");
+}
+
+
+void
+Recorder::startRecording(RecordingFile* pFile)
+{
+    LOG(dvb, information, "start recording " + pFile->_recording._path);
+
+    Service* pService = 0;
+    if (pFile->open()) {
+        pService = Device::instance()->startSplitService(pFile->_recording._serviceName, pFile, Device::PriorityRecording);
+        if (!pService) {
+            LOG(dvb, error, "failed to start service " + pFile->_recording._serviceName + " for recording " + pFile->_recording._path);
+            pFile->close();
+            ::unlink(pFile->_recording._path.c_str());
+        }
+    }
+    Poco::ScopedLock<Poco::FastMutex> lock(_recorderLock);
+    if (pService) {
+        pFile->_pService = pService;
+    }
+    else {
+        pFile->_recording._state = Recording::StateFailed;
+    }
+}
+
+
+void
+Recorder::stopRecording(RecordingFile* pFile)
+{
+    LOG(dvb, information, "stop recording " + pFile->_recording._path);
+
+    _recorderLock.lock();
+    Service* pService = pFile->_pService;
+    pFile->_pService = 0;
+    _recorderLock.unlock();
+    if (!pService) {
+        return;
+    }
+    // removes the service from the splitter, so nothing is written into the recording afterwards
+    Device::instance()->stopSplitService(pService);
+    pFile->finish();
+}
+
+
+char*
+Recorder::getBuffer()
+{
+    if (!_freeBuffers.empty()) {
+        char* pBuffer = _freeBuffers.back();
+        _freeBuffers.pop_back();
+        return pBuffer;
+    }
+    if ((Poco::UInt64)(_bufferCount + 1) * BufferSize > _memoryBudget) {
+        return 0;
+    }
+    void* pBuffer = 0;
+    if (::posix_memalign(&pBuffer, Alignment, BufferSize)) {
+        return 0;
+    }
+    _bufferCount++;
+    return (char*)pBuffer;
+}
+
+
+void
+Recorder::queueBuffer(RecordingFile* pFile, char* pBuffer, unsigned int size, bool last)
+{
+    WriteJob job;
+    job.pFile = pFile;
+    job.pBuffer = pBuffer;
+    job.size = size;
+    job.last = last;
+    _writeQueue.push_back(job);
+    _writeCondition.signal();
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
@@ -0,0 +1,180 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef Recorder_INCLUDED
+#define Recorder_INCLUDED
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+#include <Poco/Types.h>
+#include <Poco/Thread.h>
+#include <Poco/RunnableAdapter.h>
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
+
+#include "Splitter.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+class Service;
+class Recorder;
+
+
+class Recording
+{
+    friend class Recorder;
+    friend class RecordingFile;
+
+public:
+    typedef enum { StateScheduled, StateRecording, StateFinished, StateFailed } State;
+
+    Recording();
+
+    unsigned int getId();
+    std::string getServiceName();
+    std::string getPath();
+    std::time_t getStartTime();
+    unsigned int getDuration();
+    State getState();
+    Poco::UInt64 getBytesWritten();
+    Poco::UInt64 getBytesDropped();
+    /// bytes of the service stream that were lost because the memory budget was exhausted
+
+    static std::string stateToString(State state);
+
+private:
+    unsigned int        _id;
+    std::string         _serviceName;
+    std::string         _path;
+    std::time_t         _startTime;
+    unsigned int        _duration;
+    State               _state;
+    Poco::UInt64        _bytesWritten;
+    Poco::UInt64        _bytesDropped;
+};
+
+
+class RecordingFile : public StreamTarget
+/// Output of a recorded service in the splitter. Packets are collected in large buffers,
+/// full buffers are written by the writer thread of the recorder, so the remux thread never
+/// waits for the disk.
+{
+    friend class Recorder;
+
+public:
+    virtual void write(const char* pData, unsigned int size);
+    /// never blocks, drops the data if the memory budget of the recorder is exhausted
+
+private:
+    RecordingFile(Recorder& recorder, const Recording& recording);
+    ~RecordingFile();
+
+    bool open();
+    void finish();
+    /// queue the last, partly filled buffer, called after the queue thread of the service stopped
+    bool writeBuffer(char* pBuffer, unsigned int size, bool last);
+    /// called by the writer thread only
+    void preallocate(Poco::UInt64 end);
+    void close();
+
+    Recorder&           _recorder;
+    Recording           _recording;
+    Service*            _pService;
+    char*               _pBuffer;
+    unsigned int        _bufferLevel;
+    bool                _dropping;
+    int                 _fileDesc;
+    bool                _directIo;
+    Poco::UInt64        _fileOffset;
+    Poco::UInt64        _allocated;
+    bool                _writeError;
+};
+
+
+class Recorder
+/// Records any number of services at once, at the scheduled time and each into its own file.
+/// Streams are collected in buffers of a pool that is limited by the memory budget and written
+/// by one writer thread in large, page aligned chunks with direct I/O into preallocated files.
+{
+    friend class RecordingFile;
+
+public:
+    static const unsigned int BufferSize;
+    /// multiple of the TS packet size and of the page size, as direct I/O needs aligned writes
+    static const unsigned int Alignment;
+    static const Poco::UInt64 PreallocateSize;
+    static const Poco::UInt64 DefaultMemoryBudget;
+
+    Recorder();
+    ~Recorder();
+
+    void startRecorder();
+    void stopRecorder();
+    /// stops all running recordings and writes out their buffers
+    void setMemoryBudget(Poco::UInt64 bytes);
+
+    unsigned int addRecording(const std::string& serviceName, const std::string& path, std::time_t startTime, unsigned int duration);
+    /// returns the id of the recording, startTime 0 starts right away
+    static std::string recordingPath(const std::string& directory, const std::string& serviceName, std::time_t startTime);
+    /// file in directory named after start time and service
+    bool delRecording(unsigned int id);
+    /// a running recording is stopped and keeps its file, other recordings are removed from the schedule
+    void getRecordings(std::vector<Recording>& recordings);
+
+private:
+    struct WriteJob
+    {
+        RecordingFile*  pFile;
+        char*           pBuffer;
+        unsigned int    size;
+        bool            last;
+    };
+
+    void scheduleThread();
+    bool scheduleThreadRunning();
+    void writeThread();
+    void startRecording(RecordingFile* pFile);
+    void stopRecording(RecordingFile* pFile);
+    char* getBuffer();
+    /// called with _recorderLock held, 0 if the memory budget is exhausted
+    void queueBuffer(RecordingFile* pFile, char* pBuffer, unsigned int size, bool last);
+
+    std::map<unsigned int, RecordingFile*>  _recordings;
+    unsigned int                            _nextId;
+    std::vector<char*>                      _freeBuffers;
+    unsigned int                            _bufferCount;
+    Poco::UInt64                            _memoryBudget;
+    std::deque<WriteJob>                    _writeQueue;
+    Poco::FastMutex                         _recorderLock;
+    Poco::Condition                         _writeCondition;
+    Poco::Condition                         _scheduleCondition;
+
+    const int                               _scheduleInterval;
+    Poco::Thread*                           _pScheduleThread;
+    Poco::RunnableAdapter<Recorder>         _scheduleThreadRunnable;
+    bool                                    _scheduleThreadRunning;
+    Poco::Thread*                           _pWriteThread;
+    Poco::RunnableAdapter<Recorder>         _writeThreadRunnable;
+    bool                                    _writeThreadRunning;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
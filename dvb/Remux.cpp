@@ -59,31 +59,81 @@ Service*
 Remux::addService(Service* pService)
 {
     Poco::ScopedLock<Poco::FastMutex> lock(_remuxLock);
+    if (pService->_pNextStreamTarget) {
+        // the service on the transponder may be running for a live reader at the same time
+        LOG(dvb, debug, "split service " + pService->getName());
+        Service* pOutput = new Service(*pService);
+        _splitter.addService(pOutput);
+        return pOutput;
+    }
     std::vector<Service*>::iterator it = std::find(_services.begin(), _services.end(), pService);
     if (it != _services.end()) {
 //        // service already added to remux, need a clone
         LOG(dvb, debug, "clone service " + pService->getName());
-        pService = new Service(*pService);
+        Service* pOrigin = pService;
+        pService = new Service(*pOrigin);
+        pService->_pOrigin = pOrigin;
     }
     pService->startQueueThread();
     _services.push_back(pService);
+    indexServices();
     return pService;
 }
 
 
 void
 Remux::delService(Service* pService)
+{
+    detachService(pService);
+    if (pService->_clone) {
+        delete pService;
+    }
+}
+
+
+void
+Remux::detachService(Service* pService)
 {
     Poco::ScopedLock<Poco::FastMutex> lock(_remuxLock);
+    if (_splitter.delService(pService)) {
+        return;
+    }
     std::vector<Service*>::iterator it = std::find(_services.begin(), _services.end(), pService);
     if (it != _services.end()) {
         _services.erase(it);
+        indexServices();
     }
     pService->stopQueueThread();
     pService->waitForStopQueueThread();
     pService->flush();
-    if (pService->_clone) {
-        delete pService;
+}
+
+
+void
+Remux::indexServices()
+{
+    _pidIndex.clear();
+    for (std::vector<Service*>::iterator it = _services.begin(); it != _services.end(); ++it) {
+        for (std::set<Poco::UInt16>::iterator pit = (*it)->_pids.begin(); pit != (*it)->_pids.end(); ++pit) {
+            _pidIndex[*pit].push_back(*it);
+        }
+    }
+}
+
+
+void
+Remux::dispatchPacket(TransportStreamPacket* pTsPacket)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_remuxLock);
+    _monitor.checkPacket((const Poco::UInt8*)pTsPacket->getData());
+    std::unordered_map<Poco::UInt16, std::vector<Service*> >::iterator it = _pidIndex.find(pTsPacket->getPacketIdentifier());
+    if (it != _pidIndex.end()) {
+        for (std::vector<Service*>::iterator sit = it->second.begin(); sit != it->second.end(); ++sit) {
+            (*sit)->queueTsPacket(pTsPacket);
+        }
+    }
+    if (_splitter.hasServices()) {
+        _splitter.splitPacket(pTsPacket);
     }
 }
 
@@ -174,6 +224,22 @@ Remux::flush()
 }
 
 
+void
+Remux::getMonitorStats(MonitorStats& stats)
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_remuxLock);
+    _monitor.getStats(stats);
+}
+
+
+void
+Remux::resetMonitor()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_remuxLock);
+    _monitor.reset();
+}
+
+
 bool
 Remux::readThreadRunning()
 {
@@ -206,12 +272,19 @@ Remux::getTransportStreamPacket()
                     bytesToRead -= bytesRead;
                     if (pPacket->getBytes<Poco::UInt8>(0) != TransportStreamPacket::SyncByte) {
                         LOG(dvb, error, "TS packet wrong sync byte: " + Poco::NumberFormatter::formatHex(pPacket->getBytes<Poco::UInt8>(0)));
+                        _remuxLock.lock();
+                        _monitor.countSyncError();
+                        _remuxLock.unlock();
                         delete pPacket;
                         return 0;
                     }
                 }
                 else if (bytesRead == -1) {
-                    LOG(dvb, error, "remux read thread failed to read from device: " + std::string(strerror(errno)));
+                    int error = errno;
+                    LOG(dvb, error, "remux read thread failed to read from device: " + std::string(strerror(error)));
+                    _remuxLock.lock();
+                    _monitor.countReadError(error);
+                    _remuxLock.unlock();
                     delete pPacket;
                     return 0;
                 }
@@ -367,12 +440,7 @@ Remux::queueThread()
         }
 
         while (TransportStreamPacket* pTsPacket = pPacketBlock->getPacket()) {
-            Poco::UInt16 pid = pTsPacket->getPacketIdentifier();
-            for (std::vector<Service*>::const_iterator it = _services.begin(); it != _services.end(); ++it) {
-                if ((*it)->hasPacketIdentifier(pid)) {
-                    (*it)->queueTsPacket(pTsPacket);
-                }
-            }
+            dispatchPacket(pTsPacket);
         }
         // NOTE: enabling queue thread reduces cpu load but introduces interrupts in stream
         // no interrupts when:
@@ -397,12 +465,7 @@ Remux::readThread()
 //            LOG(dvb, warning, "remux thread could not read packet.");
             continue;
         }
-        Poco::UInt16 pid = pTsPacket->getPacketIdentifier();
-        for (std::vector<Service*>::const_iterator it = _services.begin(); it != _services.end(); ++it) {
-            if ((*it)->hasPacketIdentifier(pid)) {
-                (*it)->queueTsPacket(pTsPacket);
-            }
-        }
+        dispatchPacket(pTsPacket);
         pTsPacket->decRefCounter();
     }
 
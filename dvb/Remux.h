@@ -15,11 +15,15 @@
 
 #include <sys/poll.h>
 
+#include <unordered_map>
+
 #include <Poco/Thread.h>
 #include <Poco/Mutex.h>
 
 #include "TransportStream.h"
 #include "Service.h"
+#include "Splitter.h"
+#include "Monitor.h"
 //#include "Stream.h"
 //#include "../AvStream.h"
 
@@ -52,11 +56,15 @@ public:
 
     Service* addService(Service* pService);
     void delService(Service* pService);
+    void detachService(Service* pService);
+    /// stops the output of pService like delService(), but keeps it for its reader
 
     void startRemux();
     void stopRemux();
     void waitForStopRemux();
     void flush();
+    void getMonitorStats(MonitorStats& stats);
+    void resetMonitor();
 
 private:
     TransportStreamPacket* getTransportStreamPacket();
@@ -68,9 +76,16 @@ private:
     bool readThreadRunning();
     void queueThread();
     bool queueThreadRunning();
+    void indexServices();
+    void dispatchPacket(TransportStreamPacket* pTsPacket);
 
     int                                                 _multiplex;
     std::vector<Service*>                               _services;
+    // services that receive packets of a pid, rebuilt when a service is added or removed
+    std::unordered_map<Poco::UInt16, std::vector<Service*> >    _pidIndex;
+    // recorded services are split from the multiplex without queue threads
+    Splitter                                            _splitter;
+    StreamMonitor                                       _monitor;
 //    std::map<Poco::UInt16, ElementaryTransportStream*>  _pStreams;
 
     Poco::FastMutex                                     _remuxLock;
@@ -10,6 +10,8 @@
 |  it under the terms of the MIT License                                    |
  ***************************************************************************/
 
+#include <fstream>
+
 #include <Poco/StringTokenizer.h>
 
 #include "Device.h"
@@ -25,6 +27,24 @@ main(int argc, char** argv)
         Omm::Dvb::Frontend::listInitialTransponderData();
         return 1;
     }
+    if (std::string(argv[1]) == "-r") {
+        // fast rescan, starting from the result of the last scan
+        if (argc != 3) {
+            std::cerr << "usage: scandvb -r <dvb-xml>" << std::endl;
+            return 1;
+        }
+        std::ifstream dvbXml(argv[2]);
+        if (!dvbXml) {
+            std::cerr << "could not open " << argv[2] << std::endl;
+            return 1;
+        }
+        pDevice->detectAdapters();
+        pDevice->readXml(dvbXml);
+        pDevice->open();
+        pDevice->scan(true);
+        pDevice->writeXml(std::cout);
+        return 0;
+    }
     for (int i = 1; i < argc; ++i) {
         Poco::StringTokenizer initialTransponders(argv[i], "/");
         if (initialTransponders.count() != 2) {
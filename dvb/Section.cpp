@@ -147,6 +147,24 @@ Section::read(Demux* pDemux, Stream* pStream)
 }
 
 
+bool
+Section::read(int fileDesc)
+{
+    // section filters on the demux device deliver exactly one section per read
+    int bytesRead = ::read(fileDesc, _data, _sizeMax);
+    if (bytesRead < 3) {
+        return false;
+    }
+    Poco::UInt16 sectionLength = getValue<Poco::UInt16>(12, 12);
+    if (bytesRead < sectionLength + 3) {
+        return false;
+    }
+    _tableId = getValue<Poco::UInt8>(0, 8);
+    _size = sectionLength + 3;
+    return true;
+}
+
+
 void
 Section::stuff()
 {
@@ -189,6 +207,13 @@ Section::tableIdExtension()
 }
 
 
+Poco::UInt8
+Section::versionNumber()
+{
+    return getValue<Poco::UInt8>(42, 5);
+}
+
+
 Poco::UInt8
 Section::sectionNumber()
 {
@@ -490,9 +515,8 @@ PmtSection::parse()
         _streamTypes.push_back(getValue<Poco::UInt8>(headerSize + offset, 8));
         _streamPids.push_back(getValue<Poco::UInt16>(headerSize + offset + 11, 13));
         Poco::UInt16 esInfoLength = getValue<Poco::UInt16>(headerSize + offset + 28, 12);
-        if (!esInfoLength) {
-            _esInfoDescriptors.push_back(0);
-        }
+        _esInfoOffsets.push_back((headerSize + offset + 40) / 8);
+        _esInfoLengths.push_back(esInfoLength);
         offset += 40 + esInfoLength * 8;
     }
 }
@@ -533,10 +557,10 @@ PmtSection::streamPid(unsigned int streamIndex)
 }
 
 
-Descriptor*
-PmtSection::esInfoDescriptor(unsigned int streamIndex)
+DescriptorIterator
+PmtSection::esInfoDescriptors(unsigned int streamIndex)
 {
-    return _esInfoDescriptors[streamIndex];
+    return DescriptorIterator(getData(_esInfoOffsets[streamIndex]), _esInfoLengths[streamIndex]);
 }
 
 
@@ -559,29 +583,16 @@ SdtSection::parse()
     unsigned int byteHead = 11;
     unsigned int sdtLoopLength = size() - byteHead - 4;
     unsigned int byteOffset = byteHead;
-    unsigned int serviceIndex = 0;
     while (byteOffset < sdtLoopLength) {
-        _serviceDescriptors.push_back(std::vector<Descriptor*>());
         Poco::UInt16 serviceId = getValue<Poco::UInt16>(byteOffset * 8, 16);
         _serviceIds.push_back(serviceId);
         _serviceRunningStatus.push_back(getValue<Poco::UInt8>(byteOffset * 8 + 24, 3));
         _serviceScrambled.push_back(getValue<Poco::UInt8>(byteOffset * 8 + 27, 1));
 
         Poco::UInt16 serviceDescriptorsLength = getValue<Poco::UInt16>(byteOffset * 8 + 28, 12);
-        unsigned int serviceByteHead = byteOffset + 5;
-        unsigned int serviceByteOffset = 0;
-        while (serviceByteOffset < serviceDescriptorsLength) {
-            Descriptor* pDescriptor = Descriptor::createDescriptor(getData(serviceByteHead + serviceByteOffset));
-            _serviceDescriptors[serviceIndex].push_back(pDescriptor);
-            if (pDescriptor) {
-                serviceByteOffset += pDescriptor->getDescriptorLength();
-            }
-            else {
-                break;
-            }
-        }
+        _serviceDescriptorOffsets.push_back(byteOffset + 5);
+        _serviceDescriptorLengths.push_back(serviceDescriptorsLength);
         byteOffset += serviceDescriptorsLength + 5;
-        serviceIndex++;
     }
 }
 
@@ -600,10 +611,10 @@ SdtSection::serviceId(unsigned int serviceIndex)
 }
 
 
-std::string
+Poco::UInt8
 SdtSection::runningStatus(unsigned int serviceIndex)
 {
-    return Service::statusToString(_serviceRunningStatus[serviceIndex]);
+    return _serviceRunningStatus[serviceIndex];
 }
 
 
@@ -614,17 +625,10 @@ SdtSection::scrambled(unsigned int serviceIndex)
 }
 
 
-unsigned int
-SdtSection::serviceDescriptorCount(unsigned int serviceIndex)
-{
-    return _serviceDescriptors[serviceIndex].size();
-}
-
-
-Descriptor*
-SdtSection::serviceDescriptor(unsigned int serviceIndex, int serviceDescriptorIndex)
+DescriptorIterator
+SdtSection::serviceDescriptors(unsigned int serviceIndex)
 {
-    return _serviceDescriptors[serviceIndex][serviceDescriptorIndex];
+    return DescriptorIterator(getData(_serviceDescriptorOffsets[serviceIndex]), _serviceDescriptorLengths[serviceIndex]);
 }
 
 
@@ -643,7 +647,8 @@ SdtSection::serviceDescriptor(unsigned int serviceIndex, int serviceDescriptorIn
 
 
 NitSection::NitSection(Poco::UInt8 tableId) :
-Section("NIT", 0x10, tableId, 15000)
+Section("NIT", 0x10, tableId, 15000),
+_networkDescriptorsLength(0)
 {
 }
 
@@ -659,75 +664,150 @@ void
 NitSection::parse()
 {
     Poco::UInt16 networkDescriptorsLength = getValue<Poco::UInt16>(68, 12);
+    _networkDescriptorsLength = networkDescriptorsLength;
     unsigned int head = 80;
-    unsigned int byteOffset = 0;
-    while (byteOffset < networkDescriptorsLength) {
-        Descriptor* pDescriptor = Descriptor::createDescriptor(getData(10 + byteOffset));
-        _networkDescriptors.push_back(pDescriptor);
-        if (NetworkNameDescriptor* pD = dynamic_cast<NetworkNameDescriptor*>(pDescriptor)) {
-            _networkName = pD->getNetworkName();
-        }
+    for (DescriptorIterator it = networkDescriptors(); !it.atEnd(); it.next()) {
         // TODO: which other descriptors can be located here?
-        if (pDescriptor) {
-            byteOffset += pDescriptor->getDescriptorLength();
-        }
-        else {
-            break;
+        if (it.tag() == NetworkNameDescriptor::Tag) {
+            _networkName = it.view<NetworkNameDescriptor>().getNetworkName();
         }
     }
     Poco::UInt16 transportStreamLoopLength = getValue<Poco::UInt16>(head + networkDescriptorsLength * 8 + 4, 12);
     head = head + networkDescriptorsLength * 8 + 16;
-    byteOffset = 0;
-    unsigned int transportStreamIndex = 0;
+    unsigned int byteOffset = 0;
     while (byteOffset < transportStreamLoopLength) {
         _transportStreamIds.push_back(getValue<Poco::UInt16>(head + byteOffset * 8, 16));
         _originalNetworkIds.push_back(getValue<Poco::UInt16>(head + byteOffset * 8 + 16, 16));
-        _transportStreamDescriptors.push_back(std::vector<Descriptor*>());
 
         Poco::UInt16 transportDescriptorsLength = getValue<Poco::UInt16>(head + byteOffset * 8 + 36, 12);
-        unsigned int transportHead = head + byteOffset * 8 + 48;
-        unsigned int transportByteOffset = 0;
-        while (transportByteOffset < transportDescriptorsLength) {
-            Descriptor* pDescriptor = Descriptor::createDescriptor(getData(transportHead / 8 + transportByteOffset));
-            _transportStreamDescriptors[transportStreamIndex].push_back(pDescriptor);
-            if (pDescriptor) {
-                transportByteOffset += pDescriptor->getDescriptorLength();
-            }
-            else {
-                break;
-            }
-        }
+        _transportStreamDescriptorOffsets.push_back((head + byteOffset * 8 + 48) / 8);
+        _transportStreamDescriptorLengths.push_back(transportDescriptorsLength);
         byteOffset += transportDescriptorsLength + 6;
-        transportStreamIndex++;
+    }
+}
+
+
+EitSection::EitSection(Poco::UInt8 tableId) :
+Section("EIT", 0x12, tableId, 5000)
+{
+}
+
+
+Section*
+EitSection::clone()
+{
+    return new EitSection(tableId());
+}
+
+
+void
+EitSection::parse()
+{
+    _eventOffsets.clear();
+    unsigned int byteOffset = 14;
+    unsigned int byteEnd = size() - 4;
+    while (byteOffset + 12 <= byteEnd) {
+        _eventOffsets.push_back(byteOffset);
+        byteOffset += getValue<Poco::UInt16>(byteOffset * 8 + 84, 12) + 12;
+    }
+    if (byteOffset > byteEnd && _eventOffsets.size()) {
+        // last event is truncated
+        _eventOffsets.pop_back();
     }
 }
 
 
 Poco::UInt16
-NitSection::networkId()
+EitSection::serviceId()
 {
     return tableIdExtension();
 }
 
 
-std::string
-NitSection::networkName()
+Poco::UInt16
+EitSection::transportStreamId()
 {
-    return _networkName;
+    return getBytes<Poco::UInt16>(8);
+}
+
+
+Poco::UInt16
+EitSection::originalNetworkId()
+{
+    return getBytes<Poco::UInt16>(10);
 }
 
 
 unsigned int
-NitSection::networkDescriptorCount()
+EitSection::eventCount()
+{
+    return _eventOffsets.size();
+}
+
+
+Poco::UInt16
+EitSection::eventId(unsigned int eventIndex)
 {
-    return _networkDescriptors.size();
+    return getBytes<Poco::UInt16>(_eventOffsets[eventIndex]);
 }
 
 
-Descriptor*
-NitSection::networkDescriptor(unsigned int networkDescriptorIndex)
+std::time_t
+EitSection::startTime(unsigned int eventIndex)
 {
-    return _networkDescriptors[networkDescriptorIndex];
+    unsigned int byteOffset = _eventOffsets[eventIndex] + 2;
+    // modified julian date, followed by hours, minutes and seconds as bcd
+    Poco::UInt16 mjd = getBytes<Poco::UInt16>(byteOffset);
+    return (std::time_t)(mjd - 40587) * 86400
+            + getBcd<unsigned int>(byteOffset + 2, 2) * 3600
+            + getBcd<unsigned int>(byteOffset + 3, 2) * 60
+            + getBcd<unsigned int>(byteOffset + 4, 2);
+}
+
+
+unsigned int
+EitSection::duration(unsigned int eventIndex)
+{
+    unsigned int byteOffset = _eventOffsets[eventIndex] + 7;
+    return getBcd<unsigned int>(byteOffset, 2) * 3600
+            + getBcd<unsigned int>(byteOffset + 1, 2) * 60
+            + getBcd<unsigned int>(byteOffset + 2, 2);
+}
+
+
+Poco::UInt8
+EitSection::runningStatus(unsigned int eventIndex)
+{
+    return getValue<Poco::UInt8>(_eventOffsets[eventIndex] * 8 + 80, 3);
+}
+
+
+DescriptorIterator
+EitSection::eventDescriptors(unsigned int eventIndex)
+{
+    unsigned int byteOffset = _eventOffsets[eventIndex];
+    return DescriptorIterator(getData(byteOffset + 12), getValue<Poco::UInt16>(byteOffset * 8 + 84, 12));
+}
+
+
+Poco::UInt16
+NitSection::networkId()
+{
+    return tableIdExtension();
+}
+
+
+std::string
+NitSection::networkName()
+{
+    return _networkName;
+}
+
+
+DescriptorIterator
+NitSection::networkDescriptors()
+{
+    return DescriptorIterator(getData(10), _networkDescriptorsLength);
 }
 
 
@@ -752,17 +832,10 @@ NitSection::originalNetworkId(unsigned int transportStreamIndex)
 }
 
 
-unsigned int
-NitSection::transportStreamDescriptorCount(unsigned int transportStreamIndex)
-{
-    return _transportStreamDescriptors[transportStreamIndex].size();
-}
-
-
-Descriptor*
-NitSection::transportStreamDescriptor(unsigned int transportStreamIndex, unsigned int transportStreamDescriptorIndex)
+DescriptorIterator
+NitSection::transportStreamDescriptors(unsigned int transportStreamIndex)
 {
-    return _transportStreamDescriptors[transportStreamIndex][transportStreamDescriptorIndex];
+    return DescriptorIterator(getData(_transportStreamDescriptorOffsets[transportStreamIndex]), _transportStreamDescriptorLengths[transportStreamIndex]);
 }
 
 
@@ -13,13 +13,15 @@
 #ifndef Section_INCLUDED
 #define Section_INCLUDED
 
+#include <ctime>
+
 #include "DvbUtil.h"
+#include "Descriptor.h"
 
 
 namespace Omm {
 namespace Dvb {
 
-class Descriptor;
 class Stream;
 class Demux;
 class Section;
@@ -52,6 +54,7 @@ public:
     ~Section();
 
     void read(Demux* pDemux, Stream* pStream);
+    bool read(int fileDesc);
     void stuff();
     virtual Section* clone();
     virtual void parse() {}
@@ -60,6 +63,7 @@ public:
     Poco::UInt16 packetId();
     Poco::UInt8 tableId();
     Poco::UInt16 tableIdExtension();
+    Poco::UInt8 versionNumber();
     Poco::UInt8 sectionNumber();
     Poco::UInt8 lastSectionNumber();
 
@@ -126,13 +130,14 @@ public:
     unsigned int streamCount();
     Poco::UInt8 streamType(unsigned int streamIndex);
     Poco::UInt16 streamPid(unsigned int streamIndex);
-    Descriptor* esInfoDescriptor(unsigned int streamIndex);
+    DescriptorIterator esInfoDescriptors(unsigned int streamIndex);
 
 private:
     Poco::UInt16                        _pcrPid;
     std::vector<Poco::UInt8>            _streamTypes;
     std::vector<Poco::UInt16>           _streamPids;
-    std::vector<Descriptor*>            _esInfoDescriptors;
+    std::vector<unsigned int>           _esInfoOffsets;
+    std::vector<Poco::UInt16>           _esInfoLengths;
 };
 
 
@@ -152,16 +157,16 @@ public:
 
     unsigned int serviceCount();
     Poco::UInt16 serviceId(unsigned int serviceIndex);
-    std::string runningStatus(unsigned int serviceIndex);
+    Poco::UInt8 runningStatus(unsigned int serviceIndex);
     bool scrambled(unsigned int serviceIndex);
-    unsigned int serviceDescriptorCount(unsigned int serviceIndex);
-    Descriptor* serviceDescriptor(unsigned int serviceIndex, int serviceDescriptorIndex);
+    DescriptorIterator serviceDescriptors(unsigned int serviceIndex);
 
 private:
     std::vector<Poco::UInt16>                   _serviceIds;
     std::vector<Poco::UInt8>                    _serviceRunningStatus;
     std::vector<bool>                           _serviceScrambled;
-    std::vector<std::vector<Descriptor*> >      _serviceDescriptors;
+    std::vector<unsigned int>                   _serviceDescriptorOffsets;
+    std::vector<Poco::UInt16>                   _serviceDescriptorLengths;
 };
 
 
@@ -177,21 +182,48 @@ public:
 
     Poco::UInt16 networkId();
     std::string networkName();
-    unsigned int networkDescriptorCount();
-    Descriptor* networkDescriptor(unsigned int networkDescriptorIndex);
+    DescriptorIterator networkDescriptors();
 
     unsigned int transportStreamCount();
     Poco::UInt16 transportStreamId(unsigned int transportStreamIndex);
     Poco::UInt16 originalNetworkId(unsigned int transportStreamIndex);
-    unsigned int transportStreamDescriptorCount(unsigned int transportStreamIndex);
-    Descriptor* transportStreamDescriptor(unsigned int transportStreamIndex, unsigned int transportStreamDescriptorIndex);
+    DescriptorIterator transportStreamDescriptors(unsigned int transportStreamIndex);
 
 private:
     std::string                                 _networkName;
+    Poco::UInt16                                _networkDescriptorsLength;
     std::vector<Poco::UInt16>                   _transportStreamIds;
     std::vector<Poco::UInt16>                   _originalNetworkIds;
-    std::vector<Descriptor*>                    _networkDescriptors;
-    std::vector<std::vector<Descriptor*> >      _transportStreamDescriptors;
+    std::vector<unsigned int>                   _transportStreamDescriptorOffsets;
+    std::vector<Poco::UInt16>                   _transportStreamDescriptorLengths;
+};
+
+
+class EitSection : public Section
+{
+public:
+    enum {EitActualPresentFollowingTableId = 0x4E, EitOtherPresentFollowingTableId = 0x4F,
+          EitActualScheduleTableId = 0x50, EitOtherScheduleLastTableId = 0x6F};
+
+    EitSection(Poco::UInt8 tableId);
+
+    virtual Section* clone();
+    virtual void parse();
+
+    Poco::UInt16 serviceId();
+    Poco::UInt16 transportStreamId();
+    Poco::UInt16 originalNetworkId();
+    unsigned int eventCount();
+    Poco::UInt16 eventId(unsigned int eventIndex);
+    std::time_t startTime(unsigned int eventIndex);
+    /// start time in seconds since the epoch (UTC)
+    unsigned int duration(unsigned int eventIndex);
+    /// duration in seconds
+    Poco::UInt8 runningStatus(unsigned int eventIndex);
+    DescriptorIterator eventDescriptors(unsigned int eventIndex);
+
+private:
+    std::vector<unsigned int>                   _eventOffsets;
 };
 
 
@@ -30,57 +30,32 @@
 #include <Poco/DOM/Document.h>
 
 #include <queue>
+#include <algorithm>
 #include <stack>
 
 #include "Log.h"
 #include "Stream.h"
 #include "TransportStream.h"
+#include "ElementaryStream.h"
 #include "Section.h"
 #include "Service.h"
 #include "Transponder.h"
+#include "ChannelDb.h"
+#include "TimeShift.h"
+#include "Splitter.h"
 
 
 namespace Omm {
 namespace Dvb {
 
 
-const std::string Service::TypeDigitalTelevision("DigitalTelevision");
-const std::string Service::TypeDigitalRadioSound("DigitalRadioSound");
-const std::string Service::TypeTeletext("Teletext");
-const std::string Service::TypeNvodReference("NvodReference");
-const std::string Service::TypeNodTimeShifted("NodTimeShifted");
-const std::string Service::TypeMosaic("Mosaic");
-const std::string Service::TypeFmRadio("FmRadio");
-const std::string Service::TypeDvbSrm("DvbSrm");
-const std::string Service::TypeAdvancedCodecDigitalRadioSound("AdvancedCodecDigitalRadioSound");
-const std::string Service::TypeAdvancedCodecMosaic("AdvancedCodecMosaic");
-const std::string Service::TypeDataBroadcastService("DataBroadcastService");
-const std::string Service::TypeRcsMap("RcsMap");
-const std::string Service::TypeRcsFls("RcsFls");
-const std::string Service::TypeDvbMhp("DvbMhp");
-const std::string Service::TypeMpeg2HdDigitalTelevision("Mpeg2HdDigitalTelevision");
-const std::string Service::TypeAdvancedCodecSdDigitalTelevision("AdvancedCodecSdDigitalTelevision");
-const std::string Service::TypeAdvancedCodecSdNvodTimeShifted("AdvancedCodecSdNvodTimeShifted");
-const std::string Service::TypeAdvancedCodecSdNvodReference("AdvancedCodecSdNvodReference");
-const std::string Service::TypeAdvancedCodecHdDigitalTelevision("AdvancedCodecHdDigitalTelevision");
-const std::string Service::TypeAdvancedCodecHdNvodTimeShifted("AdvancedCodecHdNvodTimeShifted");
-const std::string Service::TypeAdvancedCodecHdNvodReference("AdvancedCodecHdNvodReference");
-const std::string Service::TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision("TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision");
-const std::string Service::TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted("TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted");
-const std::string Service::TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference("TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference");
-
 const unsigned int Service::InvalidPcrPid(0);
 
-const std::string Service::StatusUndefined("Undefined");
-const std::string Service::StatusNotRunning("NotRunning");
-const std::string Service::StatusStartsShortly("StartsShortly");
-const std::string Service::StatusPausing("Pausing");
-const std::string Service::StatusRunning("Running");
-const std::string Service::StatusOffAir("OffAir");
-
 Service::Service(Transponder* pTransponder, const std::string& name, unsigned int sid, unsigned int pmtid) :
 _clone(false),
+_pOrigin(0),
 _pTransponder(pTransponder),
+_type(TypeUndefined),
 _name(name),
 _sid(sid),
 _pmtPid(pmtid),
@@ -93,9 +68,37 @@ _packetQueueTimeout(100),
 // FIXME currently need a large queue, because the renderer needs a long startup time
 // until it begins to actually render the stream
 _packetQueueSize(100000),
+_packetsDropped(0),
 _pQueueThread(0),
 _queueThreadRunnable(*this, &Service::queueThread),
-_queueThreadRunning(false)
+_queueThreadRunning(false),
+_startCacheValid(false),
+_startCacheSize(4096),
+_randomAccessPid(0x1fff),
+_startCacheQueued(false),
+_pmtPacketsVersion(0),
+_psiInterval(100),
+_timeShiftMinutes(0),
+_timeShiftPending(false),
+_pTimeShift(0),
+_pSharedTimeShift(0),
+_timeShiftOutputs(0),
+_pTimeShiftWriter(0),
+_pNextStreamTarget(0),
+_pStreamTarget(0),
+_nextSelection(SelectAll),
+_selection(SelectAll),
+_pcrOnlyPid(InvalidPcrPid),
+_pacing(false),
+_pacedPcr(0),
+_pacedPcrValid(false),
+_pacedPacketsSize(4096),
+_pacingBacklog(1000),
+_packetCounter(0),
+_psiTime(0),
+_psiPmtPacketsVersion(0),
+_patCounter(0),
+_pmtCounter(0)
 {
     _pPat = PatSection::create();
     _pPat->setTableIdExtension(0x0001);  // artificial transport stream id for a TS with one service
@@ -117,7 +120,9 @@ _queueThreadRunning(false)
 
 Service::Service(const Service& service) :
 _clone(true),
+_pOrigin(0),
 _pTransponder(service._pTransponder),
+_type(service._type),
 _name(service._name),
 _sid(service._sid),
 _pmtPid(service._pmtPid),
@@ -132,9 +137,38 @@ _pIStream(0),
 //_pPatTsPacket(new TransportStreamPacket(*service._pPatTsPacket)),
 _packetQueueTimeout(100),
 _packetQueueSize(10000),
+_packetsDropped(0),
 _pQueueThread(0),
 _queueThreadRunnable(*this, &Service::queueThread),
-_queueThreadRunning(false)
+_queueThreadRunning(false),
+_startCacheValid(false),
+_startCacheSize(4096),
+_randomAccessPid(0x1fff),
+_startCacheQueued(false),
+_pmtPacketsVersion(0),
+_psiInterval(100),
+_timeShiftDirectory(service._timeShiftDirectory),
+_timeShiftMinutes(service._timeShiftMinutes),
+_timeShiftPending(false),
+_pTimeShift(0),
+_pSharedTimeShift(0),
+_timeShiftOutputs(0),
+_pTimeShiftWriter(0),
+_pNextStreamTarget(service._pNextStreamTarget),
+_pStreamTarget(0),
+_nextSelection(service._nextSelection),
+_selection(SelectAll),
+_pcrOnlyPid(InvalidPcrPid),
+_pacing(service._pacing),
+_pacedPcr(0),
+_pacedPcrValid(false),
+_pacedPacketsSize(4096),
+_pacingBacklog(1000),
+_packetCounter(0),
+_psiTime(0),
+_psiPmtPacketsVersion(0),
+_patCounter(0),
+_pmtCounter(0)
 {
     // these ad hoc copy ctors for PAT and PAT-TS packet crash on stop of service
 //    ::memcpy(_pPat->getData(), service._pPat->getData(), service._pPat->size());
@@ -161,6 +195,8 @@ _queueThreadRunning(false)
 
 Service::~Service()
 {
+    closeTimeShift();
+    clearStartCache();
     delete _pPatTsPacket;
     delete _pPat;
 }
@@ -185,7 +221,7 @@ Service::readXml(Poco::XML::Node* pXmlService)
             if (pXmlParam->nodeName() == "stream") {
                 std::string type = static_cast<Poco::XML::Element*>(pXmlParam)->getAttribute("type");
                 int pid = Poco::NumberParser::parse(static_cast<Poco::XML::Element*>(pXmlParam)->getAttribute("pid"));
-                Stream* pStream = new Stream(type, pid);
+                Stream* pStream = new Stream(Stream::streamTypeFromString(type), pid);
                 addStream(pStream);
             }
             else if (pXmlParam->nodeName() == "status") {
@@ -194,7 +230,7 @@ Service::readXml(Poco::XML::Node* pXmlService)
                     LOG(dvb, error, "dvb service status has no value");
                 }
                 else {
-                    _status = pVal->innerText();
+                    _status = statusFromString(pVal->innerText());
                 }
             }
             else if (pXmlParam->nodeName() == "programClockPid") {
@@ -230,7 +266,7 @@ Service::readXml(Poco::XML::Node* pXmlService)
                     LOG(dvb, error, "dvb service type has no value");
                 }
                 else {
-                    _type = pVal->innerText();
+                    _type = typeFromString(pVal->innerText());
                 }
             }
             pXmlParam = pXmlParam->nextSibling();
@@ -267,7 +303,7 @@ Service::writeXml(Poco::XML::Element* pTransponder)
     pService->appendChild(pPcrPid);
 
     Poco::AutoPtr<Poco::XML::Element> pStatus = pDoc->createElement("status");
-    Poco::AutoPtr<Poco::XML::Text> pStatusVal = pDoc->createTextNode(_status);
+    Poco::AutoPtr<Poco::XML::Text> pStatusVal = pDoc->createTextNode(statusToString(_status));
     pStatus->appendChild(pStatusVal);
     pService->appendChild(pStatus);
 
@@ -282,7 +318,7 @@ Service::writeXml(Poco::XML::Element* pTransponder)
     pService->appendChild(pProviderName);
 
     Poco::AutoPtr<Poco::XML::Element> pType = pDoc->createElement("type");
-    Poco::AutoPtr<Poco::XML::Text> pTypeVal = pDoc->createTextNode(_type);
+    Poco::AutoPtr<Poco::XML::Text> pTypeVal = pDoc->createTextNode(typeToString(_type));
     pType->appendChild(pTypeVal);
     pService->appendChild(pType);
 
@@ -290,93 +326,234 @@ Service::writeXml(Poco::XML::Element* pTransponder)
 }
 
 
-std::string
+void
+Service::readDb(ChannelDbReader& db)
+{
+    Poco::UInt32 streamCount = db.readUInt32();
+    for (Poco::UInt32 i = 0; i < streamCount && db.good(); i++) {
+        Poco::UInt16 type = db.readUInt16();
+        Poco::UInt16 pid = db.readUInt16();
+        addStream(new Stream(type, pid));
+    }
+    _pcrPid = db.readUInt32();
+    _status = db.readUInt8();
+    _scrambled = db.readUInt8();
+    _providerName = db.readString();
+    _type = db.readUInt8();
+}
+
+
+void
+Service::writeDb(ChannelDbWriter& db)
+{
+    // name, service id and pmt pid are needed by the transponder to create the service
+    db.writeString(getName());
+    db.writeUInt32(_sid);
+    db.writeUInt32(_pmtPid);
+    db.writeUInt32(_streams.size());
+    for (std::vector<Stream*>::iterator it = _streams.begin(); it != _streams.end(); ++it) {
+        (*it)->writeDb(db);
+    }
+    db.writeUInt32(_pcrPid);
+    db.writeUInt8(_status);
+    db.writeUInt8(_scrambled);
+    db.writeString(_providerName);
+    db.writeUInt8(_type);
+}
+
+
+Service::Type
 Service::getType()
 {
-    return _type;
+    return (Type)_type;
 }
 
 
 std::string
-Service::typeToString(Poco::UInt8 status)
+Service::typeToString(Poco::UInt8 type)
 {
-    switch (status) {
-        case 0x01:
-            return TypeDigitalTelevision;
-        case 0x02:
-            return TypeDigitalRadioSound;
-        case 0x03:
-            return TypeTeletext;
-        case 0x04:
-            return TypeNvodReference;
-        case 0x05:
-            return TypeNodTimeShifted;
-        case 0x06:
-            return TypeMosaic;
-        case 0x07:
-            return TypeFmRadio;
-        case 0x08:
-            return TypeDvbSrm;
-        case 0x0A:
-            return TypeAdvancedCodecDigitalRadioSound;
-        case 0x0B:
-            return TypeAdvancedCodecMosaic;
-        case 0x0C:
-            return TypeDataBroadcastService;
-        case 0x0E:
-            return TypeRcsMap;
-        case 0x0F:
-            return TypeRcsFls;
-        case 0x10:
-            return TypeDvbMhp;
-        case 0x11:
-            return TypeMpeg2HdDigitalTelevision;
-        case 0x16:
-            return TypeAdvancedCodecSdDigitalTelevision;
-        case 0x17:
-            return TypeAdvancedCodecSdNvodTimeShifted;
-        case 0x18:
-            return TypeAdvancedCodecSdNvodReference;
-        case 0x19:
-            return TypeAdvancedCodecHdDigitalTelevision;
-        case 0x1A:
-            return TypeAdvancedCodecHdNvodTimeShifted;
-        case 0x1B:
-            return TypeAdvancedCodecHdNvodReference;
-        case 0x1C:
-            return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision;
-        case 0x1D:
-            return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted;
-        case 0x1E:
-            return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference;
+    switch (type) {
+        case TypeDigitalTelevision:
+            return "DigitalTelevision";
+        case TypeDigitalRadioSound:
+            return "DigitalRadioSound";
+        case TypeTeletext:
+            return "Teletext";
+        case TypeNvodReference:
+            return "NvodReference";
+        case TypeNodTimeShifted:
+            return "NodTimeShifted";
+        case TypeMosaic:
+            return "Mosaic";
+        case TypeFmRadio:
+            return "FmRadio";
+        case TypeDvbSrm:
+            return "DvbSrm";
+        case TypeAdvancedCodecDigitalRadioSound:
+            return "AdvancedCodecDigitalRadioSound";
+        case TypeAdvancedCodecMosaic:
+            return "AdvancedCodecMosaic";
+        case TypeDataBroadcastService:
+            return "DataBroadcastService";
+        case TypeRcsMap:
+            return "RcsMap";
+        case TypeRcsFls:
+            return "RcsFls";
+        case TypeDvbMhp:
+            return "DvbMhp";
+        case TypeMpeg2HdDigitalTelevision:
+            return "Mpeg2HdDigitalTelevision";
+        case TypeAdvancedCodecSdDigitalTelevision:
+            return "AdvancedCodecSdDigitalTelevision";
+        case TypeAdvancedCodecSdNvodTimeShifted:
+            return "AdvancedCodecSdNvodTimeShifted";
+        case TypeAdvancedCodecSdNvodReference:
+            return "AdvancedCodecSdNvodReference";
+        case TypeAdvancedCodecHdDigitalTelevision:
+            return "AdvancedCodecHdDigitalTelevision";
+        case TypeAdvancedCodecHdNvodTimeShifted:
+            return "AdvancedCodecHdNvodTimeShifted";
+        case TypeAdvancedCodecHdNvodReference:
+            return "AdvancedCodecHdNvodReference";
+        case TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision:
+            return "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision";
+        case TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted:
+            return "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted";
+        case TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference:
+            return "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference";
         default:
             return "";
     }
 }
 
 
+Poco::UInt8
+Service::typeFromString(const std::string& val)
+{
+    if (val == "DigitalTelevision") {
+        return TypeDigitalTelevision;
+    }
+    else if (val == "DigitalRadioSound") {
+        return TypeDigitalRadioSound;
+    }
+    else if (val == "Teletext") {
+        return TypeTeletext;
+    }
+    else if (val == "NvodReference") {
+        return TypeNvodReference;
+    }
+    else if (val == "NodTimeShifted") {
+        return TypeNodTimeShifted;
+    }
+    else if (val == "Mosaic") {
+        return TypeMosaic;
+    }
+    else if (val == "FmRadio") {
+        return TypeFmRadio;
+    }
+    else if (val == "DvbSrm") {
+        return TypeDvbSrm;
+    }
+    else if (val == "AdvancedCodecDigitalRadioSound") {
+        return TypeAdvancedCodecDigitalRadioSound;
+    }
+    else if (val == "AdvancedCodecMosaic") {
+        return TypeAdvancedCodecMosaic;
+    }
+    else if (val == "DataBroadcastService") {
+        return TypeDataBroadcastService;
+    }
+    else if (val == "RcsMap") {
+        return TypeRcsMap;
+    }
+    else if (val == "RcsFls") {
+        return TypeRcsFls;
+    }
+    else if (val == "DvbMhp") {
+        return TypeDvbMhp;
+    }
+    else if (val == "Mpeg2HdDigitalTelevision") {
+        return TypeMpeg2HdDigitalTelevision;
+    }
+    else if (val == "AdvancedCodecSdDigitalTelevision") {
+        return TypeAdvancedCodecSdDigitalTelevision;
+    }
+    else if (val == "AdvancedCodecSdNvodTimeShifted") {
+        return TypeAdvancedCodecSdNvodTimeShifted;
+    }
+    else if (val == "AdvancedCodecSdNvodReference") {
+        return TypeAdvancedCodecSdNvodReference;
+    }
+    else if (val == "AdvancedCodecHdDigitalTelevision") {
+        return TypeAdvancedCodecHdDigitalTelevision;
+    }
+    else if (val == "AdvancedCodecHdNvodTimeShifted") {
+        return TypeAdvancedCodecHdNvodTimeShifted;
+    }
+    else if (val == "AdvancedCodecHdNvodReference") {
+        return TypeAdvancedCodecHdNvodReference;
+    }
+    else if (val == "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision") {
+        return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision;
+    }
+    else if (val == "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted") {
+        return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted;
+    }
+    else if (val == "TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference") {
+        return TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference;
+    }
+    else {
+        return TypeUndefined;
+    }
+}
+
+
 std::string
 Service::statusToString(Poco::UInt8 status)
 {
     switch (status) {
-        case 0x00:
-            return StatusUndefined;
-        case 0x01:
-            return StatusNotRunning;
-        case 0x02:
-            return StatusStartsShortly;
-        case 0x03:
-            return StatusPausing;
-        case 0x04:
-            return StatusRunning;
-        case 0x05:
-            return StatusOffAir;
+        case StatusUndefined:
+            return "Undefined";
+        case StatusNotRunning:
+            return "NotRunning";
+        case StatusStartsShortly:
+            return "StartsShortly";
+        case StatusPausing:
+            return "Pausing";
+        case StatusRunning:
+            return "Running";
+        case StatusOffAir:
+            return "OffAir";
         default:
             return "";
     }
 }
 
 
+Poco::UInt8
+Service::statusFromString(const std::string& val)
+{
+    if (val == "NotRunning") {
+        return StatusNotRunning;
+    }
+    else if (val == "StartsShortly") {
+        return StatusStartsShortly;
+    }
+    else if (val == "Pausing") {
+        return StatusPausing;
+    }
+    else if (val == "Running") {
+        return StatusRunning;
+    }
+    else if (val == "OffAir") {
+        return StatusOffAir;
+    }
+    else {
+        return StatusUndefined;
+    }
+}
+
+
 bool
 Service::isAudio()
 {
@@ -410,10 +587,24 @@ Service::getName()
 }
 
 
-std::string
+unsigned int
+Service::getServiceId()
+{
+    return _sid;
+}
+
+
+unsigned int
+Service::getPcrPid()
+{
+    return _pcrPid;
+}
+
+
+Service::Status
 Service::getStatus()
 {
-    return _status;
+    return (Status)_status;
 }
 
 
@@ -477,12 +668,79 @@ Service::getByteQueue()
 }
 
 
+void
+Service::setTimeShift(const std::string& directory, unsigned int minutes)
+{
+    _timeShiftDirectory = directory;
+    _timeShiftMinutes = minutes;
+}
+
+
+TimeShift*
+Service::getTimeShift()
+{
+    Service* pSource = _pOrigin ? _pOrigin : this;
+    Poco::ScopedLock<Poco::FastMutex> lock(pSource->_timeShiftLock);
+    return _pTimeShift;
+}
+
+
+void
+Service::setStreamTarget(StreamTarget* pTarget)
+{
+    _pNextStreamTarget = pTarget;
+}
+
+
+Poco::UInt64
+Service::getPacketsDropped()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_serviceLock);
+    return _packetsDropped;
+}
+
+
+unsigned int
+Service::getQueuedPackets()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_serviceLock);
+    return _packetQueue.size();
+}
+
+
+void
+Service::setStreamSelection(unsigned int selection)
+{
+    _nextSelection = selection;
+}
+
+
+void
+Service::setPacing(bool pacing)
+{
+    _pacing = pacing;
+}
+
+
 void
 Service::stopStream()
 {
     if (_pIStream) {
         _pIStream->stop();
     }
+    _byteQueue.close();
+    // a service is only stopped together with all of its outputs, so all readers of the shared ring get the end of the stream
+    TimeShift* pTimeShift = getTimeShift();
+    if (pTimeShift) {
+        pTimeShift->stop();
+    }
+}
+
+
+bool
+Service::isClone()
+{
+    return _clone;
 }
 
 
@@ -498,6 +756,8 @@ Service::flush()
         }
         _packetQueue.pop();
     }
+    clearStartCache();
+    _startCacheQueued = false;
     _serviceLock.unlock();
     LOG(dvb, debug, "flush count bytes from service byte queue: " + Poco::NumberFormatter::format(_byteQueue.size()));
     _byteQueue.clear();
@@ -511,6 +771,15 @@ Service::queueTsPacket(TransportStreamPacket* pPacket)
     Poco::ScopedLock<Poco::FastMutex> queueLock(_serviceLock);
 //    LOG(dvb, debug, "queue packet to service " + _name + std::string(_clone ? "(clone)" : ""));
 
+    if (!_clone) {
+        cacheTsPacket(pPacket);
+    }
+    else if (!_startCacheQueued) {
+        _startCacheQueued = true;
+        if (queueStartCache(pPacket)) {
+            return;
+        }
+    }
     if (_packetQueue.size() < _packetQueueSize) {
 //        LOG(dvb, trace, "service queue, queue packet");
         pPacket->incRefCounter();
@@ -519,6 +788,7 @@ Service::queueTsPacket(TransportStreamPacket* pPacket)
     }
     else {
         LOG(dvb, error, "service queue full, discard packet.");
+        _packetsDropped++;
         pPacket->decRefCounter();
     }
 }
@@ -530,6 +800,15 @@ Service::startQueueThread()
     LOG(dvb, debug, "start service queue thread ...");
 
     if (!_pQueueThread) {
+        // audio frames can be decoded from any PES start, video only from a random access point
+        Stream* pAudio = getFirstAudioStream();
+        _randomAccessPid = (isAudio() && pAudio) ? pAudio->getPid() : 0x1fff;
+        _byteQueue.open();
+        Service* pSource = _pOrigin ? _pOrigin : this;
+        pSource->_timeShiftLock.lock();
+        // the output is discarded until openTimeShift() attaches the ring
+        _timeShiftPending = (_timeShiftMinutes && !_timeShiftDirectory.empty());
+        pSource->_timeShiftLock.unlock();
         _queueThreadRunning = true;
         _pQueueThread = new Poco::Thread;
         _pQueueThread->start(_queueThreadRunnable);
@@ -561,6 +840,467 @@ Service::waitForStopQueueThread()
         delete _pQueueThread;
         _pQueueThread = 0;
     }
+    closeTimeShift();
+}
+
+
+void
+Service::cacheTsPacket(TransportStreamPacket* pPacket)
+{
+    Poco::UInt16 pid = pPacket->getPacketIdentifier();
+    if (pid == _pmtPid) {
+        assemblePmt(pPacket);
+        return;
+    }
+
+    if (pPacket->getPayloadUnitStartIndicator() && (pid == _randomAccessPid || pPacket->getRandomAccessIndicator())) {
+        for (std::deque<TransportStreamPacket*>::iterator it = _startCache.begin(); it != _startCache.end(); ++it) {
+            (*it)->decRefCounter();
+        }
+        _startCache.clear();
+        _startCacheValid = true;
+    }
+    if (!_startCacheValid) {
+        return;
+    }
+    if (_startCache.size() >= _startCacheSize) {
+        // random access points are too far apart (or not signaled at all), drop the oldest
+        // packets so that joining readers still get the most recent part of the picture group
+        TransportStreamPacket* pOldest = _startCache.front();
+        if (pOldest->getPayloadUnitStartIndicator() && (pOldest->getPacketIdentifier() == _randomAccessPid || pOldest->getRandomAccessIndicator())) {
+            LOG(dvb, debug, "service " + _name + " start cache overflow, dropping packets since last random access point");
+        }
+        pOldest->decRefCounter();
+        _startCache.pop_front();
+    }
+    pPacket->incRefCounter();
+    _startCache.push_back(pPacket);
+}
+
+
+bool
+Service::queueStartCache(TransportStreamPacket* pPacket)
+{
+    // the original service is queued before its clones in the remux, so its cache
+    // already ends with the packet that is queued to the clone right now
+    if (!_pOrigin) {
+        return false;
+    }
+    Poco::ScopedLock<Poco::FastMutex> originLock(_pOrigin->_serviceLock);
+    if (!_pOrigin->_startCacheValid) {
+        return false;
+    }
+    bool queued = false;
+    for (std::deque<TransportStreamPacket*>::iterator it = _pOrigin->_startCache.begin(); it != _pOrigin->_startCache.end(); ++it) {
+        (*it)->incRefCounter();
+        _packetQueue.push(*it);
+        queued = queued || (*it == pPacket);
+    }
+    LOG(dvb, debug, "service " + _name + " (clone) starts with " + Poco::NumberFormatter::format(_packetQueue.size()) + " cached packets");
+    _queueReadCondition.broadcast();
+    return queued;
+}
+
+
+void
+Service::clearStartCache()
+{
+    for (std::deque<TransportStreamPacket*>::iterator it = _startCache.begin(); it != _startCache.end(); ++it) {
+        (*it)->decRefCounter();
+    }
+    _startCache.clear();
+    _startCacheValid = false;
+}
+
+
+void
+Service::assemblePmt(TransportStreamPacket* pPacket)
+{
+    int offset = pPacket->getPayloadOffset();
+    if (offset >= TransportStreamPacket::Size) {
+        return;
+    }
+    Poco::UInt8* pPayload = (Poco::UInt8*)pPacket->getData(offset);
+    Poco::UInt8* pEnd = (Poco::UInt8*)pPacket->getData(TransportStreamPacket::Size);
+    if (pPacket->getPayloadUnitStartIndicator()) {
+        // skip pointer field
+        pPayload += 1 + *pPayload;
+        _pmtSection.clear();
+    }
+    else if (_pmtSection.empty()) {
+        return;
+    }
+    if (pPayload >= pEnd) {
+        return;
+    }
+    _pmtSection.insert(_pmtSection.end(), pPayload, pEnd);
+    if (_pmtSection.size() < 3) {
+        return;
+    }
+    unsigned int sectionSize = (((_pmtSection[1] & 0x0f) << 8) | _pmtSection[2]) + 3;
+    if (_pmtSection.size() < sectionSize) {
+        return;
+    }
+    _pmtSection.resize(sectionSize);
+    packetizePmt();
+    _pmtSection.clear();
+}
+
+
+void
+Service::packetizePmt()
+{
+    std::vector<Poco::UInt8> pmtPackets;
+    int streamCount = rewritePmt(_pmtSection, pmtPackets, false);
+    if (streamCount < 0) {
+        return;
+    }
+    if (pmtPackets != _pmtPackets) {
+        LOG(dvb, debug, "service " + _name + " new PMT with " + Poco::NumberFormatter::format(streamCount) + " streams, version "
+                + Poco::NumberFormatter::format((_pmtSection[5] >> 1) & 0x1f));
+        _pmtPackets.swap(pmtPackets);
+        _pmtBroadcastSection = _pmtSection;
+        _pmtPacketsVersion++;
+    }
+}
+
+
+int
+Service::rewritePmt(const std::vector<Poco::UInt8>& pmtSection, std::vector<Poco::UInt8>& pmtPackets, bool selectedOnly)
+{
+    if (pmtSection.size() < 16 || pmtSection.size() > 1024 || pmtSection[0] != 0x02) {
+        return -1;
+    }
+    const Poco::UInt8* pSection = &pmtSection[0];
+    PmtSection singlePmt(_pmtPid);
+    singlePmt.setData(0, pmtSection.size(), (void*)pSection);
+    singlePmt.setLength(pmtSection.size() - 3);
+    singlePmt.setCrc();
+    if (::memcmp(singlePmt.getData(pmtSection.size() - 4), pSection + pmtSection.size() - 4, 4)) {
+        LOG(dvb, warning, "service " + _name + " PMT with wrong crc, ignored");
+        return -1;
+    }
+
+    // keep header and program info, then copy the elementary streams that are forwarded to the reader
+    unsigned int size = 12 + (((pSection[10] & 0x0f) << 8) | pSection[11]);
+    unsigned int streamsEnd = pmtSection.size() - 4;
+    int streamCount = 0;
+    unsigned int offset = size;
+    while (offset + 5 <= streamsEnd) {
+        Poco::UInt16 pid = ((pSection[offset + 1] & 0x1f) << 8) | pSection[offset + 2];
+        unsigned int streamSize = 5 + (((pSection[offset + 3] & 0x0f) << 8) | pSection[offset + 4]);
+        if (offset + streamSize > streamsEnd) {
+            break;
+        }
+        if (hasPacketIdentifier(pid) && (!selectedOnly || _selectedPids.find(pid) != _selectedPids.end())) {
+            singlePmt.setData(size, streamSize, (void*)(pSection + offset));
+            size += streamSize;
+            streamCount++;
+        }
+        offset += streamSize;
+    }
+    singlePmt.setLength(size + 4 - 3);
+    singlePmt.setCrc();
+
+    pmtPackets.clear();
+    TransportStreamPacket packet;
+    unsigned int sectionOffset = 0;
+    while (sectionOffset < singlePmt.size()) {
+        bool first = (sectionOffset == 0);
+        packet.clearPayload();
+        packet.setTransportErrorIndicator(false);
+        packet.setPayloadUnitStartIndicator(first);
+        packet.setTransportPriority(false);
+        packet.setPacketIdentifier(_pmtPid);
+        packet.setScramblingControl(TransportStreamPacket::ScrambledNone);
+        packet.setAdaptionFieldExists(TransportStreamPacket::AdaptionFieldPayloadOnly);
+        unsigned int payloadOffset = TransportStreamPacket::HeaderSize;
+        if (first) {
+            packet.setPointerField(0x00);
+            payloadOffset++;
+        }
+        unsigned int chunk = std::min<unsigned int>(singlePmt.size() - sectionOffset, TransportStreamPacket::Size - payloadOffset);
+        packet.setData(payloadOffset, chunk, singlePmt.getData(sectionOffset));
+        sectionOffset += chunk;
+        Poco::UInt8* pData = (Poco::UInt8*)packet.getData();
+        pmtPackets.insert(pmtPackets.end(), pData, pData + TransportStreamPacket::Size);
+    }
+    return streamCount;
+}
+
+
+bool
+Service::getPmtPackets(std::vector<Poco::UInt8>& pmtPackets, unsigned int& version)
+{
+    Service* pSource = _pOrigin ? _pOrigin : this;
+    Poco::ScopedLock<Poco::FastMutex> lock(pSource->_serviceLock);
+    if (pSource->_pmtPacketsVersion == version) {
+        return false;
+    }
+    if (_selection == SelectAll) {
+        pmtPackets = pSource->_pmtPackets;
+    }
+    else {
+        // readers with a selection of streams get a PMT that only lists the selected streams
+        rewritePmt(pSource->_pmtBroadcastSection, pmtPackets, true);
+    }
+    version = pSource->_pmtPacketsVersion;
+    return true;
+}
+
+
+void
+Service::selectStreams()
+{
+    _selection = _nextSelection;
+    _selectedPids.clear();
+    _pcrOnlyPid = InvalidPcrPid;
+    if (_selection == SelectAll) {
+        return;
+    }
+    for (std::vector<Stream*>::iterator it = _streams.begin(); it != _streams.end(); ++it) {
+        bool video = (*it)->isVideo();
+        bool audio = (*it)->isAudio();
+        if ((video && (_selection & SelectVideo)) || (audio && (_selection & SelectAudio))
+                || (!video && !audio && (_selection & SelectOther))) {
+            _selectedPids.insert((*it)->getPid());
+        }
+    }
+    // decoders need the clock, even if it's carried in a stream that is not selected
+    if (_pcrPid != InvalidPcrPid && _selectedPids.find(_pcrPid) == _selectedPids.end()) {
+        _pcrOnlyPid = _pcrPid;
+    }
+    if (_selection & SelectElementary) {
+        // first selected audio stream, or the first video stream if there is no audio
+        unsigned int types = _selection & (SelectVideo | SelectAudio);
+        Stream* pStream = 0;
+        for (std::vector<Stream*>::iterator it = _streams.begin(); it != _streams.end(); ++it) {
+            bool audio = (*it)->isAudio();
+            if (((audio && (!types || (types & SelectAudio))) || ((*it)->isVideo() && (!types || (types & SelectVideo))))
+                    && (!pStream || (audio && !pStream->isAudio()))) {
+                pStream = *it;
+            }
+        }
+        _elementaryStream.reset(pStream ? pStream->getPid() : TransportStreamPacket::NullPacketIdentifier);
+    }
+}
+
+
+void
+Service::resetPsi()
+{
+    selectStreams();
+    _packetCounter = 0;
+    _psiTime = 0;
+    _psiPmtPackets.clear();
+    _psiPmtPacketsVersion = 0;
+    _patCounter = 0;
+    _pmtCounter = 0;
+}
+
+
+void
+Service::writePacket(TransportStreamPacket* pPacket)
+{
+    if (_selection & SelectElementary) {
+        const Poco::UInt8* pData;
+        unsigned int size = _elementaryStream.extract((const Poco::UInt8*)pPacket->getData(), pData);
+        if (size) {
+            _packetCounter++;
+            writeStream((const char*)pData, size);
+        }
+        return;
+    }
+    Poco::UInt16 pid = pPacket->getPacketIdentifier();
+    const Poco::UInt8* pData = (const Poco::UInt8*)pPacket->getData();
+    Poco::UInt8 pcrPacket[TransportStreamPacket::Size];
+    if (pid == _pcrOnlyPid) {
+        // the stream that carries the PCR is not selected, only forward its adaptation field with the PCR
+        Poco::UInt64 pcr;
+        if (!TransportStreamPacket::getPcr(pData, pcr) || pData[4] >= TransportStreamPacket::PayloadSize) {
+            return;
+        }
+        unsigned int adaptationFieldSize = 1 + pData[4];
+        ::memcpy(pcrPacket, pData, TransportStreamPacket::HeaderSize + adaptationFieldSize);
+        ::memset(pcrPacket + TransportStreamPacket::HeaderSize + adaptationFieldSize, 0xff,
+                TransportStreamPacket::PayloadSize - adaptationFieldSize);
+        // no payload unit start, adaptation field only and the continuity counter doesn't count without payload
+        pcrPacket[1] &= ~0x40;
+        pcrPacket[3] = (pcrPacket[3] & 0xc0) | 0x20;
+        pcrPacket[4] = TransportStreamPacket::PayloadSize - 1;
+        pData = pcrPacket;
+    }
+    else if (pid == TransportStreamPacket::NullPacketIdentifier
+            || (_selection != SelectAll && pid != _pmtPid && _selectedPids.find(pid) == _selectedPids.end())) {
+        return;
+    }
+    _packetCounter++;
+    bool pmtPacket = (pid == _pmtPid);
+    // a new PMT version is sent right away, otherwise PSI has 15,000 bps, that's 9 PAT packets per second (let's make 10)
+    bool pmtChanged = pmtPacket && getPmtPackets(_psiPmtPackets, _psiPmtPacketsVersion);
+    if (pmtChanged || _psiTime.isElapsed((Poco::Timestamp::TimeDiff)_psiInterval * 1000)) {
+        if (_packetCounter == 1) {
+            getPmtPackets(_psiPmtPackets, _psiPmtPacketsVersion);
+        }
+        writePsi(_psiPmtPackets, _patCounter, _pmtCounter);
+        _psiTime.update();
+    }
+    if (!pmtPacket || _psiPmtPackets.empty()) {
+        writeStream((const char*)pData, TransportStreamPacket::Size);
+    }
+}
+
+
+void
+Service::writePsi(std::vector<Poco::UInt8>& pmtPackets, Poco::UInt8& patCounter, Poco::UInt8& pmtCounter)
+{
+    _pPatTsPacket->setContinuityCounter(patCounter);
+    patCounter = (patCounter + 1) % 16;
+    writeStream((char*)_pPatTsPacket->getData(), TransportStreamPacket::Size);
+
+    for (unsigned int offset = 0; offset < pmtPackets.size(); offset += TransportStreamPacket::Size) {
+        pmtPackets[offset + 3] = (pmtPackets[offset + 3] & 0xf0) | pmtCounter;
+        pmtCounter = (pmtCounter + 1) % 16;
+        writeStream((char*)&pmtPackets[offset], TransportStreamPacket::Size);
+    }
+}
+
+
+void
+Service::writeStream(const char* pData, int size)
+{
+    if (_pStreamTarget) {
+        _pStreamTarget->write(pData, size);
+    }
+    else {
+        Service* pSource = _pOrigin ? _pOrigin : this;
+        pSource->_timeShiftLock.lock();
+        // one output writes the shared ring, another one takes over when it stops
+        if (_pTimeShift && !pSource->_pTimeShiftWriter) {
+            pSource->_pTimeShiftWriter = this;
+        }
+        bool writeRing = (_pTimeShift && pSource->_pTimeShiftWriter == this);
+        bool writeQueue = (!_pTimeShift && !_timeShiftPending);
+        pSource->_timeShiftLock.unlock();
+        if (writeRing) {
+            // the ring never blocks, so a paused reader doesn't stall the queue
+            _pTimeShift->write(pData, size);
+        }
+        else if (writeQueue) {
+            _byteQueue.write(pData, size);
+        }
+    }
+}
+
+
+void
+Service::pacePacket(TransportStreamPacket* pPacket)
+{
+    Poco::UInt64 pcr;
+    if (pPacket->getPacketIdentifier() == _pcrPid && TransportStreamPacket::getPcr((Poco::UInt8*)pPacket->getData(), pcr)) {
+        releasePacedPackets(_pacedPcrValid, pcr);
+        _pacedPcr = pcr;
+        _pacedPcrValid = true;
+    }
+    else if (_pacedPackets.size() >= _pacedPacketsSize) {
+        // no PCR for too long, write without pacing until the next PCR
+        releasePacedPackets(false, 0);
+        _pacedPcrValid = false;
+    }
+    _pacedPackets.push_back(pPacket);
+}
+
+
+void
+Service::releasePacedPackets(bool paced, Poco::UInt64 pcrEnd)
+{
+    Poco::Timestamp start;
+    Poco::Timestamp::TimeDiff duration = 0;
+    if (paced) {
+        _serviceLock.lock();
+        // a backlog, like the start cache queued for a joining reader, is written right away
+        bool backlog = (_packetQueue.size() > _pacingBacklog);
+        _serviceLock.unlock();
+        duration = PcrClock::interval(_pacedPcr, pcrEnd);
+        if (backlog || duration > PcrClock::MaxInterval) {
+            duration = 0;
+            _pcrClock.reset();
+        }
+        else {
+            start = _pcrClock.departure(_pacedPcr);
+        }
+    }
+    unsigned int count = _pacedPackets.size();
+    for (unsigned int i = 0; i < count; i++) {
+        Poco::Timestamp departure = start + duration * i / count;
+        Poco::Timestamp::TimeDiff wait;
+        // sleep in short steps, so that stopping the queue thread isn't delayed
+        while ((wait = departure - Poco::Timestamp()) >= 1000 && queueThreadRunning()) {
+            Poco::Thread::sleep(std::min(wait / 1000, (Poco::Timestamp::TimeDiff)_packetQueueTimeout / 2));
+        }
+        writePacket(_pacedPackets[i]);
+        _pacedPackets[i]->decRefCounter();
+    }
+    _pacedPackets.clear();
+}
+
+
+void
+Service::openTimeShift()
+{
+    Service* pSource = _pOrigin ? _pOrigin : this;
+    pSource->_timeShiftLock.lock();
+    bool allocate = (_timeShiftPending && !pSource->_pSharedTimeShift);
+    pSource->_timeShiftLock.unlock();
+
+    TimeShift* pTimeShift = 0;
+    if (allocate) {
+        Poco::UInt64 bitrate = isAudio() ? TimeShift::AudioBitrate : TimeShift::VideoBitrate;
+        pTimeShift = new TimeShift;
+        if (!pTimeShift->open(_timeShiftDirectory, (Poco::UInt64)_timeShiftMinutes * 60 * bitrate / 8)) {
+            delete pTimeShift;
+            pTimeShift = 0;
+        }
+    }
+
+    Poco::ScopedLock<Poco::FastMutex> lock(pSource->_timeShiftLock);
+    // the output may have been stopped in the meantime, or another output allocated the ring first
+    if (!_timeShiftPending || pSource->_pSharedTimeShift) {
+        delete pTimeShift;
+    }
+    else {
+        pSource->_pSharedTimeShift = pTimeShift;
+    }
+    if (!_timeShiftPending) {
+        return;
+    }
+    _timeShiftPending = false;
+    if (!pSource->_pSharedTimeShift) {
+        LOG(dvb, error, "service " + _name + " runs without time-shift");
+        return;
+    }
+    _pTimeShift = pSource->_pSharedTimeShift;
+    pSource->_timeShiftOutputs++;
+}
+
+
+void
+Service::closeTimeShift()
+{
+    Service* pSource = _pOrigin ? _pOrigin : this;
+    Poco::ScopedLock<Poco::FastMutex> lock(pSource->_timeShiftLock);
+    _timeShiftPending = false;
+    if (!_pTimeShift) {
+        return;
+    }
+    _pTimeShift = 0;
+    if (pSource->_pTimeShiftWriter == this) {
+        pSource->_pTimeShiftWriter = 0;
+    }
+    if (--pSource->_timeShiftOutputs == 0) {
+        delete pSource->_pSharedTimeShift;
+        pSource->_pSharedTimeShift = 0;
+    }
 }
 
 
@@ -578,8 +1318,11 @@ Service::queueThread()
     LOG(dvb, debug, "service queue thread started.");
 
     Poco::Timestamp t;
-    long unsigned int tsPacketCounter = 0;
-    Poco::UInt8 continuityCounter = 0;
+    resetPsi();
+    // the time-shift ring is read at the pace of the reader anyway
+    bool pacing = _pacing && !_timeShiftMinutes;
+    _pacedPcrValid = false;
+    _pcrClock.reset();
 
     while (queueThreadRunning()) {
         _serviceLock.lock();
@@ -595,27 +1338,28 @@ Service::queueThread()
             // null packet means end of stream
             break;
         }
-        tsPacketCounter++;
        LOG(dvb, information, "service " + _name + std::string(_clone ? "(clone)" : "")
-               + " write packet no: " + Poco::NumberFormatter::format(tsPacketCounter)
+               + " write packet no: " + Poco::NumberFormatter::format(_packetCounter + 1)
                + ", queue size: " + Poco::NumberFormatter::format(_packetQueue.size())
                + ", pid: " + Poco::NumberFormatter::format(pPacket->getPacketIdentifier()));
 
-        if (!(tsPacketCounter & 0x7f)) {
-//        if (t.elapsed() % 100000 == 0) { // PAT has 15,000 bps, that's 9 PAT packets per second (let's make 10)
-            // inject PAT packet
-            _pPatTsPacket->setContinuityCounter(continuityCounter);
-            continuityCounter++;
-            continuityCounter %= 16;
-            _byteQueue.write((char*)_pPatTsPacket->getData(), TransportStreamPacket::Size);
+        if (pacing) {
+            pacePacket(pPacket);
         }
-        _byteQueue.write((char*)pPacket->getData(), TransportStreamPacket::Size);
-        pPacket->decRefCounter();
+        else {
+            writePacket(pPacket);
+            pPacket->decRefCounter();
+        }
+    }
+    // the service is stopped, the reader doesn't want the rest
+    for (std::vector<TransportStreamPacket*>::iterator it = _pacedPackets.begin(); it != _pacedPackets.end(); ++it) {
+        (*it)->decRefCounter();
     }
+    _pacedPackets.clear();
 
-    LOG(dvb, information, "service " + _name + " received " + Poco::NumberFormatter::format(tsPacketCounter) + " TS packets in "
+    LOG(dvb, information, "service " + _name + " received " + Poco::NumberFormatter::format(_packetCounter) + " TS packets in "
             + Poco::NumberFormatter::format(t.elapsed() / 1000) + " msec ("
-            + Poco::NumberFormatter::format((float)tsPacketCounter * 1000 / t.elapsed(), 2) + " packets/msec)");
+            + Poco::NumberFormatter::format((float)_packetCounter * 1000 / t.elapsed(), 2) + " packets/msec)");
     LOG(dvb, debug, "service queue thread finished.");
 }
 
@@ -13,6 +13,7 @@
 #ifndef Service_INCLUDED
 #define Service_INCLUDED
 
+#include <deque>
 #include <queue>
 #include <stack>
 
@@ -31,10 +32,13 @@
 #include <Poco/DOM/AutoPtr.h>
 #include <Poco/DOM/DocumentFragment.h>
 #include <Poco/Thread.h>
+#include <Poco/Timestamp.h>
 #include <Poco/Mutex.h>
 #include <Poco/Condition.h>
 
 #include "AvStream.h"
+#include "TransportStream.h"
+#include "ElementaryStream.h"
 
 namespace Omm {
 namespace Dvb {
@@ -44,6 +48,10 @@ class Stream;
 class PatSection;
 class TransportStreamPacket;
 class ByteQueueIStream;
+class ChannelDbReader;
+class ChannelDbWriter;
+class TimeShift;
+class StreamTarget;
 
 class Service
 {
@@ -51,41 +59,62 @@ class Service
     friend class Frontend;
     friend class Demux;
     friend class Remux;
+    friend class Splitter;
 
 public:
-    static const std::string TypeDigitalTelevision;
-    static const std::string TypeDigitalRadioSound;
-    static const std::string TypeTeletext;
-    static const std::string TypeNvodReference;
-    static const std::string TypeNodTimeShifted;
-    static const std::string TypeMosaic;
-    static const std::string TypeFmRadio;
-    static const std::string TypeDvbSrm;
-    static const std::string TypeAdvancedCodecDigitalRadioSound;
-    static const std::string TypeAdvancedCodecMosaic;
-    static const std::string TypeDataBroadcastService;
-    static const std::string TypeRcsMap;
-    static const std::string TypeRcsFls;
-    static const std::string TypeDvbMhp;
-    static const std::string TypeMpeg2HdDigitalTelevision;
-    static const std::string TypeAdvancedCodecSdDigitalTelevision;
-    static const std::string TypeAdvancedCodecSdNvodTimeShifted;
-    static const std::string TypeAdvancedCodecSdNvodReference;
-    static const std::string TypeAdvancedCodecHdDigitalTelevision;
-    static const std::string TypeAdvancedCodecHdNvodTimeShifted;
-    static const std::string TypeAdvancedCodecHdNvodReference;
-    static const std::string TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision;
-    static const std::string TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted;
-    static const std::string TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference;
+    enum Type
+    /// service_type of the service descriptor
+    {
+        TypeUndefined = 0x00,
+        TypeDigitalTelevision = 0x01,
+        TypeDigitalRadioSound = 0x02,
+        TypeTeletext = 0x03,
+        TypeNvodReference = 0x04,
+        TypeNodTimeShifted = 0x05,
+        TypeMosaic = 0x06,
+        TypeFmRadio = 0x07,
+        TypeDvbSrm = 0x08,
+        TypeAdvancedCodecDigitalRadioSound = 0x0A,
+        TypeAdvancedCodecMosaic = 0x0B,
+        TypeDataBroadcastService = 0x0C,
+        TypeRcsMap = 0x0E,
+        TypeRcsFls = 0x0F,
+        TypeDvbMhp = 0x10,
+        TypeMpeg2HdDigitalTelevision = 0x11,
+        TypeAdvancedCodecSdDigitalTelevision = 0x16,
+        TypeAdvancedCodecSdNvodTimeShifted = 0x17,
+        TypeAdvancedCodecSdNvodReference = 0x18,
+        TypeAdvancedCodecHdDigitalTelevision = 0x19,
+        TypeAdvancedCodecHdNvodTimeShifted = 0x1A,
+        TypeAdvancedCodecHdNvodReference = 0x1B,
+        TypeAdvancedCodecFrameCompatiblePlanoStereoscopicHdTelevision = 0x1C,
+        TypeAdvancedCodecFrameCompatiblePlanoStereoscopicTimeShifted = 0x1D,
+        TypeAdvancedCodecFrameCompatiblePlanoStereoscopicReference = 0x1E
+    };
 
-    static const unsigned int InvalidPcrPid;
+    enum Status
+    /// running_status of the service description table
+    {
+        StatusUndefined = 0x00,
+        StatusNotRunning = 0x01,
+        StatusStartsShortly = 0x02,
+        StatusPausing = 0x03,
+        StatusRunning = 0x04,
+        StatusOffAir = 0x05
+    };
+
+    enum Selection
+    /// streams forwarded to the reader, SelectAll or any combination of the other flags
+    {
+        SelectAll = 0x00,
+        SelectVideo = 0x01,
+        SelectAudio = 0x02,
+        SelectOther = 0x04,
+        SelectElementary = 0x08
+        /// instead of a TS, the payload of the first selected audio (or video) stream without PES headers
+    };
 
-    static const std::string StatusUndefined;
-    static const std::string StatusNotRunning;
-    static const std::string StatusStartsShortly;
-    static const std::string StatusPausing;
-    static const std::string StatusRunning;
-    static const std::string StatusOffAir;
+    static const unsigned int InvalidPcrPid;
 
     Service(Transponder* pTransponder, const std::string& name, unsigned int sid, unsigned int pmtid);
     Service(const Service& service);
@@ -94,16 +123,23 @@ public:
     void addStream(Stream* pStream);
     void readXml(Poco::XML::Node* pXmlService);
     void writeXml(Poco::XML::Element* pTransponder);
+    void readDb(ChannelDbReader& db);
+    void writeDb(ChannelDbWriter& db);
 
-    std::string getType();
-    static std::string typeToString(Poco::UInt8 status);
+    Type getType();
+    static std::string typeToString(Poco::UInt8 type);
+    static Poco::UInt8 typeFromString(const std::string& val);
     static std::string statusToString(Poco::UInt8 status);
+    static Poco::UInt8 statusFromString(const std::string& val);
+    /// string conversion is only needed for the xml description and for logging
 
     bool isAudio();
     bool isSdVideo();
     bool isHdVideo();
     std::string getName();
-    std::string getStatus();
+    unsigned int getServiceId();
+    unsigned int getPcrPid();
+    Status getStatus();
     bool getScrambled();
     Transponder* getTransponder();
     Stream* getFirstAudioStream();
@@ -112,7 +148,32 @@ public:
 
     std::istream* getStream();
     AvStream::ByteQueue* getByteQueue();
+    void setTimeShift(const std::string& directory, unsigned int minutes);
+    /// the queue thread writes into a time-shift ring of the last minutes instead of the byte queue,
+    /// minutes = 0 disables time-shift. Takes effect on the next start of the queue thread.
+    void openTimeShift();
+    /// attach the running output to the ring of the service on the transponder, which is shared by all of its clones.
+    /// The first output allocates the ring, so this is called without holding the device lock. Until then the output
+    /// is discarded, if the ring can't be allocated the output falls back to the byte queue.
+    TimeShift* getTimeShift();
+    /// 0 if the service is not running with time-shift
+    void setStreamTarget(StreamTarget* pTarget);
+    /// the service is split from the multiplex into pTarget by the remux thread instead of
+    /// running a queue thread, 0 disables splitting. Takes effect on the next start of the service.
+    Poco::UInt64 getPacketsDropped();
+    /// packets discarded because the queue thread didn't keep up
+    unsigned int getQueuedPackets();
+    /// packets waiting for the queue thread
+    void setStreamSelection(unsigned int selection);
+    /// the output of the service only carries the selected streams and a PMT that lists only them, the PCR of an unselected
+    /// stream is kept in packets without payload. Unselected and null packets are dropped. Takes effect on the next start of the output.
+    void setPacing(bool pacing);
+    /// the queue thread releases packets into the byte queue at the rate given by the PCR instead
+    /// of in bursts as they arrive from the DVR. Takes effect on the next start of the queue thread.
     void stopStream();
+    /// readers of the byte queue and the stream get the end of the stream
+    bool isClone();
+    /// clones are deleted when they stop, the service on the transponder is kept
     void flush();
     void queueTsPacket(TransportStreamPacket* pPacket);
     void startQueueThread();
@@ -122,16 +183,41 @@ public:
 private:
     void queueThread();
     bool queueThreadRunning();
+    void cacheTsPacket(TransportStreamPacket* pPacket);
+    bool queueStartCache(TransportStreamPacket* pPacket);
+    /// queue start cache of the original service in front of pPacket,
+    /// returns true if pPacket is already part of the queued cache
+    void clearStartCache();
+    void assemblePmt(TransportStreamPacket* pPacket);
+    void packetizePmt();
+    /// single program PMT with the streams of this service only, split into TS packets
+    int rewritePmt(const std::vector<Poco::UInt8>& pmtSection, std::vector<Poco::UInt8>& pmtPackets, bool selectedOnly);
+    /// packetize the broadcast pmtSection with the streams of this service (and only the selected ones),
+    /// returns the number of streams or -1 if pmtSection is invalid
+    bool getPmtPackets(std::vector<Poco::UInt8>& pmtPackets, unsigned int& version);
+    /// copy PMT packets of the original service, if their version differs from version
+    void selectStreams();
+    void resetPsi();
+    void writePacket(TransportStreamPacket* pPacket);
+    /// write pPacket into the output of this service and inject PAT and PMT when they are due
+    void writePsi(std::vector<Poco::UInt8>& pmtPackets, Poco::UInt8& patCounter, Poco::UInt8& pmtCounter);
+    void writeStream(const char* pData, int size);
+    void pacePacket(TransportStreamPacket* pPacket);
+    void releasePacedPackets(bool paced, Poco::UInt64 pcrEnd);
+    /// write the packets since the last PCR spread over the interval up to pcrEnd
+    void closeTimeShift();
+    /// the last output of the service frees the ring
 
     bool                                _clone;
+    Service*                            _pOrigin;
     Transponder*                        _pTransponder;
-    std::string                         _type;
+    Poco::UInt8                         _type;
     std::string                         _providerName;
     std::string                         _name;
     unsigned int                        _sid;
     unsigned int                        _pmtPid;
     unsigned int                        _pcrPid;
-    std::string                         _status;
+    Poco::UInt8                         _status;
     bool                                _scrambled;
 
     std::vector<Stream*>                _streams;
@@ -145,11 +231,64 @@ private:
     std::queue<TransportStreamPacket*>  _packetQueue;
     const int                           _packetQueueTimeout;
     const int                           _packetQueueSize;
+    Poco::UInt64                        _packetsDropped;
     Poco::Thread*                       _pQueueThread;
     Poco::RunnableAdapter<Service>      _queueThreadRunnable;
     bool                                _queueThreadRunning;
     Poco::Condition                     _queueReadCondition;
     Poco::FastMutex                     _serviceLock;
+
+    // ring of the packets since the last random access point, so that readers
+    // joining a running service can start decoding right away
+    std::deque<TransportStreamPacket*>  _startCache;
+    bool                                _startCacheValid;
+    const int                           _startCacheSize;
+    Poco::UInt16                        _randomAccessPid;
+    bool                                _startCacheQueued;
+
+    // readers drop the PMT of the broadcast and inject PAT and the rewritten PMT
+    // every _psiInterval msec with their own continuity counters
+    std::vector<Poco::UInt8>            _pmtSection;
+    std::vector<Poco::UInt8>            _pmtPackets;
+    std::vector<Poco::UInt8>            _pmtBroadcastSection;
+    unsigned int                        _pmtPacketsVersion;
+    const int                           _psiInterval;
+
+    // all outputs of a service read the same ring, it's owned by the service on the transponder,
+    // where _timeShiftLock guards the ring, its outputs and the one of them that writes it
+    std::string                         _timeShiftDirectory;
+    unsigned int                        _timeShiftMinutes;
+    bool                                _timeShiftPending;
+    TimeShift*                          _pTimeShift;
+    TimeShift*                          _pSharedTimeShift;
+    unsigned int                        _timeShiftOutputs;
+    Service*                            _pTimeShiftWriter;
+    Poco::FastMutex                     _timeShiftLock;
+    StreamTarget*                       _pNextStreamTarget;
+    StreamTarget*                       _pStreamTarget;
+    unsigned int                        _nextSelection;
+    unsigned int                        _selection;
+    std::set<Poco::UInt16>              _selectedPids;
+    unsigned int                        _pcrOnlyPid;
+    ElementaryStreamExtractor           _elementaryStream;
+
+    // packets since the last PCR wait in the queue thread until the next PCR tells their departure time
+    bool                                _pacing;
+    std::vector<TransportStreamPacket*> _pacedPackets;
+    Poco::UInt64                        _pacedPcr;
+    bool                                _pacedPcrValid;
+    PcrClock                            _pcrClock;
+    const unsigned int                  _pacedPacketsSize;
+    const unsigned int                  _pacingBacklog;
+
+    // output state of the queue thread or the splitter, PSI is injected before the first
+    // packet and then every _psiInterval msec, independent of the bitrate
+    long unsigned int                   _packetCounter;
+    Poco::Timestamp                     _psiTime;
+    std::vector<Poco::UInt8>            _psiPmtPackets;
+    unsigned int                        _psiPmtPacketsVersion;
+    Poco::UInt8                         _patCounter;
+    Poco::UInt8                         _pmtCounter;
 };
 
 }  // namespace Omm
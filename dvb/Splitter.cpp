@@ -0,0 +1,90 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "Log.h"
+#include "TransportStream.h"
+#include "Service.h"
+#include "Splitter.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+void
+Splitter::addService(Service* pService)
+{
+    LOG(dvb, debug, "splitter add service " + pService->getName());
+
+    pService->_pStreamTarget = pService->_pNextStreamTarget;
+    pService->resetPsi();
+    _services.push_back(pService);
+    indexServices();
+}
+
+
+bool
+Splitter::delService(Service* pService)
+{
+    std::vector<Service*>::iterator it = std::find(_services.begin(), _services.end(), pService);
+    if (it == _services.end()) {
+        return false;
+    }
+    LOG(dvb, debug, "splitter del service " + pService->getName());
+
+    _services.erase(it);
+    indexServices();
+    pService->_pStreamTarget = 0;
+    return true;
+}
+
+
+bool
+Splitter::hasServices()
+{
+    return !_services.empty();
+}
+
+
+void
+Splitter::splitPacket(TransportStreamPacket* pPacket)
+{
+    std::unordered_map<Poco::UInt16, std::vector<Service*> >::iterator it = _pidIndex.find(pPacket->getPacketIdentifier());
+    if (it == _pidIndex.end()) {
+        return;
+    }
+    for (std::vector<Service*>::iterator sit = it->second.begin(); sit != it->second.end(); ++sit) {
+        // outputs have no original service that caches the PMT, so each one assembles its own
+        if (pPacket->getPacketIdentifier() == (*sit)->_pmtPid) {
+            (*sit)->assemblePmt(pPacket);
+        }
+        (*sit)->writePacket(pPacket);
+    }
+}
+
+
+void
+Splitter::indexServices()
+{
+    _pidIndex.clear();
+    for (std::vector<Service*>::iterator it = _services.begin(); it != _services.end(); ++it) {
+        for (std::set<Poco::UInt16>::iterator pit = (*it)->_pids.begin(); pit != (*it)->_pids.end(); ++pit) {
+            _pidIndex[*pit].push_back(*it);
+        }
+    }
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
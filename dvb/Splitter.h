@@ -0,0 +1,66 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef Splitter_INCLUDED
+#define Splitter_INCLUDED
+
+#include <vector>
+#include <unordered_map>
+
+#include <Poco/Types.h>
+
+
+namespace Omm {
+namespace Dvb {
+
+class Service;
+class TransportStreamPacket;
+
+
+class StreamTarget
+/// Receives the single program transport stream of a service split from the multiplex.
+/// write() is called in the remux thread with whole TS packets and must not block.
+{
+public:
+    virtual ~StreamTarget() {}
+
+    virtual void write(const char* pData, unsigned int size) = 0;
+};
+
+
+class Splitter
+/// Splits the multiplex into single program transport streams in one pass of the remux thread.
+/// One pid lookup per packet finds all outputs that carry it, each output writes the packet
+/// with its own PAT, rewritten PMT and continuity counters directly into its recording,
+/// so there is no queue thread and packet queue per service. Not locked, the remux calls
+/// it with its own lock held.
+{
+public:
+    void addService(Service* pService);
+    bool delService(Service* pService);
+    /// false if pService is not an output of the splitter
+    bool hasServices();
+
+    void splitPacket(TransportStreamPacket* pPacket);
+
+private:
+    void indexServices();
+
+    std::vector<Service*>                                       _services;
+    std::unordered_map<Poco::UInt16, std::vector<Service*> >    _pidIndex;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
@@ -10,6 +10,8 @@
 |  it under the terms of the MIT License                                    |
  ***************************************************************************/
 
+#include <Poco/NumberFormatter.h>
+#include <Poco/NumberParser.h>
 #include <Poco/DOM/AbstractContainerNode.h>
 #include <Poco/DOM/DOMException.h>
 #include <Poco/DOM/DOMParser.h>
@@ -31,42 +33,14 @@
 #include "Stream.h"
 #include "ElementaryStream.h"
 #include "Mux.h"
+#include "ChannelDb.h"
 
 
 namespace Omm {
 namespace Dvb {
 
-const std::string Stream::Video("video");
-const std::string Stream::Audio("audio");
-const std::string Stream::VideoMpeg1_11172("videoMpeg1_11172");
-const std::string Stream::VideoMpeg2_H262("videoMpeg2_H262");
-const std::string Stream::AudioMpeg1_11172("audioMpeg1_11172");
-const std::string Stream::AudioMpeg2_13818_3("audioMpeg2_13818_3");
-const std::string Stream::Mpeg2PrivateTableSections("mpeg2PrivateTableSections");
-const std::string Stream::Mpeg2PesPrivateData("mpeg2PesPrivateData");
-const std::string Stream::MhegPackets("mhegPackets");
-const std::string Stream::Mpeg2AnnexA_DSMCC("mpeg2AnnexA_DSMCC");
-const std::string Stream::ITUTRecH2221("itu-TRecH2221");
-const std::string Stream::ISO13818_6_typeA("iso-13818_6_typeA");
-const std::string Stream::ISO13818_6_typeB("iso-13818_6_typeB");
-const std::string Stream::ISO13818_6_typeC("iso-13818_6_typeC");
-const std::string Stream::ISO13818_6_typeD("iso-13818_6_typeD");
-const std::string Stream::Mpeg2ISO13818_1_Aux("mpeg2ISO13818_1_Aux");
-const std::string Stream::AudioISO13818_7_ADTS("audioISO13818_7_ADTS");
-const std::string Stream::Mpeg4ISO14496_2("mpeg4ISO14496_2");
-const std::string Stream::AudioISO14496_3("audioISO14496_3");
-const std::string Stream::ISO14496_1_PesPackets("iso-14496_1_PesPackets");
-const std::string Stream::ISO14496_1_Sections("iso-14496_1_Sections");
-const std::string Stream::ISO13818_6_DownloadProt("iso-13818_6_DownloadProt");
-const std::string Stream::MetaDataPesPackets("metaDataPesPackets");
-const std::string Stream::MetaDataSections("metaDataSections");
-const std::string Stream::Mpeg2UserPrivate("mpeg2UserPrivate");
-const std::string Stream::AudioAtscAc3("audioAtscAc3");
-const std::string Stream::ProgramClock("programClock");
-const std::string Stream::ProgramMapTable("programMapTable");
-const std::string Stream::Other("other");
-
-Stream::Stream(const std::string& type, Poco::UInt16 pid) :
+
+Stream::Stream(Poco::UInt16 type, Poco::UInt16 pid) :
 _type(type),
 _pid(pid)
 {
@@ -88,14 +62,22 @@ Stream::writeXml(Poco::XML::Element* pService)
     Poco::XML::Document* pDoc = pService->ownerDocument();
     Poco::AutoPtr<Poco::XML::Element> pStream = pDoc->createElement("stream");
     pService->appendChild(pStream);
-    pStream->setAttribute("type", _type);
+    pStream->setAttribute("type", streamTypeToString(_type));
     pStream->setAttribute("pid", Poco::NumberFormatter::format(_pid));
 
     LOG(dvb, debug, "wrote stream.");
 }
 
 
-std::string
+void
+Stream::writeDb(ChannelDbWriter& db)
+{
+    db.writeUInt16(_type);
+    db.writeUInt16(_pid);
+}
+
+
+Poco::UInt16
 Stream::getType()
 {
     return _type;
@@ -110,7 +92,9 @@ Stream::isAudio()
         _type == AudioMpeg2_13818_3 ||
         _type == AudioISO13818_7_ADTS ||
         _type == AudioISO14496_3 ||
-        _type == AudioAtscAc3
+        _type == AudioAtscAc3 ||
+        _type == AudioDvbAc3 ||
+        _type == AudioDvbEac3
         ) {
         return true;
     }
@@ -123,7 +107,9 @@ Stream::isVideo()
 {
     if (_type == Video ||
         _type == VideoMpeg1_11172 ||
-        _type == VideoMpeg2_H262
+        _type == VideoMpeg2_H262 ||
+        _type == VideoH264_14496_10 ||
+        _type == VideoHevc_23008_2
         ) {
         return true;
     }
@@ -300,141 +286,190 @@ Stream::getPid()
 //}
 
 
-Poco::UInt8
+Poco::UInt16
 Stream::streamTypeFromString(const std::string& val)
 {
-    if (val == VideoMpeg1_11172) {
-        return 0x01;
+    if (val == "video") {
+        return Video;
+    }
+    else if (val == "audio") {
+        return Audio;
+    }
+    else if (val == "videoMpeg1_11172") {
+        return VideoMpeg1_11172;
+    }
+    else if (val == "videoMpeg2_H262") {
+        return VideoMpeg2_H262;
+    }
+    else if (val == "audioMpeg1_11172") {
+        return AudioMpeg1_11172;
+    }
+    else if (val == "audioMpeg2_13818_3") {
+        return AudioMpeg2_13818_3;
+    }
+    else if (val == "mpeg2PrivateTableSections") {
+        return Mpeg2PrivateTableSections;
+    }
+    else if (val == "mpeg2PesPrivateData") {
+        return Mpeg2PesPrivateData;
+    }
+    else if (val == "mhegPackets") {
+        return MhegPackets;
+    }
+    else if (val == "mpeg2AnnexA_DSMCC") {
+        return Mpeg2AnnexA_DSMCC;
     }
-    else if (val == VideoMpeg2_H262) {
-        return 0x02;
+    else if (val == "itu-TRecH2221") {
+        return ITUTRecH2221;
     }
-    else if (val == AudioMpeg1_11172) {
-        return 0x03;
+    else if (val == "iso-13818_6_typeA") {
+        return ISO13818_6_typeA;
     }
-    else if (val == AudioMpeg2_13818_3) {
-        return 0x04;
+    else if (val == "iso-13818_6_typeB") {
+        return ISO13818_6_typeB;
     }
-    else if (val == Mpeg2PrivateTableSections) {
-        return 0x05;
+    else if (val == "iso-13818_6_typeC") {
+        return ISO13818_6_typeC;
     }
-    else if (val == Mpeg2PesPrivateData) {
-        return 0x06;
+    else if (val == "iso-13818_6_typeD") {
+        return ISO13818_6_typeD;
     }
-    else if (val == MhegPackets) {
-        return 0x07;
+    else if (val == "mpeg2ISO13818_1_Aux") {
+        return Mpeg2ISO13818_1_Aux;
     }
-    else if (val == Mpeg2AnnexA_DSMCC) {
-        return 0x08;
+    else if (val == "audioISO13818_7_ADTS") {
+        return AudioISO13818_7_ADTS;
     }
-    else if (val == ITUTRecH2221) {
-        return 0x09;
+    else if (val == "mpeg4ISO14496_2") {
+        return Mpeg4ISO14496_2;
     }
-    else if (val == ISO13818_6_typeA) {
-        return 0x0A;
+    else if (val == "audioISO14496_3") {
+        return AudioISO14496_3;
     }
-    else if (val == ISO13818_6_typeB) {
-        return 0x0B;
+    else if (val == "iso-14496_1_PesPackets") {
+        return ISO14496_1_PesPackets;
     }
-    else if (val == ISO13818_6_typeC) {
-        return 0x0C;
+    else if (val == "iso-14496_1_Sections") {
+        return ISO14496_1_Sections;
     }
-    else if (val == ISO13818_6_typeD) {
-        return 0x0D;
+    else if (val == "iso-13818_6_DownloadProt") {
+        return ISO13818_6_DownloadProt;
     }
-    else if (val == Mpeg2ISO13818_1_Aux) {
-        return 0x0E;
+    else if (val == "metaDataPesPackets") {
+        return MetaDataPesPackets;
     }
-    else if (val == AudioISO13818_7_ADTS) {
-        return 0x0F;
+    else if (val == "metaDataSections") {
+        return MetaDataSections;
     }
-    else if (val == Mpeg4ISO14496_2) {
-        return 0x10;
+    else if (val == "videoH264_14496_10") {
+        return VideoH264_14496_10;
     }
-    else if (val == AudioISO14496_3) {
-        return 0x11;
+    else if (val == "videoHevc_23008_2") {
+        return VideoHevc_23008_2;
     }
-    else if (val == ISO14496_1_PesPackets) {
-        return 0x12;
+    else if (val == "mpeg2UserPrivate") {
+        return Mpeg2UserPrivate;
     }
-    else if (val == ISO14496_1_Sections) {
-        return 0x13;
+    else if (val == "audioAtscAc3") {
+        return AudioAtscAc3;
     }
-    else if (val == ISO13818_6_DownloadProt) {
-        return 0x14;
+    else if (val == "audioDvbAc3") {
+        return AudioDvbAc3;
     }
-    else if (val == MetaDataPesPackets) {
-        return 0x15;
+    else if (val == "audioDvbEac3") {
+        return AudioDvbEac3;
     }
-    else if (val == MetaDataSections) {
-        return 0x16;
+    else if (val == "programClock") {
+        return ProgramClock;
     }
-    else if (val == Mpeg2UserPrivate) {
-        return 0x80;
+    else if (val == "programMapTable") {
+        return ProgramMapTable;
     }
-    else if (val == AudioAtscAc3) {
-        return 0x81;
+    else if (val == "other") {
+        return Other;
     }
     else {
-        return 0x82;
+        unsigned int type;
+        if (val.compare(0, 2, "0x") == 0 && Poco::NumberParser::tryParseHex(val.substr(2), type) && type <= 0xff) {
+            return type;
+        }
+        return Other;
     }
 }
 
 
 std::string
-Stream::streamTypeToString(Poco::UInt8 val)
+Stream::streamTypeToString(Poco::UInt16 val)
 {
     switch (val) {
-        case 0x01:
-            return VideoMpeg1_11172;
-        case 0x02:
-            return VideoMpeg2_H262;
-        case 0x03:
-            return AudioMpeg1_11172;
-        case 0x04:
-            return AudioMpeg2_13818_3;
-        case 0x05:
-            return Mpeg2PrivateTableSections;
-        case 0x06:
-            return Mpeg2PesPrivateData;
-        case 0x07:
-            return MhegPackets;
-        case 0x08:
-            return Mpeg2AnnexA_DSMCC;
-        case 0x09:
-            return ITUTRecH2221;
-        case 0x0A:
-            return ISO13818_6_typeA;
-        case 0x0B:
-            return ISO13818_6_typeB;
-        case 0x0C:
-            return ISO13818_6_typeC;
-        case 0x0D:
-            return ISO13818_6_typeD;
-        case 0x0E:
-            return Mpeg2ISO13818_1_Aux;
-        case 0x0F:
-            return AudioISO13818_7_ADTS;
-        case 0x10:
-            return Mpeg4ISO14496_2;
-        case 0x11:
-            return AudioISO14496_3;
-        case 0x12:
-            return ISO14496_1_PesPackets;
-        case 0x13:
-            return ISO14496_1_Sections;
-        case 0x14:
-            return ISO13818_6_DownloadProt;
-        case 0x15:
-            return MetaDataPesPackets;
-        case 0x16:
-            return MetaDataSections;
-        case 0x80:
-            return Mpeg2UserPrivate;
-        case 0x81:
-            return AudioAtscAc3;
+        case Video:
+            return "video";
+        case Audio:
+            return "audio";
+        case VideoMpeg1_11172:
+            return "videoMpeg1_11172";
+        case VideoMpeg2_H262:
+            return "videoMpeg2_H262";
+        case AudioMpeg1_11172:
+            return "audioMpeg1_11172";
+        case AudioMpeg2_13818_3:
+            return "audioMpeg2_13818_3";
+        case Mpeg2PrivateTableSections:
+            return "mpeg2PrivateTableSections";
+        case Mpeg2PesPrivateData:
+            return "mpeg2PesPrivateData";
+        case MhegPackets:
+            return "mhegPackets";
+        case Mpeg2AnnexA_DSMCC:
+            return "mpeg2AnnexA_DSMCC";
+        case ITUTRecH2221:
+            return "itu-TRecH2221";
+        case ISO13818_6_typeA:
+            return "iso-13818_6_typeA";
+        case ISO13818_6_typeB:
+            return "iso-13818_6_typeB";
+        case ISO13818_6_typeC:
+            return "iso-13818_6_typeC";
+        case ISO13818_6_typeD:
+            return "iso-13818_6_typeD";
+        case Mpeg2ISO13818_1_Aux:
+            return "mpeg2ISO13818_1_Aux";
+        case AudioISO13818_7_ADTS:
+            return "audioISO13818_7_ADTS";
+        case Mpeg4ISO14496_2:
+            return "mpeg4ISO14496_2";
+        case AudioISO14496_3:
+            return "audioISO14496_3";
+        case ISO14496_1_PesPackets:
+            return "iso-14496_1_PesPackets";
+        case ISO14496_1_Sections:
+            return "iso-14496_1_Sections";
+        case ISO13818_6_DownloadProt:
+            return "iso-13818_6_DownloadProt";
+        case MetaDataPesPackets:
+            return "metaDataPesPackets";
+        case MetaDataSections:
+            return "metaDataSections";
+        case VideoH264_14496_10:
+            return "videoH264_14496_10";
+        case VideoHevc_23008_2:
+            return "videoHevc_23008_2";
+        case Mpeg2UserPrivate:
+            return "mpeg2UserPrivate";
+        case AudioAtscAc3:
+            return "audioAtscAc3";
+        case ProgramClock:
+            return "programClock";
+        case ProgramMapTable:
+            return "programMapTable";
+        case Other:
+            return "other";
+        case AudioDvbAc3:
+            return "audioDvbAc3";
+        case AudioDvbEac3:
+            return "audioDvbEac3";
         default:
-            return Mpeg2UserPrivate;
+            return "0x" + Poco::NumberFormatter::formatHex(val, 2);
     }
 }
 
@@ -39,6 +39,7 @@ namespace Omm {
 namespace Dvb {
 
 class ElementaryStreamPacket;
+class ChannelDbWriter;
 
 
 class Stream
@@ -47,42 +48,52 @@ class Stream
     friend class Device;
 
 public:
-    static const std::string Video;
-    static const std::string Audio;
-    static const std::string VideoMpeg1_11172;
-    static const std::string VideoMpeg2_H262;
-    static const std::string AudioMpeg1_11172;
-    static const std::string AudioMpeg2_13818_3;
-    static const std::string Mpeg2PrivateTableSections;
-    static const std::string Mpeg2PesPrivateData;
-    static const std::string MhegPackets;
-    static const std::string Mpeg2AnnexA_DSMCC;
-    static const std::string ITUTRecH2221;
-    static const std::string ISO13818_6_typeA;
-    static const std::string ISO13818_6_typeB;
-    static const std::string ISO13818_6_typeC;
-    static const std::string ISO13818_6_typeD;
-    static const std::string Mpeg2ISO13818_1_Aux;
-    static const std::string AudioISO13818_7_ADTS;
-    static const std::string Mpeg4ISO14496_2;
-    static const std::string AudioISO14496_3;
-    static const std::string ISO14496_1_PesPackets;
-    static const std::string ISO14496_1_Sections;
-    static const std::string ISO13818_6_DownloadProt;
-    static const std::string MetaDataPesPackets;
-    static const std::string MetaDataSections;
-    static const std::string Mpeg2UserPrivate;
-    static const std::string AudioAtscAc3;
-    static const std::string ProgramClock;
-    static const std::string ProgramMapTable;
-    static const std::string Other;
-
-    Stream(const std::string& type, Poco::UInt16 pid);
+    enum Type
+    /// stream_type of the program map table, followed by types that don't appear in a program map table
+    {
+        VideoMpeg1_11172 = 0x01,
+        VideoMpeg2_H262 = 0x02,
+        AudioMpeg1_11172 = 0x03,
+        AudioMpeg2_13818_3 = 0x04,
+        Mpeg2PrivateTableSections = 0x05,
+        Mpeg2PesPrivateData = 0x06,
+        MhegPackets = 0x07,
+        Mpeg2AnnexA_DSMCC = 0x08,
+        ITUTRecH2221 = 0x09,
+        ISO13818_6_typeA = 0x0A,
+        ISO13818_6_typeB = 0x0B,
+        ISO13818_6_typeC = 0x0C,
+        ISO13818_6_typeD = 0x0D,
+        Mpeg2ISO13818_1_Aux = 0x0E,
+        AudioISO13818_7_ADTS = 0x0F,
+        Mpeg4ISO14496_2 = 0x10,
+        AudioISO14496_3 = 0x11,
+        ISO14496_1_PesPackets = 0x12,
+        ISO14496_1_Sections = 0x13,
+        ISO13818_6_DownloadProt = 0x14,
+        MetaDataPesPackets = 0x15,
+        MetaDataSections = 0x16,
+        VideoH264_14496_10 = 0x1B,
+        VideoHevc_23008_2 = 0x24,
+        Mpeg2UserPrivate = 0x80,
+        AudioAtscAc3 = 0x81,
+        Video = 0x100,
+        Audio = 0x101,
+        ProgramClock = 0x102,
+        ProgramMapTable = 0x103,
+        Other = 0x104,
+        AudioDvbAc3 = 0x105,
+        AudioDvbEac3 = 0x106
+        /// DVB carries AC-3 and E-AC-3 as Mpeg2PesPrivateData with an AC-3 or enhanced AC-3 descriptor
+    };
+
+    Stream(Poco::UInt16 type, Poco::UInt16 pid);
 
     void readXml(Poco::XML::Node* pXmlStream);
     void writeXml(Poco::XML::Element* pService);
+    void writeDb(ChannelDbWriter& db);
 
-    std::string getType();
+    Poco::UInt16 getType();
     bool isAudio();
     bool isVideo();
     Poco::UInt16 getPid();
@@ -90,11 +101,12 @@ public:
 //    void skipToElementaryStreamPacketHeader(Poco::UInt8* skippedBytes, int timeout = 0);
 //    ElementaryStreamPacket* getElementaryStreamPacket(int timeout = 0);
 
-    static Poco::UInt8 streamTypeFromString(const std::string& val);
-    static std::string streamTypeToString(Poco::UInt8 val);
+    static Poco::UInt16 streamTypeFromString(const std::string& val);
+    static std::string streamTypeToString(Poco::UInt16 val);
+    /// stream types without a name are written as hex number, so they survive the xml description
 
 private:
-    std::string         _type;
+    Poco::UInt16        _type;
     Poco::UInt16        _pid;
 };
 
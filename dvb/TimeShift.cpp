@@ -0,0 +1,209 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <Poco/NumberFormatter.h>
+
+#include "Log.h"
+#include "TransportStream.h"
+#include "TimeShift.h"
+
+
+namespace Omm {
+namespace Dvb {
+
+
+const unsigned int TimeShift::AudioBitrate(384000);
+const unsigned int TimeShift::VideoBitrate(8000000);
+
+TimeShift::TimeShift() :
+_fileDesc(-1),
+_pData(0),
+_capacity(0),
+_begin(0),
+_end(0),
+_stopped(false)
+{
+}
+
+
+TimeShift::~TimeShift()
+{
+    close();
+}
+
+
+bool
+TimeShift::open(const std::string& directory, Poco::UInt64 capacity)
+{
+    capacity -= capacity % TransportStreamPacket::Size;
+    if (capacity == 0) {
+        return false;
+    }
+    std::string path = directory + "/omm-timeshift-" + Poco::NumberFormatter::format(::getpid()) + "-" + Poco::NumberFormatter::format(this);
+    _fileDesc = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (_fileDesc == -1) {
+        LOG(dvb, error, "failed to create time-shift file " + path + ": " + std::string(strerror(errno)));
+        return false;
+    }
+    ::unlink(path.c_str());
+    // allocate all blocks now, so that writing to the mapping can't fail on a full disk later
+    int res = ::posix_fallocate(_fileDesc, 0, capacity);
+    if (res) {
+        LOG(dvb, error, "failed to allocate time-shift file " + path + ": " + std::string(strerror(res)));
+        close();
+        return false;
+    }
+    void* pData = ::mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _fileDesc, 0);
+    if (pData == MAP_FAILED) {
+        LOG(dvb, error, "failed to map time-shift file " + path + ": " + std::string(strerror(errno)));
+        close();
+        return false;
+    }
+    _pData = (char*)pData;
+    _capacity = capacity;
+    _begin = 0;
+    _end = 0;
+    _stopped = false;
+    LOG(dvb, information, "time-shift ring of " + Poco::NumberFormatter::format(_capacity) + " bytes in " + directory);
+    return true;
+}
+
+
+void
+TimeShift::close()
+{
+    stop();
+    if (_pData) {
+        ::munmap(_pData, _capacity);
+        _pData = 0;
+    }
+    if (_fileDesc != -1) {
+        ::close(_fileDesc);
+        _fileDesc = -1;
+    }
+}
+
+
+void
+TimeShift::stop()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    _stopped = true;
+    _writeCondition.broadcast();
+}
+
+
+void
+TimeShift::write(const char* pData, unsigned int size)
+{
+    if (!_pData) {
+        return;
+    }
+    // only the writer changes _end, so it can read it without the lock
+    Poco::UInt64 end = _end + size;
+    _lock.lock();
+    if (end > _capacity && end - _capacity > _begin) {
+        _begin = end - _capacity;
+    }
+    _lock.unlock();
+
+    Poco::UInt64 position = _end;
+    while (size) {
+        Poco::UInt64 offset = position % _capacity;
+        unsigned int chunk = std::min((Poco::UInt64)size, _capacity - offset);
+        ::memcpy(_pData + offset, pData, chunk);
+        pData += chunk;
+        position += chunk;
+        size -= chunk;
+    }
+
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    _end = end;
+    _writeCondition.broadcast();
+}
+
+
+int
+TimeShift::read(char* pData, unsigned int size, Poco::UInt64& position)
+{
+    if (!_pData) {
+        return 0;
+    }
+    const Poco::UInt64 packetSize = TransportStreamPacket::Size;
+    for (;;) {
+        _lock.lock();
+        if (position > _end) {
+            position -= (position - _end) / packetSize * packetSize;
+        }
+        while (position >= _end && !_stopped) {
+            _writeCondition.wait<Poco::FastMutex>(_lock);
+        }
+        if (position < _begin) {
+            LOG(dvb, debug, "time-shift reader skips " + Poco::NumberFormatter::format(_begin - position) + " overwritten bytes");
+            position += (_begin - position + packetSize - 1) / packetSize * packetSize;
+        }
+        if (position >= _end) {
+            _lock.unlock();
+            return 0;
+        }
+        unsigned int bytesRead = std::min((Poco::UInt64)size, _end - position);
+        _lock.unlock();
+
+        // copy without the lock and check afterwards that the writer didn't overwrite the data meanwhile
+        copy(pData, bytesRead, position);
+        Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+        if (position >= _begin) {
+            return bytesRead;
+        }
+    }
+}
+
+
+Poco::UInt64
+TimeShift::begin()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    return _begin;
+}
+
+
+Poco::UInt64
+TimeShift::end()
+{
+    Poco::ScopedLock<Poco::FastMutex> lock(_lock);
+    return _end;
+}
+
+
+void
+TimeShift::copy(char* pData, unsigned int size, Poco::UInt64 position)
+{
+    while (size) {
+        Poco::UInt64 offset = position % _capacity;
+        unsigned int chunk = std::min((Poco::UInt64)size, _capacity - offset);
+        ::memcpy(pData, _pData + offset, chunk);
+        pData += chunk;
+        position += chunk;
+        size -= chunk;
+    }
+}
+
+
+}  // namespace Omm
+}  // namespace Dvb
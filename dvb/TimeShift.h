@@ -0,0 +1,73 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef TimeShift_INCLUDED
+#define TimeShift_INCLUDED
+
+#include <string>
+
+#include <Poco/Types.h>
+#include <Poco/Mutex.h>
+#include <Poco/Condition.h>
+
+
+namespace Omm {
+namespace Dvb {
+
+
+class TimeShift
+/// Ring buffer of the last minutes of a service stream in a preallocated file, mapped into memory.
+/// Positions are byte offsets into the stream since the ring was opened. The writer never blocks,
+/// so a paused reader only costs disk space and its old data is overwritten eventually.
+{
+public:
+    static const unsigned int AudioBitrate;
+    static const unsigned int VideoBitrate;
+    /// bits per second, used to size the ring for a given number of minutes
+
+    TimeShift();
+    ~TimeShift();
+
+    bool open(const std::string& directory, Poco::UInt64 capacity);
+    /// the ring file is unlinked right after creation, so it disappears with the last reference
+    void close();
+    void stop();
+    /// wake up blocked readers, they read to the end of the ring and then get 0 bytes
+
+    void write(const char* pData, unsigned int size);
+    int read(char* pData, unsigned int size, Poco::UInt64& position);
+    /// blocks until data at position is available. A position that has already been overwritten is
+    /// moved forward to the oldest packet in the ring, a position beyond the end back to the live end,
+    /// both keeping the offset inside a TS packet.
+    Poco::UInt64 begin();
+    Poco::UInt64 end();
+
+private:
+    void copy(char* pData, unsigned int size, Poco::UInt64 position);
+
+    int                 _fileDesc;
+    char*               _pData;
+    Poco::UInt64        _capacity;
+    // stream positions of the oldest valid byte and of the live end, everything
+    // before _begin may already be overwritten by a write in progress
+    Poco::UInt64        _begin;
+    Poco::UInt64        _end;
+    bool                _stopped;
+    Poco::FastMutex     _lock;
+    Poco::Condition     _writeCondition;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
@@ -34,17 +34,23 @@
 #include "Service.h"
 #include "Transponder.h"
 #include "Frontend.h"
+#include "ChannelDb.h"
 
 
 namespace Omm {
 namespace Dvb {
 
 const int Transponder::InvalidTransportStreamId(-1);
+const int Transponder::InvalidVersion(-1);
 
 Transponder::Transponder(Frontend* pFrontend, unsigned int freq, int tsid) :
 _pFrontend(pFrontend),
 _frequency(freq),
-_transportStreamId(tsid)
+_transportStreamId(tsid),
+_patVersion(InvalidVersion),
+_sdtVersion(InvalidVersion),
+_nitVersion(InvalidVersion),
+_lockTime(0)
 {
 }
 
@@ -53,18 +59,18 @@ void
 Transponder::addService(Dvb::Service* pService)
 {
     _services.push_back(pService);
+    // like a linear search, lookups return the first service added with an id or name
+    _serviceIdIndex.insert(std::make_pair(pService->_sid, pService));
+    _serviceNameIndex.insert(std::make_pair(pService->getName(), pService));
 }
 
 
 Service*
 Transponder::getService(unsigned int serviceId)
 {
-    std::vector<Dvb::Service*>::iterator it = _services.begin();
-    while (it != _services.end() && (*it)->_sid != serviceId) {
-        ++it;
-    }
-    if (it != _services.end()) {
-        return *it;
+    std::unordered_map<unsigned int, Dvb::Service*>::iterator it = _serviceIdIndex.find(serviceId);
+    if (it != _serviceIdIndex.end()) {
+        return it->second;
     }
     else {
         return 0;
@@ -79,15 +85,19 @@ Transponder::getFrequency()
 }
 
 
+int
+Transponder::getTransportStreamId()
+{
+    return _transportStreamId;
+}
+
+
 Service*
 Transponder::getService(const std::string& serviceName)
 {
-    std::vector<Dvb::Service*>::iterator it = _services.begin();
-    while (it != _services.end() && (*it)->_name != serviceName) {
-        ++it;
-    }
-    if (it != _services.end()) {
-        return *it;
+    std::unordered_map<std::string, Dvb::Service*>::iterator it = _serviceNameIndex.find(serviceName);
+    if (it != _serviceNameIndex.end()) {
+        return it->second;
     }
     else {
         return 0;
@@ -95,11 +105,37 @@ Transponder::getService(const std::string& serviceName)
 }
 
 
+void
+Transponder::setServiceName(Service* pService, const std::string& serviceName)
+{
+    std::unordered_map<std::string, Dvb::Service*>::iterator it = _serviceNameIndex.find(pService->getName());
+    if (it != _serviceNameIndex.end() && it->second == pService) {
+        _serviceNameIndex.erase(it);
+    }
+    pService->_name = serviceName;
+    _serviceNameIndex.insert(std::make_pair(pService->getName(), pService));
+}
+
+
 void
 Transponder::readXml(Poco::XML::Node* pXmlTransponder)
 {
     LOG(dvb, debug, "read transponder ...");
 
+    Poco::XML::Element* pXmlElement = static_cast<Poco::XML::Element*>(pXmlTransponder);
+    if (pXmlElement->hasAttribute("patVersion")) {
+        _patVersion = Poco::NumberParser::parse(pXmlElement->getAttribute("patVersion"));
+    }
+    if (pXmlElement->hasAttribute("sdtVersion")) {
+        _sdtVersion = Poco::NumberParser::parse(pXmlElement->getAttribute("sdtVersion"));
+    }
+    if (pXmlElement->hasAttribute("nitVersion")) {
+        _nitVersion = Poco::NumberParser::parse(pXmlElement->getAttribute("nitVersion"));
+    }
+    if (pXmlElement->hasAttribute("lockTime")) {
+        _lockTime = Poco::NumberParser::parse(pXmlElement->getAttribute("lockTime"));
+    }
+
     if (pXmlTransponder->hasChildNodes()) {
         Poco::XML::Node* pXmlService = pXmlTransponder->firstChild();
         while (pXmlService && pXmlService->nodeName() == "service") {
@@ -133,6 +169,18 @@ Transponder::writeXml(Poco::XML::Element* pFrontend)
     pFrontend->appendChild(_pXmlTransponder);
     _pXmlTransponder->setAttribute("frequency", Poco::NumberFormatter::format(_frequency));
     _pXmlTransponder->setAttribute("tsid", Poco::NumberFormatter::format(_transportStreamId));
+    if (_patVersion != InvalidVersion) {
+        _pXmlTransponder->setAttribute("patVersion", Poco::NumberFormatter::format(_patVersion));
+    }
+    if (_sdtVersion != InvalidVersion) {
+        _pXmlTransponder->setAttribute("sdtVersion", Poco::NumberFormatter::format(_sdtVersion));
+    }
+    if (_nitVersion != InvalidVersion) {
+        _pXmlTransponder->setAttribute("nitVersion", Poco::NumberFormatter::format(_nitVersion));
+    }
+    if (_lockTime) {
+        _pXmlTransponder->setAttribute("lockTime", Poco::NumberFormatter::format(_lockTime));
+    }
 
     for (std::vector<Service*>::iterator it = _services.begin(); it != _services.end(); ++it) {
         (*it)->writeXml(_pXmlTransponder);
@@ -142,6 +190,44 @@ Transponder::writeXml(Poco::XML::Element* pFrontend)
 }
 
 
+void
+Transponder::readDb(ChannelDbReader& db)
+{
+    _patVersion = db.readInt32();
+    _sdtVersion = db.readInt32();
+    _nitVersion = db.readInt32();
+    _lockTime = db.readUInt32();
+
+    Poco::UInt32 serviceCount = db.readUInt32();
+    for (Poco::UInt32 i = 0; i < serviceCount && db.good(); i++) {
+        std::string name = db.readString();
+        unsigned int sid = db.readUInt32();
+        unsigned int pmtid = db.readUInt32();
+        Service* pService = new Service(this, name, sid, pmtid);
+        pService->readDb(db);
+        addService(pService);
+    }
+}
+
+
+void
+Transponder::writeDb(ChannelDbWriter& db)
+{
+    // frequency and transport stream id are needed by the frontend to create the transponder
+    db.writeUInt32(_frequency);
+    db.writeInt32(_transportStreamId);
+    db.writeInt32(_patVersion);
+    db.writeInt32(_sdtVersion);
+    db.writeInt32(_nitVersion);
+    db.writeUInt32(_lockTime);
+
+    db.writeUInt32(_services.size());
+    for (std::vector<Service*>::iterator it = _services.begin(); it != _services.end(); ++it) {
+        (*it)->writeDb(db);
+    }
+}
+
+
 bool
 Transponder::equal(Transponder* pOtherTransponder)
 {
@@ -150,6 +236,34 @@ Transponder::equal(Transponder* pOtherTransponder)
 }
 
 
+bool
+Transponder::hasTableVersions()
+{
+    return _patVersion != InvalidVersion;
+}
+
+
+void
+Transponder::lockedAfter(Poco::Int64 lockTime)
+{
+    unsigned int lockTimeMs = lockTime / 1000 + 1;
+    _lockTime = _lockTime ? (3 * _lockTime + lockTimeMs) / 4 : lockTimeMs;
+}
+
+
+void
+Transponder::clearServices()
+{
+    for (std::vector<Dvb::Service*>::iterator it = _services.begin(); it != _services.end(); ++it) {
+        delete *it;
+    }
+    _services.clear();
+    _serviceIdIndex.clear();
+    _serviceNameIndex.clear();
+    _runningServices.clear();
+}
+
+
 void
 Transponder::markServiceStarted(Service* pService)
 {
@@ -192,11 +306,23 @@ const std::string SatTransponder::FEC_3_5("3/5");
 const std::string SatTransponder::FEC_4_5("4/5");
 const std::string SatTransponder::FEC_9_10("9/10");
 const std::string SatTransponder::FEC_NO_CODING("NoCoding");
+const std::string SatTransponder::ROLLOFF_AUTO("Auto");
+const std::string SatTransponder::ROLLOFF_0_35("0.35");
+const std::string SatTransponder::ROLLOFF_0_25("0.25");
+const std::string SatTransponder::ROLLOFF_0_20("0.20");
+const std::string SatTransponder::PILOT_AUTO("Auto");
+const std::string SatTransponder::PILOT_ON("On");
+const std::string SatTransponder::PILOT_OFF("Off");
 
 
 SatTransponder::SatTransponder(Frontend* pFrontend, unsigned int freq, unsigned int tsid) :
 Transponder(pFrontend, freq, tsid),
-_satNum(SatFrontend::InvalidSatNum)
+_satNum(SatFrontend::InvalidSatNum),
+_modulationSystem(MOD_S),
+_modulationType(MOD_TYPE_AUTO),
+_fecInner(FEC_NOT_DEFINED),
+_rollOff(ROLLOFF_AUTO),
+_pilot(PILOT_AUTO)
 {
 }
 
@@ -229,6 +355,116 @@ SatTransponder::init(const std::string satPosition, unsigned int satNum, unsigne
 }
 
 
+void
+SatTransponder::initModulation(const std::string& modulationSystem, const std::string& modulationType, const std::string& fecInner, const std::string& rollOff)
+{
+    _modulationSystem = modulationSystem;
+    _modulationType = modulationType;
+    _fecInner = fecInner;
+    _rollOff = rollOff;
+}
+
+
+fe_delivery_system_t
+SatTransponder::deliverySystemFromString(const std::string& val)
+{
+    if (val == MOD_S2) {
+        return SYS_DVBS2;
+    }
+    else {
+        return SYS_DVBS;
+    }
+}
+
+
+fe_modulation_t
+SatTransponder::modulationFromString(const std::string& val)
+{
+    if (val == MOD_TYPE_8PSK) {
+        return ::PSK_8;
+    }
+    else if (val == MOD_TYPE_16QAM) {
+        // 16 point constellation of DVB-S2 is APSK
+        return ::APSK_16;
+    }
+    else {
+        return ::QPSK;
+    }
+}
+
+
+fe_code_rate_t
+SatTransponder::fecFromString(const std::string& val)
+{
+    if (val == FEC_1_2) {
+        return ::FEC_1_2;
+    }
+    else if (val == FEC_2_3) {
+        return ::FEC_2_3;
+    }
+    else if (val == FEC_3_4) {
+        return ::FEC_3_4;
+    }
+    else if (val == FEC_5_6) {
+        return ::FEC_5_6;
+    }
+    else if (val == FEC_7_8) {
+        return ::FEC_7_8;
+    }
+    else if (val == FEC_8_9) {
+        return ::FEC_8_9;
+    }
+    else if (val == FEC_3_5) {
+        return ::FEC_3_5;
+    }
+    else if (val == FEC_4_5) {
+        return ::FEC_4_5;
+    }
+    else if (val == FEC_9_10) {
+        return ::FEC_9_10;
+    }
+    else if (val == FEC_NO_CODING) {
+        return ::FEC_NONE;
+    }
+    else {
+        return ::FEC_AUTO;
+    }
+}
+
+
+fe_rolloff_t
+SatTransponder::rollOffFromString(const std::string& val)
+{
+    if (val == ROLLOFF_0_35) {
+        return ::ROLLOFF_35;
+    }
+    else if (val == ROLLOFF_0_25) {
+        return ::ROLLOFF_25;
+    }
+    else if (val == ROLLOFF_0_20) {
+        return ::ROLLOFF_20;
+    }
+    else {
+        return ::ROLLOFF_AUTO;
+    }
+}
+
+
+fe_pilot_t
+SatTransponder::pilotFromString(const std::string& val)
+{
+    if (val == PILOT_ON) {
+        return ::PILOT_ON;
+    }
+    else if (val == PILOT_OFF) {
+        return ::PILOT_OFF;
+    }
+    else {
+        return ::PILOT_AUTO;
+    }
+}
+
+
 void
 SatTransponder::readXml(Poco::XML::Node* pXmlTransponder)
 {
@@ -257,6 +493,21 @@ SatTransponder::readXml(Poco::XML::Node* pXmlTransponder)
             else if (pXmlParam->nodeName() == "polarization") {
                 _polarization = pXmlParamVal->innerText();
             }
+            else if (pXmlParam->nodeName() == "modulationSystem") {
+                _modulationSystem = pXmlParamVal->innerText();
+            }
+            else if (pXmlParam->nodeName() == "modulationType") {
+                _modulationType = pXmlParamVal->innerText();
+            }
+            else if (pXmlParam->nodeName() == "fecInner") {
+                _fecInner = pXmlParamVal->innerText();
+            }
+            else if (pXmlParam->nodeName() == "rollOff") {
+                _rollOff = pXmlParamVal->innerText();
+            }
+            else if (pXmlParam->nodeName() == "pilot") {
+                _pilot = pXmlParamVal->innerText();
+            }
             else {
                 LOG(dvb, error, "dvb sat transponder unknown parameter: " + pXmlParam->nodeName());
             }
@@ -296,14 +547,73 @@ SatTransponder::writeXml(Poco::XML::Element* pFrontend)
     pPolarization->appendChild(pPolarizationVal);
     _pXmlTransponder->appendChild(pPolarization);
 
+    Poco::AutoPtr<Poco::XML::Element> pModulationSystem = pDoc->createElement("modulationSystem");
+    Poco::AutoPtr<Poco::XML::Text> pModulationSystemVal = pDoc->createTextNode(_modulationSystem);
+    pModulationSystem->appendChild(pModulationSystemVal);
+    _pXmlTransponder->appendChild(pModulationSystem);
+
+    Poco::AutoPtr<Poco::XML::Element> pModulationType = pDoc->createElement("modulationType");
+    Poco::AutoPtr<Poco::XML::Text> pModulationTypeVal = pDoc->createTextNode(_modulationType);
+    pModulationType->appendChild(pModulationTypeVal);
+    _pXmlTransponder->appendChild(pModulationType);
+
+    Poco::AutoPtr<Poco::XML::Element> pFecInner = pDoc->createElement("fecInner");
+    Poco::AutoPtr<Poco::XML::Text> pFecInnerVal = pDoc->createTextNode(_fecInner);
+    pFecInner->appendChild(pFecInnerVal);
+    _pXmlTransponder->appendChild(pFecInner);
+
+    Poco::AutoPtr<Poco::XML::Element> pRollOff = pDoc->createElement("rollOff");
+    Poco::AutoPtr<Poco::XML::Text> pRollOffVal = pDoc->createTextNode(_rollOff);
+    pRollOff->appendChild(pRollOffVal);
+    _pXmlTransponder->appendChild(pRollOff);
+
+    Poco::AutoPtr<Poco::XML::Element> pPilot = pDoc->createElement("pilot");
+    Poco::AutoPtr<Poco::XML::Text> pPilotVal = pDoc->createTextNode(_pilot);
+    pPilot->appendChild(pPilotVal);
+    _pXmlTransponder->appendChild(pPilot);
+
     LOG(dvb, debug, "wrote sat transponder.");
 }
 
 
+void
+SatTransponder::readDb(ChannelDbReader& db)
+{
+    Transponder::readDb(db);
+
+    _satPosition = db.readString();
+    _satNum = db.readInt32();
+    _symbolRate = db.readUInt32();
+    _polarization = db.readString();
+    _modulationSystem = db.readString();
+    _modulationType = db.readString();
+    _fecInner = db.readString();
+    _rollOff = db.readString();
+    _pilot = db.readString();
+}
+
+
+void
+SatTransponder::writeDb(ChannelDbWriter& db)
+{
+    Transponder::writeDb(db);
+
+    db.writeString(_satPosition);
+    db.writeInt32(_satNum);
+    db.writeUInt32(_symbolRate);
+    db.writeString(_polarization);
+    db.writeString(_modulationSystem);
+    db.writeString(_modulationType);
+    db.writeString(_fecInner);
+    db.writeString(_rollOff);
+    db.writeString(_pilot);
+}
+
+
 bool
-SatTransponder::initTransponder(Poco::StringTokenizer& params)
+SatTransponder::initTransponder(const std::vector<std::string>& params)
 {
-    if (params[0] != "S" || params.count() < 4) {
+    if ((params[0] != "S" && params[0] != "S1" && params[0] != "S2") || params.size() < 4) {
         LOG(dvb, error, "invalid parameter data for sat transponder.");
         return false;
     }
@@ -316,6 +626,19 @@ SatTransponder::initTransponder(Poco::StringTokenizer& params)
         return false;
     }
     init("", SatFrontend::InvalidSatNum, symbolRate, params[2]);
+    // optional: fec, roll off in percent and modulation type, as in the dvb-apps scan files
+    if (params[0] == "S2") {
+        _modulationSystem = MOD_S2;
+    }
+    if (params.size() > 4 && params[4] != "AUTO") {
+        _fecInner = params[4];
+    }
+    if (params.size() > 5) {
+        _rollOff = params[5] == "35" ? ROLLOFF_0_35 : params[5] == "25" ? ROLLOFF_0_25 : params[5] == "20" ? ROLLOFF_0_20 : ROLLOFF_AUTO;
+    }
+    if (params.size() > 6) {
+        _modulationType = params[6] == "8PSK" ? MOD_TYPE_8PSK : params[6] == "16APSK" ? MOD_TYPE_16QAM : params[6] == "QPSK" ? MOD_TYPE_QPSK : MOD_TYPE_AUTO;
+    }
     return true;
 }
 
@@ -374,10 +697,15 @@ const std::string TerrestrialTransponder::HIERARCHY_1("1");
 const std::string TerrestrialTransponder::HIERARCHY_2("2");
 const std::string TerrestrialTransponder::HIERARCHY_4("4");
 const std::string TerrestrialTransponder::HIERARCHY_AUTO("AUTO");
+const std::string TerrestrialTransponder::SYSTEM_DVBT("DVBT");
+const std::string TerrestrialTransponder::SYSTEM_DVBT2("DVBT2");
+const int TerrestrialTransponder::NoPlpId(-1);
 
 
 TerrestrialTransponder::TerrestrialTransponder(Frontend* pFrontend, unsigned int freq, unsigned int tsid) :
-Transponder(pFrontend, freq, tsid)
+Transponder(pFrontend, freq, tsid),
+_deliverySystem(SYSTEM_DVBT),
+_plpId(NoPlpId)
 {
 }
 
@@ -450,6 +778,12 @@ TerrestrialTransponder::readXml(Poco::XML::Node* pXmlTransponder)
             else if (pXmlParam->nodeName() == "hierarchyInformation") {
                 _hierarchy_information = hierarchyFromString(pXmlParamVal->innerText());
             }
+            else if (pXmlParam->nodeName() == "deliverySystem") {
+                _deliverySystem = pXmlParamVal->innerText();
+            }
+            else if (pXmlParam->nodeName() == "plpId") {
+                _plpId = Poco::NumberParser::parse(pXmlParamVal->innerText());
+            }
             else {
                 LOG(dvb, error, "dvb terrestrial transponder unknown parameter: " + pXmlParam->nodeName());
             }
@@ -509,17 +843,75 @@ TerrestrialTransponder::writeXml(Poco::XML::Element* pFrontend)
     pHierarchyInformation->appendChild(pHierarchyInformationVal);
     _pXmlTransponder->appendChild(pHierarchyInformation);
 
+    Poco::AutoPtr<Poco::XML::Element> pDeliverySystem = pDoc->createElement("deliverySystem");
+    Poco::AutoPtr<Poco::XML::Text> pDeliverySystemVal = pDoc->createTextNode(_deliverySystem);
+    pDeliverySystem->appendChild(pDeliverySystemVal);
+    _pXmlTransponder->appendChild(pDeliverySystem);
+
+    if (_plpId != NoPlpId) {
+        Poco::AutoPtr<Poco::XML::Element> pPlpId = pDoc->createElement("plpId");
+        Poco::AutoPtr<Poco::XML::Text> pPlpIdVal = pDoc->createTextNode(Poco::NumberFormatter::format(_plpId));
+        pPlpId->appendChild(pPlpIdVal);
+        _pXmlTransponder->appendChild(pPlpId);
+    }
+
     LOG(dvb, debug, "wrote terrestrial transponder.");
 }
 
 
+void
+TerrestrialTransponder::readDb(ChannelDbReader& db)
+{
+    Transponder::readDb(db);
+
+    _bandwidth = (fe_bandwidth_t)db.readInt32();
+    _code_rate_HP = (fe_code_rate_t)db.readInt32();
+    _code_rate_LP = (fe_code_rate_t)db.readInt32();
+    _constellation = (fe_modulation_t)db.readInt32();
+    _transmission_mode = (fe_transmit_mode_t)db.readInt32();
+    _guard_interval = (fe_guard_interval_t)db.readInt32();
+    _hierarchy_information = (fe_hierarchy_t)db.readInt32();
+    _deliverySystem = db.readString();
+    _plpId = db.readInt32();
+}
+
+
+void
+TerrestrialTransponder::writeDb(ChannelDbWriter& db)
+{
+    Transponder::writeDb(db);
+
+    db.writeInt32(_bandwidth);
+    db.writeInt32(_code_rate_HP);
+    db.writeInt32(_code_rate_LP);
+    db.writeInt32(_constellation);
+    db.writeInt32(_transmission_mode);
+    db.writeInt32(_guard_interval);
+    db.writeInt32(_hierarchy_information);
+    db.writeString(_deliverySystem);
+    db.writeInt32(_plpId);
+}
+
+
 bool
-TerrestrialTransponder::initTransponder(Poco::StringTokenizer& params)
+TerrestrialTransponder::initTransponder(const std::vector<std::string>& params)
 {
-    if (params[0] != "T" || params.count() < 9) {
+    if ((params[0] != "T" && params[0] != "T2") || params.size() < 9) {
         LOG(dvb, error, "invalid parameter data for terrestrial transponder.");
         return false;
     }
+    // DVB-T2 lines may carry the PLP id as last parameter
+    if (params[0] == "T2") {
+        _deliverySystem = SYSTEM_DVBT2;
+        if (params.size() > 9) {
+            try {
+                _plpId = Poco::NumberParser::parse(params[9]);
+            }
+            catch (Poco::Exception& e) {
+                LOG(dvb, error, "invalid plp id for terrestrial transponder: " + params[9]);
+            }
+        }
+    }
     init(bandwidthFromString(params[2]),
         coderateFromString(params[3]),
         coderateFromString(params[4]),
@@ -531,6 +923,29 @@ TerrestrialTransponder::initTransponder(Poco::StringTokenizer& params)
 }
 
 
+unsigned int
+TerrestrialTransponder::bandwidthToHz(fe_bandwidth_t val)
+{
+    switch (val) {
+        case ::BANDWIDTH_8_MHZ:
+            return 8000000;
+        case ::BANDWIDTH_7_MHZ:
+            return 7000000;
+        case ::BANDWIDTH_6_MHZ:
+            return 6000000;
+        case ::BANDWIDTH_5_MHZ:
+            return 5000000;
+        case ::BANDWIDTH_10_MHZ:
+            return 10000000;
+        case ::BANDWIDTH_1_712_MHZ:
+            return 1712000;
+        default:
+            // driver detects bandwidth
+            return 0;
+    }
+}
+
+
 fe_bandwidth_t
 TerrestrialTransponder::bandwidthFromString(const std::string& val)
 {
@@ -924,7 +1339,7 @@ Transponder(pFrontend, freq, tsid)
 
 
 bool
-CableTransponder::initTransponder(Poco::StringTokenizer& params)
+CableTransponder::initTransponder(const std::vector<std::string>& params)
 {
     if (params[0] != "C") {
         LOG(dvb, error, "invalid parameter data for cable transponder.");
@@ -942,7 +1357,7 @@ Transponder(pFrontend, freq, tsid)
 
 
 bool
-AtscTransponder::initTransponder(Poco::StringTokenizer& params)
+AtscTransponder::initTransponder(const std::vector<std::string>& params)
 {
     if (params[0] != "A") {
         LOG(dvb, error, "invalid parameter data for atsc transponder.");
@@ -17,7 +17,10 @@
 #include <linux/dvb/dmx.h>
 #include <sys/poll.h>
 
-#include <Poco/StringTokenizer.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
 #include <Poco/DOM/DOMException.h>
 #include <Poco/DOM/DOMParser.h>
 #include <Poco/DOM/DOMWriter.h>
@@ -38,6 +41,8 @@ namespace Dvb {
 
 class Frontend;
 class Service;
+class ChannelDbReader;
+class ChannelDbWriter;
 
 class Transponder
 {
@@ -51,34 +56,51 @@ class Transponder
 
 public:
     static const int InvalidTransportStreamId;
+    static const int InvalidVersion;
 
     Transponder(Frontend* pFrontend, unsigned int freq, int tsid);
 
     void addService(Service* pService);
     Service* getService(unsigned int serviceId);
     Service* getService(const std::string& serviceName);
+    void setServiceName(Service* pService, const std::string& serviceName);
     unsigned int getFrequency();
+    int getTransportStreamId();
 
     virtual void readXml(Poco::XML::Node* pXmlTransponder);
     virtual void writeXml(Poco::XML::Element* pFrontend);
+    virtual void readDb(ChannelDbReader& db);
+    virtual void writeDb(ChannelDbWriter& db);
 
     bool equal(Transponder* pOtherTransponder);
+    bool hasTableVersions();
+    void lockedAfter(Poco::Int64 lockTime);
+    void clearServices();
 
     void markServiceStarted(Service* pService);
     void markServiceStopped(Service* pService);
     std::set<Dvb::Service*>& runningServices();
 
 protected:
-    virtual bool initTransponder(Poco::StringTokenizer& params) {}
+    virtual bool initTransponder(const std::vector<std::string>& params) {}
 
     Frontend*                           _pFrontend;
     std::vector<Dvb::Service*>          _services;
+    // services indexed by service id and by Service::getName()
+    std::unordered_map<unsigned int, Dvb::Service*>     _serviceIdIndex;
+    std::unordered_map<std::string, Dvb::Service*>      _serviceNameIndex;
     std::set<Dvb::Service*>             _runningServices;
     Poco::AutoPtr<Poco::XML::Element>   _pXmlTransponder;
 
 private:
     unsigned int                        _frequency;
     int                                 _transportStreamId;
+    // versions of the actual PAT, SDT and NIT at the last scan
+    int                                 _patVersion;
+    int                                 _sdtVersion;
+    int                                 _nitVersion;
+    // average time in ms the frontend needed to lock on this transponder, 0 if it never locked
+    unsigned int                        _lockTime;
 };
 
 
@@ -109,21 +131,42 @@ public:
     static const std::string FEC_4_5;
     static const std::string FEC_9_10;
     static const std::string FEC_NO_CODING;
+    static const std::string ROLLOFF_AUTO;
+    static const std::string ROLLOFF_0_35;
+    static const std::string ROLLOFF_0_25;
+    static const std::string ROLLOFF_0_20;
+    static const std::string PILOT_AUTO;
+    static const std::string PILOT_ON;
+    static const std::string PILOT_OFF;
 
     SatTransponder(Frontend* pFrontend, unsigned int freq, unsigned int tsid);
 
     void init(const std::string satPosition, unsigned int satNum, unsigned int symbolRate, const std::string& polarization);
+    void initModulation(const std::string& modulationSystem, const std::string& modulationType, const std::string& fecInner, const std::string& rollOff);
+
+    static fe_delivery_system_t deliverySystemFromString(const std::string& val);
+    static fe_modulation_t modulationFromString(const std::string& val);
+    static fe_code_rate_t fecFromString(const std::string& val);
+    static fe_rolloff_t rollOffFromString(const std::string& val);
+    static fe_pilot_t pilotFromString(const std::string& val);
 
     virtual void readXml(Poco::XML::Node* pXmlTransponder);
     virtual void writeXml(Poco::XML::Element* pFrontend);
+    virtual void readDb(ChannelDbReader& db);
+    virtual void writeDb(ChannelDbWriter& db);
 
 private:
-    virtual bool initTransponder(Poco::StringTokenizer& params);
+    virtual bool initTransponder(const std::vector<std::string>& params);
 
     std::string         _satPosition;
     int                 _satNum;
     unsigned int        _symbolRate;
     std::string         _polarization;
+    std::string         _modulationSystem;
+    std::string         _modulationType;
+    std::string         _fecInner;
+    std::string         _rollOff;
+    std::string         _pilot;
 };
 
 
@@ -186,6 +229,9 @@ public:
     static const std::string HIERARCHY_2;
     static const std::string HIERARCHY_4;
     static const std::string HIERARCHY_AUTO;
+    static const std::string SYSTEM_DVBT;
+    static const std::string SYSTEM_DVBT2;
+    static const int NoPlpId;
 
     TerrestrialTransponder(Frontend* pFrontend, unsigned int freq, unsigned int tsid);
 
@@ -199,6 +245,8 @@ public:
 
     virtual void readXml(Poco::XML::Node* pXmlTransponder);
     virtual void writeXml(Poco::XML::Element* pFrontend);
+    virtual void readDb(ChannelDbReader& db);
+    virtual void writeDb(ChannelDbWriter& db);
 
     static fe_bandwidth_t bandwidthFromString(const std::string& val);
     static std::string bandwidthToString(fe_bandwidth_t val);
@@ -212,9 +260,10 @@ public:
     static std::string guard_intervalToString(fe_guard_interval_t val);
     static fe_hierarchy_t hierarchyFromString(const std::string& val);
     static std::string hierarchyToString(fe_hierarchy_t val);
+    static unsigned int bandwidthToHz(fe_bandwidth_t val);
 
 private:
-    virtual bool initTransponder(Poco::StringTokenizer& params);
+    virtual bool initTransponder(const std::vector<std::string>& params);
 
     fe_bandwidth_t              _bandwidth;
     fe_code_rate_t              _code_rate_HP;
@@ -223,6 +272,8 @@ private:
     fe_transmit_mode_t          _transmission_mode;
     fe_guard_interval_t         _guard_interval;
     fe_hierarchy_t              _hierarchy_information;
+    std::string                 _deliverySystem;
+    int                         _plpId;
 };
 
 
@@ -233,7 +284,7 @@ public:
 //    CableTransponder(unsigned int freq, unsigned int tsid);
 
 private:
-    virtual bool initTransponder(Poco::StringTokenizer& params);
+    virtual bool initTransponder(const std::vector<std::string>& params);
 
 };
 
@@ -245,7 +296,7 @@ public:
 //    AtscTransponder(unsigned int freq, unsigned int tsid);
 
 private:
-    virtual bool initTransponder(Poco::StringTokenizer& params);
+    virtual bool initTransponder(const std::vector<std::string>& params);
 
 };
 
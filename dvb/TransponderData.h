@@ -0,0 +1,54 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#ifndef TransponderData_INCLUDED
+#define TransponderData_INCLUDED
+
+namespace Omm {
+namespace Dvb {
+
+
+struct InitialTransponder
+/// One line of a scan file, split into its columns at build time.
+/// Column 0 is the delivery system (S, S2, T, T2, C, A), column 1 the frequency.
+{
+    enum { MaxParams = 10 };
+
+    unsigned int    frequency;
+    unsigned int    paramCount;
+    const char*     params[MaxParams];
+};
+
+
+struct InitialTransponderList
+/// All transponders of one scan file, name is "frontend type/key", e.g. "dvb-s/Astra-19.2E".
+{
+    const char*                 name;
+    const InitialTransponder*   transponders;
+    unsigned int                transponderCount;
+};
+
+
+class TransponderData
+/// Initial transponder tables, generated by transpondergen from transponder.zip
+/// into TransponderData.cpp. Lists are sorted by name.
+{
+public:
+    static const InitialTransponderList    lists[];
+    static const unsigned int              listCount;
+};
+
+
+}  // namespace Omm
+}  // namespace Dvb
+
+#endif
@@ -61,6 +61,8 @@ const Poco::UInt8 TransportStreamPacket::SyncByte = 0x47;
 const int TransportStreamPacket::Size = 188;
 const int TransportStreamPacket::HeaderSize = 4;
 const int TransportStreamPacket::PayloadSize = 188 - 4;
+const Poco::UInt16 TransportStreamPacket::NullPacketIdentifier = 0x1fff;
+const Poco::UInt64 TransportStreamPacket::PcrWrap = (Poco::UInt64(1) << 33) * 300;
 
 TransportStreamPacket::TransportStreamPacket(bool allocateData) :
 _adaptionFieldSize(0),
@@ -120,6 +122,13 @@ TransportStreamPacket::setPayloadUnitStartIndicator(bool PesOrPsi)
 }
 
 
+bool
+TransportStreamPacket::getPayloadUnitStartIndicator()
+{
+    return getValue<Poco::UInt8>(9, 1);
+}
+
+
 void
 TransportStreamPacket::setTransportPriority(bool high)
 {
@@ -169,6 +178,17 @@ TransportStreamPacket::setPointerField(Poco::UInt8 pointer)
 }
 
 
+int
+TransportStreamPacket::getPayloadOffset()
+{
+    // payload follows header and adaption field, if any
+    if (getValue<Poco::UInt8>(26, 1)) {
+        return HeaderSize + 1 + getBytes<Poco::UInt8>(HeaderSize);
+    }
+    return HeaderSize;
+}
+
+
 void
 TransportStreamPacket::setAdaptionFieldLength(Poco::UInt8 length)
 {
@@ -200,6 +220,14 @@ TransportStreamPacket::setRandomAccessIndicator(bool randomAccess)
 }
 
 
+bool
+TransportStreamPacket::getRandomAccessIndicator()
+{
+    // adaption field must be present and at least contain the flags
+    return getValue<Poco::UInt8>(26, 1) && getBytes<Poco::UInt8>(HeaderSize) && getValue<Poco::UInt8>(41, 1);
+}
+
+
 void
 TransportStreamPacket::setElementaryStreamPriorityIndicator(bool high)
 {
@@ -254,6 +282,19 @@ TransportStreamPacket::setPcr(Poco::UInt64 base, Poco::UInt8 padding, Poco::UInt
 }
 
 
+bool
+TransportStreamPacket::getPcr(const Poco::UInt8* pData, Poco::UInt64& pcr)
+{
+    // adaption field present and long enough for the flags and the PCR, PCR flag set
+    if (!(pData[3] & 0x20) || pData[4] < 7 || !(pData[5] & 0x10)) {
+        return false;
+    }
+    Poco::UInt64 base = ((Poco::UInt64)pData[6] << 25) | (pData[7] << 17) | (pData[8] << 9) | (pData[9] << 1) | (pData[10] >> 7);
+    pcr = base * 300 + (((pData[10] & 0x01) << 8) | pData[11]);
+    return true;
+}
+
+
 void
 TransportStreamPacket::setSpliceCountdown(Poco::UInt8 countdown)
 {
@@ -281,5 +322,51 @@ TransportStreamPacket::setStuffingBytes(int count)
 }
 
 
+const Poco::Timestamp::TimeDiff PcrClock::MaxInterval(1000000);
+const Poco::Timestamp::TimeDiff PcrClock::MaxLag(100000);
+const Poco::Timestamp::TimeDiff PcrClock::MaxLead(1000000);
+
+PcrClock::PcrClock() :
+_anchorPcr(0),
+_anchored(false)
+{
+}
+
+
+void
+PcrClock::reset()
+{
+    _anchored = false;
+}
+
+
+Poco::Timestamp
+PcrClock::departure(Poco::UInt64 pcr)
+{
+    Poco::Timestamp now;
+    if (!_anchored) {
+        _anchorTime = now;
+        _anchorPcr = pcr;
+        _anchored = true;
+        return now;
+    }
+    Poco::Timestamp departure = _anchorTime + interval(_anchorPcr, pcr);
+    if (departure < now - MaxLag || departure > now + MaxLead) {
+        _anchorTime = now;
+        _anchorPcr = pcr;
+        return now;
+    }
+    return departure;
+}
+
+
+Poco::Timestamp::TimeDiff
+PcrClock::interval(Poco::UInt64 pcrBegin, Poco::UInt64 pcrEnd)
+{
+    // PCR runs at 27 MHz
+    return ((pcrEnd + TransportStreamPacket::PcrWrap - pcrBegin) % TransportStreamPacket::PcrWrap) / 27;
+}
+
+
 }  // namespace Omm
 }  // namespace Dvb
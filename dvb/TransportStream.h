@@ -17,6 +17,7 @@
 #include <Poco/Mutex.h>
 #include <Poco/ScopedLock.h>
 #include "Poco/AtomicCounter.h"
+#include <Poco/Timestamp.h>
 
 #include "DvbUtil.h"
 
@@ -80,6 +81,12 @@ public:
     static const int           Size;
     static const int           HeaderSize;
     static const int           PayloadSize;
+    static const Poco::UInt16  NullPacketIdentifier;
+    static const Poco::UInt64  PcrWrap;
+    /// PCR values are 33 bit base times 300 plus 9 bit extension and wrap around at PcrWrap
+
+    static bool getPcr(const Poco::UInt8* pData, Poco::UInt64& pcr);
+    /// PCR in 27 MHz ticks of the raw packet at pData, false if it carries no PCR
 
     TransportStreamPacket(bool allocateData = true);
     ~TransportStreamPacket();
@@ -91,6 +98,7 @@ public:
     // header fields
     void setTransportErrorIndicator(bool uncorrectableError);
     void setPayloadUnitStartIndicator(bool PesOrPsi);
+    bool getPayloadUnitStartIndicator();
     void setTransportPriority(bool high);
     Poco::UInt16 getPacketIdentifier();
     void setPacketIdentifier(Poco::UInt16 pid);
@@ -98,12 +106,14 @@ public:
     void setAdaptionFieldExists(Poco::UInt8 exists);
     void setContinuityCounter(Poco::UInt8 counter);
     void setPointerField(Poco::UInt8 pointer);
+    int getPayloadOffset();
 
     // optional header adaption fields
     void setAdaptionFieldLength(Poco::UInt8 length);
     void clearAllAdaptionFieldFlags();
     void setDiscontinuityIndicator(bool discontinuity);
     void setRandomAccessIndicator(bool randomAccess);
+    bool getRandomAccessIndicator();
     void setElementaryStreamPriorityIndicator(bool high);
     void setPcrFlag(bool containsPcr);
     void setOPcrFlag(bool containsOPcr);
@@ -143,6 +153,31 @@ private:
 };
 
 
+class PcrClock
+/// Maps the PCR of a stream to the wall clock, so that the stream can be sent at the rate of the broadcaster.
+{
+public:
+    static const Poco::Timestamp::TimeDiff MaxInterval;
+    /// longer intervals between two PCRs or PCR going backwards are discontinuities
+    static const Poco::Timestamp::TimeDiff MaxLag;
+    static const Poco::Timestamp::TimeDiff MaxLead;
+
+    PcrClock();
+
+    void reset();
+    Poco::Timestamp departure(Poco::UInt64 pcr);
+    /// wall clock time at which data with pcr is due. The clock is anchored to now on the first call after reset()
+    /// and when it drifts apart from the wall clock, that is departure lags more than MaxLag or leads more than MaxLead
+    static Poco::Timestamp::TimeDiff interval(Poco::UInt64 pcrBegin, Poco::UInt64 pcrEnd);
+    /// usec from pcrBegin to pcrEnd, also across a PCR wrap around
+
+private:
+    Poco::Timestamp                 _anchorTime;
+    Poco::UInt64                    _anchorPcr;
+    bool                            _anchored;
+};
+
+
 }  // namespace Omm
 }  // namespace Dvb
 
@@ -4,6 +4,11 @@
 #include "Service.h"
 #include "TransportStream.h"
 #include "AvStream.h"
+#include "Epg.h"
+#include "TimeShift.h"
+#include "Recorder.h"
+#include "Multicast.h"
+#include "Monitor.h"
 
 #include "dvb.h"
 
@@ -13,6 +18,10 @@ struct DvbStream {
 	Omm::Dvb::Transponder* pTransponder;
 	Omm::Dvb::Service* pService;
 	Omm::AvStream::ByteQueue* pByteQueue;
+	Omm::Dvb::Service* pStreamService;
+	// difference between the stream position in the time-shift ring and the offset
+	// requested by the reader, grows when the reader falls out of the ring
+	long long offsetSkew;
 };
 
 
@@ -21,8 +30,14 @@ dvb_init(const char *conf_xml)
 {
     Omm::Dvb::Device* pDevice = Omm::Dvb::Device::instance();
 	pDevice->detectAdapters();
-	std::ifstream conf_xml_stream(conf_xml);
-    pDevice->readXml(conf_xml_stream);
+    // the binary channel db next to the xml description is generated on first start
+    // and after each change of the xml description
+    std::string conf_db = std::string(conf_xml) + ".db";
+    if (!pDevice->readChannelDb(conf_db, conf_xml)) {
+        std::ifstream conf_xml_stream(conf_xml);
+        pDevice->readXml(conf_xml_stream);
+        pDevice->writeChannelDb(conf_db, conf_xml);
+    }
     return 0;
 }
 
@@ -41,13 +56,46 @@ dvb_close()
 }
 
 
+void
+dvb_set_timeshift(const char *directory, int minutes)
+{
+	Omm::Dvb::Device::instance()->setTimeShift(directory, minutes > 0 ? minutes : 0);
+}
+
+
+void
+dvb_set_pacing(int pacing)
+{
+	// live streams are released at the rate of the broadcaster, so that clients can buffer less
+	Omm::Dvb::Device::instance()->setPacing(pacing != 0);
+}
+
+
+void
+dvb_set_idle_timeout(int seconds)
+{
+	// adapters are opened on the first request of one of their services and closed when idle for seconds,
+	// 0 opens them all in dvb_open() and keeps them open
+	Omm::Dvb::Device::instance()->setIdleTimeout(seconds > 0 ? seconds * 1000L : 0);
+}
+
+
 DvbStream*
 dvb_stream(const char *service_name)
 {
+	return dvb_stream_select(service_name, DVB_SELECT_ALL);
+}
+
+
+DvbStream*
+dvb_stream_select(const char *service_name, int selection)
+{
+	// unselected streams and null packets are dropped and the PMT only lists the selected streams
 	DvbStream *stream = (DvbStream*)malloc(sizeof(DvbStream));
 
 	stream->pTransponder = Omm::Dvb::Device::instance()->getFirstTransponder(service_name);
 	if (stream->pTransponder == NULL) {
+		free(stream);
 		return NULL;
 	}
 	stream->pService = stream->pTransponder->getService(service_name);
@@ -55,17 +103,21 @@ dvb_stream(const char *service_name)
 		stream->pService->getStatus() != Omm::Dvb::Service::StatusRunning ||
 		stream->pService->getScrambled() ||
 		(!stream->pService->isAudio() && !stream->pService->isSdVideo())) {
-		delete stream->pTransponder;
+		// transponder and service belong to the device
 		free(stream);
 		return NULL;
 	}
-	stream->pByteQueue = Omm::Dvb::Device::instance()->getByteQueue(service_name);
+	stream->pByteQueue = Omm::Dvb::Device::instance()->getByteQueue(service_name,
+			Omm::Dvb::Device::PriorityLive, 0, selection);
 	if (!stream->pByteQueue) {
-		delete stream->pTransponder;
-		delete stream->pService;
+		// all tuners are busy with services of the same or higher priority
 		free(stream);
 		return NULL;
 	}
+	stream->pStreamService = Omm::Dvb::Device::instance()->getByteQueueService(stream->pByteQueue);
+	// the time-shift ring may already be written for other readers, start at its live end
+	Omm::Dvb::TimeShift* pTimeShift = stream->pStreamService ? stream->pStreamService->getTimeShift() : 0;
+	stream->offsetSkew = pTimeShift ? pTimeShift->end() : 0;
 	return stream;
 }
 
@@ -80,6 +132,24 @@ dvb_read_stream(DvbStream *stream, char *buf, int nbuf)
 }
 
 
+int
+dvb_read_stream_at(DvbStream *stream, char *buf, int nbuf, long long offset)
+{
+	if (!stream->pByteQueue) {
+		return -1;
+	}
+	Omm::Dvb::TimeShift* pTimeShift = stream->pStreamService ? stream->pStreamService->getTimeShift() : 0;
+	if (!pTimeShift || offset < 0) {
+		return stream->pByteQueue->readSome(buf, nbuf);
+	}
+	long long streamPosition = offset + stream->offsetSkew;
+	Poco::UInt64 position = streamPosition > 0 ? streamPosition : 0;
+	int bytesRead = pTimeShift->read(buf, nbuf, position);
+	stream->offsetSkew = position - offset;
+	return bytesRead;
+}
+
+
 void
 dvb_free_stream(DvbStream *stream)
 {
@@ -88,6 +158,248 @@ dvb_free_stream(DvbStream *stream)
 	}
 	// delete stream->pTransponder;
 	// delete stream->pService;
-	Omm::Dvb::Device::instance()->stopService(stream->pService);
+	// the byte queue may belong to a clone of the service on the transponder
+	Omm::Dvb::Device::instance()->freeByteQueue(stream->pByteQueue);
 	free(stream);
 }
+
+
+int
+dvb_epg(const char *service_name, char *buf, int nbuf)
+{
+	// one line per cached event, starting with the present one: "<start> <duration> <name>"
+	Omm::Dvb::Transponder* pTransponder = Omm::Dvb::Device::instance()->getFirstTransponder(service_name);
+	if (pTransponder == NULL || nbuf <= 0) {
+		return 0;
+	}
+	Omm::Dvb::Service* pService = pTransponder->getService(service_name);
+	if (pService == NULL) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::EpgEvent> events;
+	Omm::Dvb::Device::instance()->getEpg().getEvents(pTransponder->getTransportStreamId(), pService->getServiceId(), time(0), 16, events);
+	int pos = 0;
+	for (std::vector<Omm::Dvb::EpgEvent>::iterator it = events.begin(); it != events.end(); ++it) {
+		int len = snprintf(buf + pos, nbuf - pos, "%ld %u %s\n", (long)it->getStartTime(), it->getDuration(), it->getName().c_str());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			break;
+		}
+		pos += len;
+	}
+	return pos;
+}
+
+
+int
+dvb_record(const char *service_name, const char *directory, long start, int duration)
+{
+	// start 0 records right away, returns the id of the recording
+	if (duration <= 0 || Omm::Dvb::Device::instance()->getFirstTransponder(service_name) == NULL) {
+		return -1;
+	}
+	time_t start_time = start > 0 ? start : time(0);
+	return Omm::Dvb::Device::instance()->getRecorder().addRecording(service_name,
+			Omm::Dvb::Recorder::recordingPath(directory, service_name, start_time), start_time, duration);
+}
+
+
+int
+dvb_record_mux(const char *service_name, const char *directory, long start, int duration)
+{
+	// records all unscrambled services on the transponder of service_name, they are split
+	// from the multiplex in one pass, returns the number of recordings
+	Omm::Dvb::Device* pDevice = Omm::Dvb::Device::instance();
+	Omm::Dvb::Transponder* pTransponder = pDevice->getFirstTransponder(service_name);
+	if (duration <= 0 || pTransponder == NULL) {
+		return -1;
+	}
+	time_t start_time = start > 0 ? start : time(0);
+	int count = 0;
+	for (Omm::Dvb::Device::ServiceIterator it = pDevice->serviceBegin(); it != pDevice->serviceEnd(); ++it) {
+		if (std::find(it->second.begin(), it->second.end(), pTransponder) == it->second.end()) {
+			continue;
+		}
+		Omm::Dvb::Service* pService = pTransponder->getService(it->first);
+		if (pService == NULL || pService->getScrambled() ||
+			(!pService->isAudio() && !pService->isSdVideo() && !pService->isHdVideo())) {
+			continue;
+		}
+		pDevice->getRecorder().addRecording(it->first,
+				Omm::Dvb::Recorder::recordingPath(directory, it->first, start_time), start_time, duration);
+		count++;
+	}
+	return count;
+}
+
+
+int
+dvb_record_cancel(int id)
+{
+	return Omm::Dvb::Device::instance()->getRecorder().delRecording(id) ? 0 : -1;
+}
+
+
+int
+dvb_recordings(char *buf, int nbuf)
+{
+	// one line per recording: "<id> <state> <start> <duration> <bytes written> <bytes dropped> <service>"
+	if (nbuf <= 0) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::Recording> recordings;
+	Omm::Dvb::Device::instance()->getRecorder().getRecordings(recordings);
+	int pos = 0;
+	buf[0] = '\0';
+	for (std::vector<Omm::Dvb::Recording>::iterator it = recordings.begin(); it != recordings.end(); ++it) {
+		int len = snprintf(buf + pos, nbuf - pos, "%u %s %ld %u %llu %llu %s\n", it->getId(),
+				Omm::Dvb::Recording::stateToString(it->getState()).c_str(), (long)it->getStartTime(), it->getDuration(),
+				(unsigned long long)it->getBytesWritten(), (unsigned long long)it->getBytesDropped(), it->getServiceName().c_str());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			break;
+		}
+		pos += len;
+	}
+	return pos;
+}
+
+
+int
+dvb_multicast(const char *service_name, const char *address, int port, int ttl)
+{
+	// sends service_name as RTP to the multicast group address:port, returns the id of the stream
+	if (port <= 0 || port > 0xffff || ttl < 0 || ttl > 255) {
+		return -1;
+	}
+	unsigned int id = Omm::Dvb::Device::instance()->getMulticast().startStream(service_name, address, port, ttl);
+	return id ? (int)id : -1;
+}
+
+
+int
+dvb_multicast_stop(int id)
+{
+	return Omm::Dvb::Device::instance()->getMulticast().stopStream(id) ? 0 : -1;
+}
+
+
+int
+dvb_multicasts(char *buf, int nbuf)
+{
+	// one line per stream: "<id> <address> <port> <datagrams sent> <bytes dropped> <service>"
+	if (nbuf <= 0) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::MulticastStream> streams;
+	Omm::Dvb::Device::instance()->getMulticast().getStreams(streams);
+	int pos = 0;
+	buf[0] = '\0';
+	for (std::vector<Omm::Dvb::MulticastStream>::iterator it = streams.begin(); it != streams.end(); ++it) {
+		int len = snprintf(buf + pos, nbuf - pos, "%u %s %u %llu %llu %s\n", it->getId(), it->getAddress().c_str(),
+				(unsigned)it->getPort(), (unsigned long long)it->getDatagramsSent(),
+				(unsigned long long)it->getBytesDropped(), it->getServiceName().c_str());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			break;
+		}
+		pos += len;
+	}
+	return pos;
+}
+
+
+int
+dvb_monitor(char *buf, int nbuf)
+{
+	// per frontend a line "<adapter> <frontend> dvr <overflows> <read errors> <sync errors>",
+	// followed by a line per pid "<adapter> <frontend> pid <pid> <packets> <bits per second>
+	// <continuity errors> <transport errors> <scrambled> <pcr discontinuities> <max pcr jitter usec>"
+	if (nbuf <= 0) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::FrontendStats> frontendStats;
+	Omm::Dvb::Device::instance()->getMonitorStats(frontendStats);
+	int pos = 0;
+	buf[0] = '\0';
+	for (std::vector<Omm::Dvb::FrontendStats>::iterator it = frontendStats.begin(); it != frontendStats.end(); ++it) {
+		Omm::Dvb::MonitorStats& stats = it->getMonitorStats();
+		int len = snprintf(buf + pos, nbuf - pos, "%s %s dvr %llu %llu %llu\n", it->getAdapterId().c_str(), it->getFrontendName().c_str(),
+				(unsigned long long)stats.getOverflows(), (unsigned long long)stats.getReadErrors(),
+				(unsigned long long)stats.getSyncErrors());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			return pos;
+		}
+		pos += len;
+		std::vector<Omm::Dvb::PidStats>& pidStats = stats.getPidStats();
+		for (std::vector<Omm::Dvb::PidStats>::iterator pit = pidStats.begin(); pit != pidStats.end(); ++pit) {
+			len = snprintf(buf + pos, nbuf - pos, "%s %s pid %u %llu %llu %llu %llu %d %llu %lld\n",
+					it->getAdapterId().c_str(), it->getFrontendName().c_str(), (unsigned)pit->getPid(),
+					(unsigned long long)pit->getPackets(), (unsigned long long)pit->getBitrate(),
+					(unsigned long long)pit->getContinuityErrors(), (unsigned long long)pit->getTransportErrors(),
+					pit->getScrambled() ? 1 : 0, (unsigned long long)pit->getPcrDiscontinuities(),
+					(long long)pit->getPcrJitter());
+			if (len < 0 || len >= nbuf - pos) {
+				buf[pos] = '\0';
+				return pos;
+			}
+			pos += len;
+		}
+	}
+	return pos;
+}
+
+
+int
+dvb_signal(char *buf, int nbuf)
+{
+	// one line per open frontend "<adapter> <frontend> <lock> <signal> <snr> <ber> <uncorrected blocks>",
+	// values the frontend can't measure are -1
+	if (nbuf <= 0) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::FrontendStats> frontendStats;
+	Omm::Dvb::Device::instance()->getSignalStats(frontendStats);
+	int pos = 0;
+	buf[0] = '\0';
+	for (std::vector<Omm::Dvb::FrontendStats>::iterator it = frontendStats.begin(); it != frontendStats.end(); ++it) {
+		Omm::Dvb::SignalStatus& status = it->getSignalStatus();
+		int len = snprintf(buf + pos, nbuf - pos, "%s %s %d %d %d %lld %lld\n", it->getAdapterId().c_str(), it->getFrontendName().c_str(),
+				status.getLock() ? 1 : 0, status.getSignal(), status.getSnr(),
+				(long long)status.getBer(), (long long)status.getUncorrectedBlocks());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			return pos;
+		}
+		pos += len;
+	}
+	return pos;
+}
+
+
+int
+dvb_services(char *buf, int nbuf)
+{
+	// one line per running service "<outputs> <bits per second> <packets> <packets dropped>
+	// <queued packets> <queued bytes> <service>"
+	if (nbuf <= 0) {
+		return 0;
+	}
+	std::vector<Omm::Dvb::ServiceStats> stats;
+	Omm::Dvb::Device::instance()->getServiceStats(stats);
+	int pos = 0;
+	buf[0] = '\0';
+	for (std::vector<Omm::Dvb::ServiceStats>::iterator it = stats.begin(); it != stats.end(); ++it) {
+		int len = snprintf(buf + pos, nbuf - pos, "%u %llu %llu %llu %u %u %s\n", it->getOutputs(),
+				(unsigned long long)it->getBitrate(), (unsigned long long)it->getPackets(),
+				(unsigned long long)it->getPacketsDropped(), it->getQueuedPackets(), it->getQueuedBytes(),
+				it->getName().c_str());
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			break;
+		}
+		pos += len;
+	}
+	return pos;
+}
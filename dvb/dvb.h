@@ -12,11 +12,38 @@ struct DvbStream;
 int dvb_init(const char *conf_xml);
 void dvb_open();
 void dvb_close();
+void dvb_set_timeshift(const char *directory, int minutes);
+void dvb_set_pacing(int pacing);
+void dvb_set_idle_timeout(int seconds);
+
+/// streams of a service forwarded by dvb_stream_select(), DVB_SELECT_ALL or any combination of the others
+#define DVB_SELECT_ALL   0x00
+#define DVB_SELECT_VIDEO 0x01
+#define DVB_SELECT_AUDIO 0x02
+#define DVB_SELECT_OTHER 0x04
+#define DVB_SELECT_ELEMENTARY 0x08  /// raw elementary stream of the first selected audio (or video) stream
 
 struct DvbStream* dvb_stream(const char *service_name);
+struct DvbStream* dvb_stream_select(const char *service_name, int selection);
 int dvb_read_stream(struct DvbStream *stream, char *buf, int nbuf);
+int dvb_read_stream_at(struct DvbStream *stream, char *buf, int nbuf, long long offset);
 void dvb_free_stream(struct DvbStream *stream);
 
+int dvb_epg(const char *service_name, char *buf, int nbuf);
+
+int dvb_record(const char *service_name, const char *directory, long start, int duration);
+int dvb_record_mux(const char *service_name, const char *directory, long start, int duration);
+int dvb_record_cancel(int id);
+int dvb_recordings(char *buf, int nbuf);
+
+int dvb_multicast(const char *service_name, const char *address, int port, int ttl);
+int dvb_multicast_stop(int id);
+int dvb_multicasts(char *buf, int nbuf);
+
+int dvb_monitor(char *buf, int nbuf);
+int dvb_signal(char *buf, int nbuf);
+int dvb_services(char *buf, int nbuf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,200 @@
+/***************************************************************************|
+|  OMM - Open Multimedia                                                    |
+|                                                                           |
+|  Copyright (C) 2009, 2010, 2011, 2012, 2022                               |
+|  Jörg Bakker                                                              |
+|                                                                           |
+|  This file is part of OMM.                                                |
+|                                                                           |
+|  OMM is free software: you can redistribute it and/or modify              |
+|  it under the terms of the MIT License                                    |
+ ***************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <Poco/NumberFormatter.h>
+#include <Poco/NumberParser.h>
+#include <Poco/StringTokenizer.h>
+#include <Poco/Zip/ZipArchive.h>
+#include <Poco/Zip/ZipStream.h>
+
+#include "Poco/Util/Application.h"
+#include "Poco/Util/Option.h"
+#include "Poco/Util/OptionSet.h"
+#include "Poco/Util/HelpFormatter.h"
+#include "Poco/LineEndingConverter.h"
+#include "Poco/Exception.h"
+#include "Poco/Path.h"
+
+#include "TransponderData.h"
+
+
+using Poco::Util::Application;
+using Poco::Util::Option;
+using Poco::Util::OptionSet;
+using Poco::Util::HelpFormatter;
+
+
+class TransponderGenApplication : public Poco::Util::Application
+/// Turns the scan files in transponder.zip into the constant tables of TransponderData.cpp,
+/// so that scanning doesn't need to inflate and parse them at runtime.
+{
+public:
+    TransponderGenApplication() :
+        _helpRequested(false),
+        _outputDirectory("./")
+    {
+        setUnixOptions(true);
+    }
+
+protected:
+    void defineOptions(OptionSet& options)
+    {
+        Application::defineOptions(options);
+
+        options.addOption(Option("help", "h", "display help information on command line arguments")
+                            .required(false)
+                            .repeatable(false));
+        options.addOption(Option("output-directory", "o", "output directory for TransponderData.cpp")
+                          .required(false)
+                          .repeatable(false)
+                          .argument("output directory", true));
+    }
+
+    void handleOption(const std::string& name, const std::string& value)
+    {
+        Application::handleOption(name, value);
+
+        if (name == "help") {
+            _helpRequested = true;
+        }
+        else if (name == "output-directory") {
+            _outputDirectory = value;
+        }
+    }
+
+    void displayHelp()
+    {
+        HelpFormatter helpFormatter(options());
+        helpFormatter.setCommand(commandName());
+        helpFormatter.setUsage("[-o OUTPUT_DIRECTORY] ZIP_FILE" + Poco::LineEnding::NEWLINE_DEFAULT
+                                + "scan files in ZIP_FILE are named <frontend type>/<key>");
+        helpFormatter.setHeader("Initial transponder table generator.");
+        helpFormatter.format(std::cout);
+    }
+
+    std::string quote(const std::string& val)
+    {
+        std::string res = "\"";
+        for (std::string::const_iterator it = val.begin(); it != val.end(); ++it) {
+            if (*it == '"' || *it == '\\') {
+                res += '\\';
+            }
+            res += *it;
+        }
+        return res + "\"";
+    }
+
+    std::string writeTransponders(const std::string& name, std::istream& scanFile, unsigned int& transponderCount)
+    {
+        std::string res;
+        std::string line;
+        transponderCount = 0;
+        while (getline(scanFile, line)) {
+            line = line.substr(0, line.find('#'));
+            Poco::StringTokenizer params(line, " \t\r", Poco::StringTokenizer::TOK_IGNORE_EMPTY | Poco::StringTokenizer::TOK_TRIM);
+            if (params.count() == 0) {
+                continue;
+            }
+            unsigned int freq = 0;
+            if (params.count() < 2 || !Poco::NumberParser::tryParseUnsigned(params[1], freq)) {
+                std::cerr << "transpondergen skipping line without frequency in " << name << ": " << line << std::endl;
+                continue;
+            }
+            if (params.count() > Omm::Dvb::InitialTransponder::MaxParams) {
+                std::cerr << "transpondergen skipping line with too many parameters in " << name << ": " << line << std::endl;
+                continue;
+            }
+            res += "    { " + Poco::NumberFormatter::format(freq) + ", " + Poco::NumberFormatter::format(params.count()) + ", { ";
+            for (unsigned int i = 0; i < params.count(); i++) {
+                res += quote(params[i]) + (i + 1 < params.count() ? ", " : "");
+            }
+            res += " } }," + Poco::LineEnding::NEWLINE_DEFAULT;
+            transponderCount++;
+        }
+        return res;
+    }
+
+    int main(const std::vector<std::string>& args)
+    {
+        if (_helpRequested || args.size() != 1) {
+            displayHelp();
+            return Application::EXIT_USAGE;
+        }
+
+        std::ifstream zipFile(args[0].c_str(), std::ios::binary);
+        if (!zipFile) {
+            std::cerr << "transpondergen could not open " << args[0] << std::endl;
+            return Application::EXIT_NOINPUT;
+        }
+        Poco::Zip::ZipArchive arch(zipFile);
+        // header map of the archive is sorted by file name, which is the order of the generated lists
+        std::string tables;
+        std::string lists;
+        unsigned int listCount = 0;
+        for (Poco::Zip::ZipArchive::FileHeaders::const_iterator it = arch.headerBegin(); it != arch.headerEnd(); ++it) {
+            if (it->second.isDirectory()) {
+                continue;
+            }
+            Poco::Zip::ZipInputStream zipin(zipFile, it->second);
+            std::string tableName = "transponders" + Poco::NumberFormatter::format(listCount);
+            unsigned int transponderCount = 0;
+            std::string transponders = writeTransponders(it->first, zipin, transponderCount);
+            if (transponderCount) {
+                tables += "static const InitialTransponder " + tableName + "[] = {" + Poco::LineEnding::NEWLINE_DEFAULT
+                        + transponders
+                        + "};" + Poco::LineEnding::NEWLINE_DEFAULT + Poco::LineEnding::NEWLINE_DEFAULT;
+            }
+            lists += "    { " + quote(it->first) + ", " + (transponderCount ? tableName : "0") + ", "
+                    + Poco::NumberFormatter::format(transponderCount) + " }," + Poco::LineEnding::NEWLINE_DEFAULT;
+            listCount++;
+        }
+
+        std::string outputPath = _outputDirectory + "/TransponderData.cpp";
+        std::cout << "transpondergen writing " << listCount << " transponder lists to: " << outputPath << std::endl;
+        std::ofstream outputFile(outputPath.c_str());
+        outputFile << "// generated by transpondergen from " << Poco::Path(args[0]).getFileName() << ", do not edit" << std::endl
+                << std::endl
+                << "#include \"TransponderData.h\"" << std::endl
+                << std::endl
+                << std::endl
+                << "namespace Omm {" << std::endl
+                << "namespace Dvb {" << std::endl
+                << std::endl
+                << tables
+                << "const InitialTransponderList TransponderData::lists[] = {" << std::endl
+                << lists
+                << "};" << std::endl
+                << std::endl
+                << "const unsigned int TransponderData::listCount = " << listCount << ";" << std::endl
+                << std::endl
+                << "}  // namespace Omm" << std::endl
+                << "}  // namespace Dvb" << std::endl;
+        return outputFile ? Application::EXIT_OK : Application::EXIT_CANTCREAT;
+    }
+
+private:
+    bool                        _helpRequested;
+    std::string                 _outputDirectory;
+};
+
+
+int main(int argc, char** argv)
+{
+    TransponderGenApplication app;
+    app.init(argc, argv);
+    return app.run();
+}
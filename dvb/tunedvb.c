@@ -38,7 +38,7 @@ main(int argc, char **argv)
 	// outf = create(outf_name, OWRITE, 0664);
 	outf = open(outf_name, O_WRONLY | O_CREAT | O_TRUNC, 0664);
 	while (telapsed < tmax) {
-		bytes_read = dvb_read_stream(stream, buf, dvb_transport_stream_packet_size);
+		bytes_read = dvb_read_stream(stream, buf, nbuf);
 		fprintf(stderr, "dvb bytes read: %d\n", bytes_read);
 		write(outf, buf, bytes_read);
 		telapsed = (clock() - tstart) / CLOCKS_PER_SEC;
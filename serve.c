@@ -61,17 +61,29 @@ Server layout:
 #define MAX_QRY      128
 #define MAX_CTL      128
 #define MAX_ARGC     32
-#define MAX_META     1024
+#define MAX_META     4096
+#define MAX_STATS    65536
+#define TIMESHIFT_MINUTES 30
+#define PACE_LIVE_STREAMS 1  /// Smooth the bursts of the DVR, so that renderers need smaller jitter buffers
+#define MULTICAST_TTL 1     /// Multicast streams stay on the local network
+#define ADAPTER_IDLE_TIMEOUT 60  /// Seconds without services until an adapter is powered down
 
 /// 9P server
 static char *srvname            = "ommserve";
 static char *uname              = "omm";
 static char *gname              = "omm";
 static char *datafname          = "data";
+static char *audiofname         = "audio";   /// Data of dvb objects with audio streams only
+static char *esfname            = "es";      /// Raw audio elementary stream of dvb objects, without TS and PES headers
 static char *metafname          = "meta";
 static char *queryfname         = "query";
 // static char *queryres           = "query result";
 static char *ctlfname           = "ctl";
+static char *statsfname         = "stats";   /// Read-only counters, one line per item with space separated fields
+static char *signalfname        = "signal";
+static char *servicesfname      = "services";
+static char *clientsfname       = "clients";
+static char *monitorfname       = "monitor";
 
 /// Database backend
 static sqlite3 *db              = NULL;
@@ -106,13 +118,16 @@ static const char *favaddqry    = \
 static const char *favdelqry    = \
 	"DELETE FROM fav WHERE listid = ? AND objid = ?";
 
-static const int nobjdir        = 2;
+static const int nobjdir        = 4;
+static const int nstatsdir      = 4;
 /// FIXME the following static variables are mutated by all clients
 static int objcount             = 0;
 static char querystr[MAX_QRY]   = "";    /// By default, no search string for title, origin; show all
 static char favid[FAVID_MAXLEN] = "";    /// By default, no fav list, show all table entries
 static char qrootstr[MAX_QRY]   = "";
 static char ctlstr[MAX_CTL]     = "";
+static char *recdir             = nil;   /// Recordings are refused without a recording directory
+static char stats[MAX_STATS];
 
 enum
 {
@@ -122,6 +137,13 @@ enum
 	Qmeta,
 	Qquery,
 	Qctl,
+	Qaudio,
+	Qes,
+	Qstats,
+	Qsignal,
+	Qservices,
+	Qclients,
+	Qmonitor,
 };
 
 enum
@@ -145,16 +167,31 @@ typedef union AuxData
 	struct DvbStream *st;
 } AuxData;
 
-typedef struct AuxObj
+typedef struct AuxObj AuxObj;
+struct AuxObj
 {
+	vlong path;
 	char *objpath;
 	int ot;
 	uint64_t os;
 	AuxData od;
-} AuxObj;
+	/// accounting of open data files, listed in stats/clients
+	ulong fid;
+	vlong opentime;
+	uvlong bytes;
+	uvlong reads;
+	vlong readns;
+	vlong maxreadns;
+	AuxObj *next;
+	AuxObj **prev;
+};
+
+static AuxObj *openobjs         = nil;
 
 static void closedb(void);
 static int xfav(int argc, char *argv[]);
+static int xrec(char *cmd);
+static int xmcast(char *cmd);
 static void parse_args(int *argc, char *argv[MAX_ARGC], char *cmd);
 
 static vlong
@@ -207,6 +244,14 @@ dostat(vlong path, Qid *qid, Dir *dir)
 		q.type = QTFILE;
 		name = metafname;
 		break;
+	case Qaudio:
+		q.type = QTFILE;
+		name = audiofname;
+		break;
+	case Qes:
+		q.type = QTFILE;
+		name = esfname;
+		break;
 	case Qquery:
 		q.type = QTFILE;
 		name = queryfname;
@@ -217,6 +262,26 @@ dostat(vlong path, Qid *qid, Dir *dir)
 		name = ctlfname;
 		mode = 0666;
 		break;
+	case Qstats:
+		q.type = QTDIR;
+		name = statsfname;
+		break;
+	case Qsignal:
+		q.type = QTFILE;
+		name = signalfname;
+		break;
+	case Qservices:
+		q.type = QTFILE;
+		name = servicesfname;
+		break;
+	case Qclients:
+		q.type = QTFILE;
+		name = clientsfname;
+		break;
+	case Qmonitor:
+		q.type = QTFILE;
+		name = monitorfname;
+		break;
 	default:
 		sysfatal("dostat %#llux", path);
 	}
@@ -238,23 +303,69 @@ dostat(vlong path, Qid *qid, Dir *dir)
 }
 
 
+/// objtype() returns the type of the object with id objid, or -1 if there is no such object
+static int
+objtype(vlong objid)
+{
+	int ot = -1;
+	sqlite3_bind_int(metastmt, 1, objid);
+	if (sqlite3_step(metastmt) == SQLITE_ROW) {
+		ot = strcmp((char*)sqlite3_column_text(metastmt, 0), OBJTYPESTR_DVB) == 0 ? OTdvb : OTfile;
+	}
+	sqlite3_reset(metastmt);
+	return ot;
+}
+
+
+/// freeaux() closes the data handle of aux, removes it from the open objects and frees it
+static void
+freeaux(void **aux)
+{
+	if (!*aux)
+		return;
+	AuxObj *ao = (AuxObj*)(*aux);
+	if (ao->prev) {
+		if (ao->next)
+			ao->next->prev = ao->prev;
+		*ao->prev = ao->next;
+	}
+	free(ao->objpath);
+	switch (ao->ot) {
+	case OTfile:
+		LOG("closing file data handle");
+		if (ao->od.fh != -1)
+			close(ao->od.fh);
+		break;
+	case OTdvb:
+		LOG("closing dvb data handle");
+		dvb_free_stream(ao->od.st);
+		break;
+	}
+	free(*aux);
+	*aux = nil;
+}
+
+
 /// initaux() initializes r->fid->aux based on r->fid->qid.path
-/// it allocates aux, if necessary, otherwise it sets all fields to zero
-/// then it queries the object for type and path and sets them in aux
+/// aux of another path, left over from a walk of the same fid, is freed first,
+/// then a new aux is allocated with type and path of the object queried from the db
 void
 initaux(vlong path, void **aux)
 {
 	logpath("initaux obj", path);
-	// if (*aux) {
-		// memset(*aux, 0, sizeof **aux);
-	// } else {
-		// *aux = malloc(sizeof **aux);
-	// }
-	// if (*aux) return;
-	if (QTYPE(path) == Qdata) {
+	if (*aux) {
+		if (((AuxObj*)*aux)->path == path) {
+			// already initialized by stat or open of the same fid, keep its open handle
+			return;
+		}
+		freeaux(aux);
+	}
+	if (QTYPE(path) == Qdata || QTYPE(path) == Qaudio || QTYPE(path) == Qes) {
 		LOG("initaux, Qdata");
 		AuxObj *ao = calloc(1, sizeof(AuxObj));
 		vlong objid = QOBJID(path);
+		ao->path = path;
+		ao->od.fh = -1;
 		// SELECT type, fmt, dur, orig, album, track, title, path FROM obj WHERE id = objid LIMIT 1
 		sqlite3_bind_int(metastmt, 1, objid);
 		int sqlret = sqlite3_step(metastmt);
@@ -268,6 +379,7 @@ initaux(vlong path, void **aux)
 			}
 			else if (strcmp(objtype, OBJTYPESTR_DVB) == 0) {
 				ao->ot = OTdvb;
+				ao->od.st = nil;
 			}
 		}
 		sqlite3_reset(metastmt);
@@ -281,7 +393,7 @@ static int
 rootgen(int i, Dir *d, void *v)
 {
 	(void)v;
-	int objoff = 2;
+	int objoff = 3;
 	if (strlen(favid)) {
 		sprintf(qrootstr, favcountqry, querystr, querystr, favid);
 	} else {
@@ -308,6 +420,9 @@ rootgen(int i, Dir *d, void *v)
 	} else if (i == 1) {
 		LOG("rootgen: query file");
 		dostat(qpath(Qquery, i), nil, d);
+	} else if (i == 2) {
+		LOG("rootgen: stats dir");
+		dostat(qpath(Qstats, 0), nil, d);
 	} else {
 		if (strlen(favid)) {
 			sprintf(qrootstr, favidqry, querystr, querystr, favid, i - objoff);
@@ -323,8 +438,8 @@ rootgen(int i, Dir *d, void *v)
 		if (ret == SQLITE_ROW) {
 			int id = sqlite3_column_int(idstmt, 0);
 			LOG("rootgen: select row %d returned objid: %d", i, id);
-			/// 0-clt, 1-query, 2..-obj (objid in db starts with 1)
-			dostat(qpath(Qobj, id + objoff - 2), nil, d);
+			/// 0-clt, 1-query, 2-stats, 3..-obj (objid in db starts with 1)
+			dostat(qpath(Qobj, id), nil, d);
 		}
 		sqlite3_reset(idstmt);
 	}
@@ -335,20 +450,73 @@ rootgen(int i, Dir *d, void *v)
 static int
 objgen(int i, Dir *d, void *v)
 {
-	(void)v;
-	if(i >= nobjdir)
+	/// audio and es files are only offered for dvb objects, v points to the object type
+	int ot = *(int*)v;
+	if(i >= nobjdir || (ot != OTdvb && i >= 2))
 		// End of directory entries
 		return -1;
 	if (i == 0) {
 		dostat(qpath(Qdata, i), nil, d);
 	}
-	else {
+	else if (i == 1) {
 		dostat(qpath(Qmeta, i), nil, d);
 	}
+	else if (i == 2) {
+		dostat(qpath(Qaudio, i), nil, d);
+	}
+	else {
+		dostat(qpath(Qes, i), nil, d);
+	}
 	return 0;
 }
 
 
+static int
+statsgen(int i, Dir *d, void *v)
+{
+	(void)v;
+	if(i >= nstatsdir)
+		// End of directory entries
+		return -1;
+	if (i == 0) {
+		dostat(qpath(Qsignal, 0), nil, d);
+	}
+	else if (i == 1) {
+		dostat(qpath(Qservices, 0), nil, d);
+	}
+	else if (i == 2) {
+		dostat(qpath(Qclients, 0), nil, d);
+	}
+	else {
+		dostat(qpath(Qmonitor, 0), nil, d);
+	}
+	return 0;
+}
+
+
+/// clientstats() lists the open data files, one line per fid:
+/// "<fid> <file> <seconds open> <bytes> <reads> <avg read usec> <max read usec> <object path>"
+static int
+clientstats(char *buf, int nbuf)
+{
+	int pos = 0;
+	vlong now = nsec();
+	buf[0] = '\0';
+	for (AuxObj *ao = openobjs; ao; ao = ao->next) {
+		int len = snprintf(buf + pos, nbuf - pos, "%lu %s %lld %llu %llu %lld %lld %s\n",
+				ao->fid, ao->ot == OTdvb ? "dvb" : "file", (now - ao->opentime) / 1000000000LL,
+				ao->bytes, ao->reads, ao->reads ? ao->readns / (vlong)ao->reads / 1000 : 0,
+				ao->maxreadns / 1000, ao->objpath ? ao->objpath : "");
+		if (len < 0 || len >= nbuf - pos) {
+			buf[pos] = '\0';
+			break;
+		}
+		pos += len;
+	}
+	return pos;
+}
+
+
 static void
 srvattach(Req *r)
 {
@@ -385,6 +553,10 @@ srvwalk1(Fid *fid, char *name, Qid *qid)
 			path = qpath(Qctl, 0);
 			goto Found;
 		}
+		if(strcmp(statsfname, name) == 0) {
+			path = qpath(Qstats, 0);
+			goto Found;
+		}
 		char *endnum;
 		vlong objid = strtoull(name, &endnum, 10);
 		if (objid == 0 || endnum == name) {
@@ -410,6 +582,39 @@ srvwalk1(Fid *fid, char *name, Qid *qid)
 			LOG("meta file");
 			goto Found;
 		}
+		if(strcmp(audiofname, name) == 0 && objtype(QOBJID(path)) == OTdvb) {
+			path = qpath(Qaudio, QOBJID(path));
+			LOG("audio file");
+			goto Found;
+		}
+		if(strcmp(esfname, name) == 0 && objtype(QOBJID(path)) == OTdvb) {
+			path = qpath(Qes, QOBJID(path));
+			LOG("es file");
+			goto Found;
+		}
+		goto NotFound;
+		break;
+	case Qstats:
+		if(dotdot) {
+			path = Qroot;
+			break;
+		}
+		if(strcmp(signalfname, name) == 0) {
+			path = qpath(Qsignal, 0);
+			goto Found;
+		}
+		if(strcmp(servicesfname, name) == 0) {
+			path = qpath(Qservices, 0);
+			goto Found;
+		}
+		if(strcmp(clientsfname, name) == 0) {
+			path = qpath(Qclients, 0);
+			goto Found;
+		}
+		if(strcmp(monitorfname, name) == 0) {
+			path = qpath(Qmonitor, 0);
+			goto Found;
+		}
 		goto NotFound;
 		break;
 	}
@@ -464,6 +669,15 @@ srvopen(Req *r)
 	AuxObj *ao = r->fid->aux;
 	if (ao) {
 		LOG("aux object: %p", ao);
+		if (ao->prev == nil) {
+			ao->fid = r->fid->fid;
+			ao->opentime = nsec();
+			ao->next = openobjs;
+			if (openobjs)
+				openobjs->prev = &ao->next;
+			ao->prev = &openobjs;
+			openobjs = ao;
+		}
 		switch (ao->ot) {
 		case OTfile:
 			ao->od.fh = open(ao->objpath, OREAD);
@@ -473,7 +687,15 @@ srvopen(Req *r)
 			}
 			break;
 		case OTdvb:
-			ao->od.st = dvb_stream(ao->objpath);
+			/// the audio file drops video, teletext and subtitles, so that audio clients save bandwidth
+			/// the es file is plain MPEG audio, AAC or AC-3, so radio clients don't need a TS demuxer
+			if (QTYPE(r->fid->qid.path) == Qaudio) {
+				ao->od.st = dvb_stream_select(ao->objpath, DVB_SELECT_AUDIO);
+			} else if (QTYPE(r->fid->qid.path) == Qes) {
+				ao->od.st = dvb_stream_select(ao->objpath, DVB_SELECT_AUDIO | DVB_SELECT_ELEMENTARY);
+			} else {
+				ao->od.st = dvb_stream(ao->objpath);
+			}
 			if (ao->od.st == nil) {
 				LOG("failed to open dvb media object");
 			}
@@ -499,29 +721,43 @@ srvread(Req *r)
 	int pos = 0;
 	char meta[MAX_META] = {0};
 	int sqlret;
+	int ot;
 	AuxObj *ao = nil;
 	switch(QTYPE(path)) {
 	case Qroot:
 		dirread9p(r, rootgen, nil);
 		break;
 	case Qobj:
-		dirread9p(r, objgen, nil);
+		ot = objtype(objid);
+		dirread9p(r, objgen, &ot);
 		break;
 	case Qdata:
+	case Qaudio:
+	case Qes:
 		if (r->fid->aux == nil) {
 			LOG("read failed: aux data not set");
 			break;
 		}
 		ao = (AuxObj*)r->fid->aux;
+		vlong readstart = nsec();
 		if (ao->ot == OTfile) {
 			seek(ao->od.fh, offset, 0);
 			size_t bytesread = read(ao->od.fh, r->ofcall.data, count);
 			r->ofcall.count = bytesread;
 		}
 		else if (ao->ot == OTdvb) {
-			size_t bytesread = dvb_read_stream(ao->od.st, r->ofcall.data, count);
+			/// with time-shift the offset selects the position in the ring of the last minutes,
+			/// the es file has no packet boundaries to seek to and is always read live
+			size_t bytesread = dvb_read_stream_at(ao->od.st, r->ofcall.data, count, QTYPE(path) == Qes ? -1 : offset);
 			r->ofcall.count = bytesread;
 		}
+		vlong readns = nsec() - readstart;
+		ao->reads++;
+		ao->readns += readns;
+		if (readns > ao->maxreadns)
+			ao->maxreadns = readns;
+		if ((int)r->ofcall.count > 0)
+			ao->bytes += r->ofcall.count;
 		break;
 	case Qmeta:
 		// SELECT type, fmt, dur, orig, album, track, title, path FROM obj WHERE id = objid LIMIT 1
@@ -538,10 +774,40 @@ srvread(Req *r)
 				pos++;
 			}
 			LOG("meta query returned title: %s", col_val);  /// Last col is title
+			/// DVB objects append the cached EPG (present event first) as last field
+			if (strcmp((char*)sqlite3_column_text(metastmt, 0), OBJTYPESTR_DVB) == 0) {
+				pos += dvb_epg((char*)sqlite3_column_text(metastmt, 7), meta + pos, MAX_META - pos - 1);
+			}
 			readstr(r, meta);
 		}
 		sqlite3_reset(metastmt);
 		break;
+	case Qctl:
+		/// reading ctl lists the scheduled, running and finished recordings and the multicast streams
+		pos = dvb_recordings(meta, MAX_META);
+		dvb_multicasts(meta + pos, MAX_META - pos);
+		readstr(r, meta);
+		break;
+	case Qstats:
+		dirread9p(r, statsgen, nil);
+		break;
+	/// stats files are generated on each read, scrapers should read them at once from offset 0
+	case Qsignal:
+		dvb_signal(stats, MAX_STATS);
+		readstr(r, stats);
+		break;
+	case Qservices:
+		dvb_services(stats, MAX_STATS);
+		readstr(r, stats);
+		break;
+	case Qclients:
+		clientstats(stats, MAX_STATS);
+		readstr(r, stats);
+		break;
+	case Qmonitor:
+		dvb_monitor(stats, MAX_STATS);
+		readstr(r, stats);
+		break;
 	// case Qquery:
 		// readstr(r, queryres);
 		// break;
@@ -568,6 +834,15 @@ srvwrite(Req *r)
 	case Qctl:
 		snprint(ctlstr, count, "%s", r->ifcall.data);
 		LOG("ctl: %s", ctlstr);
+		/// service names contain spaces, so rec commands are not split by parse_args()
+		if (strncmp(ctlstr, "rec ", 4) == 0) {
+			xrec(ctlstr);
+			break;
+		}
+		if (strncmp(ctlstr, "mcast ", 6) == 0) {
+			xmcast(ctlstr);
+			break;
+		}
 		int argc = 0;
 		char *argv[MAX_ARGC] = {0};
 		parse_args(&argc, argv, ctlstr);
@@ -582,23 +857,7 @@ srvwrite(Req *r)
 static void
 srvdestroyfid(Fid *fid)
 {
-	if(!fid->aux)
-		return;
-	AuxObj *ao = (AuxObj*)(fid->aux);
-	free(ao->objpath);
-	switch (ao->ot) {
-	case OTfile:
-		LOG("closing file data handle");
-		close(ao->od.fh);
-		break;
-	case OTdvb:
-		LOG("closing dvb data handle");
-		// FIXME this cause a double free
-		dvb_free_stream(ao->od.st);
-		break;
-	}
-	free(fid->aux);
-	fid->aux = nil;
+	freeaux(&fid->aux);
 }
 
 
@@ -685,9 +944,14 @@ closedb(void)
 
 
 static void
-opendvb(char *config_xml)
+opendvb(char *config_xml, char *timeshift_dir)
 {
 	dvb_init(config_xml);
+	if (timeshift_dir) {
+		dvb_set_timeshift(timeshift_dir, TIMESHIFT_MINUTES);
+	}
+	dvb_set_pacing(PACE_LIVE_STREAMS);
+	dvb_set_idle_timeout(ADAPTER_IDLE_TIMEOUT);
 	dvb_open();
 }
 
@@ -795,6 +1059,76 @@ xfav(int argc, char *argv[])
 }
 
 
+/// rec add <start> <duration> <service name>
+///   record service name for duration seconds, starting at unix time start (0 for now)
+/// rec mux <start> <duration> <service name>
+///   record all services on the transponder of service name, one file per service
+/// rec del <id>
+///   stop a running recording or remove a recording from the list
+static int
+xrec(char *cmd)
+{
+	long start = 0;
+	int duration = 0;
+	int id = 0;
+	int n = 0;
+	char subcmd[4] = "";
+	if (sscanf(cmd, "rec %3s %ld %d %n", subcmd, &start, &duration, &n) == 3 && n > 0 && cmd[n] != '\0') {
+		if (!recdir) {
+			LOG("no recording directory, skipping");
+			return 0;
+		}
+		char *service = cmd + n;
+		if (strcmp(subcmd, "add") == 0) {
+			int recid = dvb_record(service, recdir, start, duration);
+			LOG("recording %s, id: %d", service, recid);
+		} else if (strcmp(subcmd, "mux") == 0) {
+			int reccount = dvb_record_mux(service, recdir, start, duration);
+			LOG("recording mux of %s, services: %d", service, reccount);
+		} else {
+			LOG("rec subcmd unknown, skipping.");
+		}
+		return 0;
+	} else if (sscanf(cmd, "rec del %d", &id) == 1) {
+		LOG("del recording %d", id);
+		if (dvb_record_cancel(id) == -1) {
+			LOG("no recording with id %d", id);
+		}
+		return 0;
+	}
+	LOG("rec subcmd unknown, skipping.");
+	return 0;
+}
+
+
+/// mcast add <address> <port> <service name>
+///   send service name as RTP to the multicast group address:port
+/// mcast del <id>
+///   stop sending a multicast stream
+static int
+xmcast(char *cmd)
+{
+	char address[16] = "";
+	int port = 0;
+	int id = 0;
+	int n = 0;
+	if (sscanf(cmd, "mcast add %15s %d %n", address, &port, &n) == 2 && n > 0 && cmd[n] != '\0') {
+		char *service = cmd + n;
+		int mcastid = dvb_multicast(service, address, port, MULTICAST_TTL);
+		LOG("multicast %s to %s:%d, id: %d", service, address, port, mcastid);
+		return 0;
+	} else if (sscanf(cmd, "mcast del %d", &id) == 1) {
+		LOG("del multicast %d", id);
+		if (dvb_multicast_stop(id) == -1) {
+			LOG("no multicast stream with id %d", id);
+		}
+		return 0;
+	}
+	LOG("mcast subcmd unknown, skipping.");
+	return 0;
+}
+
+
 void
 threadmain(int argc, char **argv)
 {
@@ -806,12 +1140,17 @@ threadmain(int argc, char **argv)
 		chatty9p = 1;
 	}
 	opendb(argv[1]);
-	if (argc == 3) {
-		opendvb(argv[2]);
+	if (argc >= 3) {
+		/// optional third argument is a directory for the time-shift rings of live services,
+		/// optional fourth argument the directory for recordings
+		if (argc >= 5) {
+			recdir = argv[4];
+		}
+		opendvb(argv[2], argc >= 4 && strlen(argv[3]) ? argv[3] : nil);
 	}
 	startserver(nil);
 	stopserver();
-	if (argc == 3) {
+	if (argc >= 3) {
 		closedb();
 	}
 	closedvb();